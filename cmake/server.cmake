@@ -34,6 +34,9 @@ target_link_libraries(TracyServer PUBLIC TracyCapstone TracyZstd)
 if(NO_STATISTICS)
     target_compile_definitions(TracyServer PUBLIC TRACY_NO_STATISTICS)
 endif()
+if(HUGE_PAGES)
+    target_compile_definitions(TracyServer PRIVATE TRACY_HUGE_PAGES)
+endif()
 
 if(NOT NO_PARALLEL_STL AND UNIX AND NOT APPLE AND NOT EMSCRIPTEN)
     target_link_libraries(TracyServer PRIVATE TracyTbb)
@@ -184,8 +184,12 @@ int CpuZoneBuffer::Update( Worker& worker, const Vector<const ThreadData *> &thr
                 const int64_t start = cs.Start();
                 const int64_t end = cs.End();
 
+#ifndef TRACY_NO_STATISTICS
+                int d = td->zoneIndex.DepthInRange( start, end );
+#else
                 TimelinePreprocessor preproc( worker, 0, 0 );
                 int d = preproc.CalculateMaxZoneDepthInRange( td->timeline, start, end );
+#endif
                 depth = std::max( d, depth );
 
                 if ( !BuildZoneListAt( worker, td->timeline, start, end, csIndex, prevEnd ) )
@@ -306,6 +306,10 @@ void EventDebug( const QueueItem& ev )
     case QueueType::AckSymbolCodeNotAvailable:
         fprintf( f, "ev %i (AckSymbolCodeNotAvailable)\n", ev.hdr.idx );
         break;
+    case QueueType::AckServerQueryBatch:
+        fprintf( f, "ev %i (AckServerQueryBatch)\n", ev.hdr.idx );
+        fprintf( f, "\tseq = %" PRIu32 "\n", ev.serverQueryBatchAck.seq );
+        break;
     case QueueType::CpuTopology:
         fprintf( f, "ev %i (CpuTopology)\n", ev.hdr.idx );
         fprintf( f, "\tpackage = %" PRIu32 "\n", ev.cpuTopology.package );
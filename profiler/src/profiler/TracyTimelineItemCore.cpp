@@ -351,7 +351,7 @@ int TimelineItemCore::PreprocessZones( const TimelineContext &ctx, const Vector<
                 clampedCtx.vStart = std::max( ctx.vStart, start );
                 clampedCtx.vEnd = std::min( ctx.vEnd, end );
                 const size_t drawStartIndex = m_draw.size();
-                const int d = preproc.PreprocessZoneLevel( clampedCtx, td->timeline, TimelineDrawSubType::Core, cstid, visible, m_draw );
+                const int d = preproc.PreprocessZoneLevel( clampedCtx, td->timeline, &td->timelineLod, TimelineDrawSubType::Core, cstid, visible, m_draw );
                 for ( size_t drawIndex = drawStartIndex; drawIndex < m_draw.size(); drawIndex++ )
                 {
                     TimelineDraw &draw = m_draw[ drawIndex ];
@@ -19,7 +19,7 @@ TimelineItemPlot::TimelineItemPlot( View& view, Worker& worker, PlotData* plot )
     : TimelineItem( view, worker, plot, true )
     , m_plot( plot )
 {
-    SetVisible( m_plot->type == PlotType::Zone );
+    SetVisible( m_plot->type == PlotType::Zone || m_plot->type == PlotType::Histogram );
 
     const float defaultHeight = 100.0f;
     m_resizeBar.id = 0;
@@ -65,9 +65,11 @@ void TimelineItemPlot::HeaderLabelPrefix( const TimelineContext &ctx, int yOffse
 
 const char* TimelineItemPlot::HeaderLabel() const
 {
+    static const char* histogramLabels[] = { "p50", "p90", "p99", "max" };
     static char tmp[1024];
     tmp[ 0 ] = 0;
-    for ( PlotData *plot = m_plot; plot != nullptr; plot = plot->nextPlot )
+    int nPlot = 0;
+    for ( PlotData *plot = m_plot; plot != nullptr; plot = plot->nextPlot, nPlot++ )
     {
         if ( tmp[ 0 ] ) strcat( tmp, "\n" );
         switch ( plot->type )
@@ -86,6 +88,10 @@ const char* TimelineItemPlot::HeaderLabel() const
                     sprintf( tmp, ICON_FA_MEMORY " %s", m_worker.GetString( plot->name ) );
                     return tmp;
                 }
+            case PlotType::Histogram:
+                assert( nPlot < 4 );
+                sprintf( tmp + strlen( tmp ), "%s %s", m_worker.GetString( plot->name ), histogramLabels[ nPlot ] );
+                break;
             case PlotType::SysTime:
                 return ICON_FA_GAUGE_HIGH " CPU usage";
             case PlotType::Power:
@@ -427,8 +433,7 @@ void TimelineItemPlot::Preprocess( const TimelineContext& ctx, TaskDispatch& td,
             auto &line = m_plotLines[nPlot];
             p->color = s_plotColors[ std::min( s_numPlotColors-1, nPlot ) ];
 
-            vec.ensure_sorted();
-            if ( vec.front().time.Val() > vEnd || vec.back().time.Val() < vStart )
+            if ( vec.empty() || vec.front().time.Val() > vEnd || vec.back().time.Val() < vStart )
             {
                 p->rMin = 0;
                 p->rMax = 0;
@@ -442,23 +447,11 @@ void TimelineItemPlot::Preprocess( const TimelineContext& ctx, TaskDispatch& td,
             if ( end != vec.end() ) end++;
             if ( it != vec.begin() ) it--;
 
-            double min = it->val;
-            double max = it->val;
             const auto num = end - it;
-            if( num > 1000000 )
-            {
-                min = p->min;
-                max = p->max;
-            }
-            else
-            {
-                auto tmp = it;
-                while ( ++tmp < end )
-                {
-                    if ( tmp->val < min ) min = tmp->val;
-                    else if ( tmp->val > max ) max = tmp->val;
-                }
-            }
+            uint32_t imin, imax;
+            p->lod.MinMax( vec.data(), uint32_t( it - vec.begin() ), uint32_t( end - vec.begin() ), imin, imax );
+            double min = vec[imin].val;
+            double max = vec[imax].val;
 
             m_max = nPlot == 0 ? max : std::max( max, m_max );
 
@@ -497,38 +490,15 @@ void TimelineItemPlot::Preprocess( const TimelineContext& ctx, TaskDispatch& td,
                 }
                 else
                 {
-                    // Sync with View::DrawPlot()!
-                    constexpr int NumSamples = 256;
-                    uint32_t samples[ NumSamples ];
-                    uint32_t cnt = 0;
-                    uint32_t offset = it - vec.begin();
-                    if ( rsz < NumSamples )
-                    {
-                        for ( cnt = 0; cnt < rsz; cnt++ )
-                        {
-                            samples[ cnt ] = offset + cnt;
-                        }
-                    }
-                    else
-                    {
-                        const auto skip = ( rsz + NumSamples - 1 ) / NumSamples;
-                        const auto limit = rsz / skip;
-                        for ( cnt = 0; cnt < limit; cnt++ )
-                        {
-                            samples[ cnt ] = offset + cnt * skip;
-                        }
-                        if ( cnt == limit ) cnt--;
-                        samples[ cnt++ ] = offset + rsz - 1;
-                    }
+                    const uint32_t offset = it - vec.begin();
+                    uint32_t bmin, bmax;
+                    p->lod.MinMax( vec.data(), offset, offset + rsz, bmin, bmax );
                     it = next;
 
-                    pdqsort_branchless( samples, samples + cnt, [ &vec ] ( const auto &l, const auto &r ) { return vec[ l ].val < vec[ r ].val; } );
-
-                    assert( rsz > 0 );
                     m_draw.emplace_back( rsz );
                     m_draw.emplace_back( offset );
-                    m_draw.emplace_back( samples[ 0 ] );
-                    m_draw.emplace_back( samples[ cnt - 1 ] );
+                    m_draw.emplace_back( bmin );
+                    m_draw.emplace_back( bmax );
                 }
             }
             line.m_end = m_draw.size();
@@ -408,7 +408,7 @@ void TimelineItemThread::Preprocess( const TimelineContext& ctx, TaskDispatch& t
             }
 
             TimelinePreprocessor preproc( m_worker, maxDepth, stackCollapseMode );
-            m_depth = preproc.PreprocessZoneLevel( ctx, m_thread->timeline, TimelineDrawSubType::Thread, comprTid, visible, m_draw );
+            m_depth = preproc.PreprocessZoneLevel( ctx, m_thread->timeline, &m_thread->timelineLod, TimelineDrawSubType::Thread, comprTid, visible, m_draw );
             m_maxZoneDepth = std::max(m_maxZoneDepth, m_depth);
             m_maxDepth = m_maxZoneDepth;
         }
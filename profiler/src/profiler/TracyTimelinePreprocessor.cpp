@@ -13,6 +13,23 @@ namespace tracy
 
 constexpr float MinVisSize = 3;
 
+// Lower bound search which first doubles its step from the start of the range.
+// Finding the end of a folded zone run costs log of the run length instead of
+// log of the remaining zone count, which keeps zoomed out levels pixel bound.
+template<typename It, typename T, typename Cmp>
+static It GallopLowerBound( It first, It last, const T& value, Cmp cmp )
+{
+	if( first == last || !cmp( *first, value ) ) return first;
+	ptrdiff_t step = 1;
+	while( step < last - first && cmp( *( first + step ), value ) )
+	{
+		first += step;
+		step *= 2;
+	}
+	const auto end = step < last - first ? first + step : last;
+	return std::lower_bound( first + 1, end, value, cmp );
+}
+
 
 TimelinePreprocessor::TimelinePreprocessor( Worker &worker, int maxDrawDepth, uint8_t stackCollapseMode )
     : m_worker( worker )
@@ -22,9 +39,9 @@ TimelinePreprocessor::TimelinePreprocessor( Worker &worker, int maxDrawDepth, ui
 }
 
 
-int TimelinePreprocessor::PreprocessZoneLevel( const TimelineContext& ctx, const Vector<short_ptr<ZoneEvent>>& vec, TimelineDrawSubType subtype, uint16_t comprTid, bool visible, std::vector<TimelineDraw> &outDraw )
+int TimelinePreprocessor::PreprocessZoneLevel( const TimelineContext& ctx, const Vector<short_ptr<ZoneEvent>>& vec, const ZoneLod* lod, TimelineDrawSubType subtype, uint16_t comprTid, bool visible, std::vector<TimelineDraw> &outDraw )
 {
-	return PreprocessZoneLevel( ctx, vec, subtype, comprTid, 0, visible, outDraw );
+	return PreprocessZoneLevel( ctx, vec, lod, subtype, comprTid, 0, visible, outDraw );
 }
 
 
@@ -40,7 +57,7 @@ int TimelinePreprocessor::CalculateMaxZoneDepthInRange( const Vector<short_ptr<Z
 }
 
 
-int TimelinePreprocessor::PreprocessZoneLevel( const TimelineContext& ctx, const Vector<short_ptr<ZoneEvent>>& vec, TimelineDrawSubType subtype, uint16_t comprTid, int depth, bool visible, std::vector<TimelineDraw> &outDraw )
+int TimelinePreprocessor::PreprocessZoneLevel( const TimelineContext& ctx, const Vector<short_ptr<ZoneEvent>>& vec, const ZoneLod* lod, TimelineDrawSubType subtype, uint16_t comprTid, int depth, bool visible, std::vector<TimelineDraw> &outDraw )
 {
 	if ( m_stackCollapseMode == ViewData::CollapseLimit )
 	{
@@ -49,17 +66,17 @@ int TimelinePreprocessor::PreprocessZoneLevel( const TimelineContext& ctx, const
 
 	if ( vec.is_magic() )
 	{
-		return PreprocessZoneLevel<VectorAdapterDirect<ZoneEvent>>( ctx, *(Vector<ZoneEvent>*)( &vec ), subtype, comprTid, depth, visible, outDraw );
+		return PreprocessZoneLevel<VectorAdapterDirect<ZoneEvent>>( ctx, *(Vector<ZoneEvent>*)( &vec ), lod, subtype, comprTid, depth, visible, outDraw );
 	}
 	else
 	{
-		return PreprocessZoneLevel<VectorAdapterPointer<ZoneEvent>>( ctx, vec, subtype, comprTid, depth, visible, outDraw );
+		return PreprocessZoneLevel<VectorAdapterPointer<ZoneEvent>>( ctx, vec, lod, subtype, comprTid, depth, visible, outDraw );
 	}
 }
 
 
 template<typename Adapter, typename V>
-int TimelinePreprocessor::PreprocessZoneLevel( const TimelineContext& ctx, const V& vec, TimelineDrawSubType subtype, uint16_t comprTid, int depth, bool visible, std::vector<TimelineDraw> &outDraw )
+int TimelinePreprocessor::PreprocessZoneLevel( const TimelineContext& ctx, const V& vec, const ZoneLod* lod, TimelineDrawSubType subtype, uint16_t comprTid, int depth, bool visible, std::vector<TimelineDraw> &outDraw )
 {
 	const auto vStart = ctx.vStart;
 	const auto vEnd = ctx.vEnd;
@@ -87,9 +104,35 @@ int TimelinePreprocessor::PreprocessZoneLevel( const TimelineContext& ctx, const
 		{
 			auto nextTime = end + MinVisNs;
 			auto next = it + 1;
-			for(;;)
+			bool found = false;
+			if( lod )
+			{
+				// The fold ends at the first zone ending at least MinVisNs after the previous one,
+				// the pyramid skips the zones which are too close to their predecessor for that.
+				const auto bits = uint8_t( std::bit_width( uint64_t( MinVisNs ) ) );
+				const auto covered = std::min<size_t>( lod->size(), zitend - vec.begin() );
+				auto idx = size_t( next - vec.begin() );
+				for(;;)
+				{
+					idx = lod->Next( idx, bits );
+					if( idx >= covered ) break;
+					if( m_worker.GetZoneEnd( a(vec[idx]) ) - m_worker.GetZoneEnd( a(vec[idx-1]) ) >= MinVisNs ) break;
+					idx++;
+				}
+				if( idx < covered )
+				{
+					next = vec.begin() + idx;
+					found = true;
+				}
+				else if( covered > size_t( next - vec.begin() ) )
+				{
+					next = vec.begin() + covered;
+					nextTime = m_worker.GetZoneEnd( a(*(next-1)) ) + MinVisNs;
+				}
+			}
+			while( !found )
 			{
-				next = std::lower_bound( next, zitend, nextTime, [this] ( const auto& l, const auto& r ) { Adapter a; return m_worker.GetZoneEnd( a(l) ) < r; } );
+				next = GallopLowerBound( next, zitend, nextTime, [this] ( const auto& l, const auto& r ) { Adapter a; return m_worker.GetZoneEnd( a(l) ) < r; } );
 				if( next == zitend ) break;
 				auto prev = next - 1;
 				const auto pt = m_worker.GetZoneEnd( a(*prev) );
@@ -104,7 +147,7 @@ int TimelinePreprocessor::PreprocessZoneLevel( const TimelineContext& ctx, const
 		{
 			if( ev.HasChildren() )
 			{
-				const auto d = PreprocessZoneLevel( ctx, m_worker.GetZoneChildren( ev.Child() ), subtype, comprTid, depth + 1, visible, outDraw );
+				const auto d = PreprocessZoneLevel( ctx, m_worker.GetZoneChildren( ev.Child() ), m_worker.GetZoneChildrenLod( ev.Child() ), subtype, comprTid, depth + 1, visible, outDraw );
 				if( d > maxdepth ) maxdepth = d;
 			}
 
@@ -148,11 +191,16 @@ int TimelinePreprocessor::CalculateMaxZoneDepthInRange( const V& vec, int64_t ra
     while( it < zitend )
     {
         const auto &ev = a( *it );
+        const int64_t zoneEnd = m_worker.GetZoneEnd( ev );
         const int64_t start = std::max( ev.Start(), rangeStart );
-        const int64_t end = std::min( m_worker.GetZoneEnd( ev ), rangeEnd );
+        const int64_t end = std::min( zoneEnd, rangeEnd );
         if( ev.HasChildren() )
         {
-            const int d = CalculateMaxZoneDepthInRange( m_worker.GetZoneChildren( ev.Child() ), start, end, depth + 1 );
+            // Zones fully inside the range contribute their whole subtree, which depth is known once closed.
+            const int childDepth = m_worker.GetZoneChildrenDepth( ev.Child() );
+            const int d = ( childDepth != 0 && childDepth != std::numeric_limits<uint16_t>::max() && ev.Start() >= rangeStart && zoneEnd <= rangeEnd ) ?
+                depth + 1 + childDepth :
+                CalculateMaxZoneDepthInRange( m_worker.GetZoneChildren( ev.Child() ), start, end, depth + 1 );
             if( d > maxdepth ) maxdepth = d;
         }
         ++it;
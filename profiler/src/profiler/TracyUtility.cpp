@@ -157,6 +157,8 @@ uint32_t GetPlotColor( const PlotData& plot, const Worker& worker )
         return 0xFFBAB220;
     case PlotType::Power:
         return 0xFF33CC33;
+    case PlotType::Histogram:
+        return plot.color | 0xFF000000;
     case PlotType::Zone:
         if ( plot.color != 0 ) return plot.color;
         return GetHsvColor( charutil::hash( worker.GetString( plot.name ) ), -10 );
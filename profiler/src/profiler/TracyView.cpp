@@ -1008,6 +1008,10 @@ bool View::DrawImpl()
         {
             m_showWaitStacks = true;
         }
+        if( ButtonDisablable( ICON_FA_LOCK " Lock contention", m_worker.GetLockMap().empty() ) )
+        {
+            m_showLockContention = true;
+        }
         ImGui::EndPopup();
     }
     if( m_sscb )
@@ -1225,6 +1229,8 @@ bool View::DrawImpl()
     if( m_sampleParents.symAddr != 0 ) DrawSampleParents();
     if( m_showRanges ) DrawRanges();
     if( m_showWaitStacks ) DrawWaitStacks();
+    if( m_showLockContention ) DrawLockContention();
+    if( m_criticalPath.show ) DrawCriticalPath();
 
     if( m_setRangePopup.active )
     {
@@ -316,6 +316,7 @@ private:
     void DrawInfo();
     void DrawTextEditor();
     void DrawLockInfoWindow();
+    void DrawLockContention();
     void DrawPlayback();
     void DrawCpuDataWindow();
     void DrawSelectedAnnotation();
@@ -325,6 +326,9 @@ private:
     void DrawRangeEntry( Range& range, const char* label, uint32_t color, const char* popupLabel, int id );
     void DrawSourceTooltip( const char* filename, uint32_t line, int before = 3, int after = 3, bool separateTooltip = true );
     void DrawWaitStacks();
+    void DrawCriticalPath();
+    void CalcCriticalPath( const ZoneEvent& zone );
+    void DrawCriticalPathOverlay( uint64_t thread, const ImVec2& ul, const ImVec2& dr );
 
     void ListMemData( std::vector<const MemEvent*>& vec, const std::function<void(const MemEvent*)>& DrawAddress, int64_t startTime = -1, uint64_t pool = 0 );
 
@@ -555,6 +559,7 @@ private:
     bool m_showCpuDataWindow = false;
     bool m_showAnnotationList = false;
     bool m_showWaitStacks = false;
+    bool m_showLockContention = false;
 
     bool m_showCoreView = false;
 	
@@ -594,6 +599,9 @@ private:
     BuzzAnim<uint32_t> m_lockInfoAnim;
     BuzzAnim<uint32_t> m_statBuzzAnim;
 
+    ImGuiTextFilter m_lockContentionFilter;
+    uint32_t m_lockContentionSelected = InvalidId;
+
     Vector<const ZoneEvent*> m_zoneInfoStack;
     Vector<const GpuEvent*> m_gpuInfoStack;
 
@@ -941,6 +949,32 @@ private:
         bool groupTopDown = true;
     } m_sampleParents;
 
+    enum class CriticalPathType : uint8_t
+    {
+        Running,
+        Runnable,
+        Blocked,
+        Lock
+    };
+
+    struct CriticalPathSegment
+    {
+        uint64_t thread;
+        int64_t start;
+        int64_t end;
+        CriticalPathType type;
+        uint32_t lockId;
+        const ZoneEvent* zone;
+    };
+
+    struct {
+        bool show = false;
+        bool highlight = true;
+        bool truncated = false;
+        const ZoneEvent* zone = nullptr;
+        std::vector<CriticalPathSegment> path;
+    } m_criticalPath;
+
     struct
     {
         bool enabled = false;
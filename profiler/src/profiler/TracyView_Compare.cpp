@@ -804,11 +804,8 @@ void View::DrawCompare()
 									gid = worker->GetZoneExtra( zone ).callstack.Val();
 									break;
 								case FindZone::GroupBy::Parent:
-								{
-									const auto parent = GetZoneParent( zone, worker->DecompressThread( zones[ i ].Thread() ), *worker );
-									if ( parent ) gid = uint64_t( uint16_t( parent->SrcLoc() ) );
+									gid = uint64_t( uint16_t( zones[ i ].ParentSrcLoc() ) );
 									break;
-								}
 								case FindZone::GroupBy::NoGrouping:
 									break;
 								default:
@@ -83,6 +83,16 @@ bool View::DrawConnection()
         std::lock_guard<std::mutex> lock( m_worker.GetDataLock() );
         ImGui::SameLine();
         TextFocused( "+", RealToString( m_worker.GetSendInFlight() ) );
+        if( isConnected )
+        {
+            TextFocused( "Query window:", RealToString( m_worker.GetQueryWindow() ) );
+            const auto rtt = m_worker.GetQueryRtt();
+            if( rtt != 0 )
+            {
+                ImGui::SameLine();
+                TextFocused( "RTT:", TimeToString( rtt * 1000 ) );
+            }
+        }
         const auto sz = m_worker.GetFrameCount( *m_frames );
         if( sz > 1 )
         {
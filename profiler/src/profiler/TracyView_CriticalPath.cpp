@@ -0,0 +1,508 @@
+#include <algorithm>
+
+#include "TracyImGui.hpp"
+#include "TracyMouse.hpp"
+#include "TracyPrint.hpp"
+#include "TracyView.hpp"
+
+namespace tracy
+{
+
+constexpr size_t MaxCriticalPathSegments = 64 * 1024;
+constexpr size_t MaxCriticalPathIterations = 4 * MaxCriticalPathSegments;
+constexpr size_t MaxLockWaitScan = 4096;
+
+struct CriticalPathLockWait
+{
+    uint32_t lockId;
+    int64_t waitStart;
+    int64_t obtain;
+    int64_t release;
+    uint64_t holder;
+};
+
+static uint64_t GetRunningThreadForCpu( const Worker& worker, uint8_t cpu, int64_t time )
+{
+    if( cpu >= worker.GetCpuDataCpuCount() ) return 0;
+    auto& cs = worker.GetCpuData()[cpu].cs;
+    if( cs.empty() ) return 0;
+    auto it = std::lower_bound( cs.begin(), cs.end(), time, [] ( const auto& l, const auto& r ) { return (uint64_t)l.End() < (uint64_t)r; } );
+    if( it == cs.end() || it->Start() > time ) return 0;
+    return worker.DecompressThreadExternal( it->Thread() );
+}
+
+// Finds the latest contended lock acquisition of the thread in the ( lo, hi ] range, along with
+// the thread that handed the lock over.
+static bool FindLockWait( const Worker& worker, uint64_t thread, int64_t lo, int64_t hi, CriticalPathLockWait& out )
+{
+    bool found = false;
+    const auto& lockMap = worker.GetLockMap();
+    for( auto id : worker.GetLockIdsForThread( thread ) )
+    {
+        auto lit = lockMap.find( id );
+        if( lit == lockMap.end() ) continue;
+        const auto& lm = *lit->second;
+        if( !lm.valid || lm.timeline.empty() ) continue;
+        auto tit = lm.threadMap.find( thread );
+        if( tit == lm.threadMap.end() ) continue;
+        const auto idx = tit->second;
+
+        const auto& tl = lm.timeline;
+        auto it = std::upper_bound( tl.begin(), tl.end(), hi, [] ( const auto& l, const auto& r ) { return l < r.ptr->Time(); } );
+        size_t scan = 0;
+        while( it != tl.begin() && scan++ < MaxLockWaitScan )
+        {
+            --it;
+            const auto& ev = *it->ptr;
+            const auto time = ev.Time();
+            if( time <= lo || ( found && time <= out.obtain ) ) break;
+            if( ev.thread != idx ) continue;
+            if( ev.type != LockEvent::Type::Obtain && ev.type != LockEvent::Type::ObtainShared ) continue;
+            if( it == tl.begin() ) break;
+
+            const auto& prev = *(it-1);
+            bool waited;
+            if( ev.type == LockEvent::Type::ObtainShared )
+            {
+                waited = ((const LockEventShared*)prev.ptr.get())->waitShared.Test( idx );
+            }
+            else
+            {
+                waited = prev.waitList.Test( idx );
+            }
+            if( !waited ) break;
+
+            const auto& pev = *prev.ptr;
+            const auto releaser = ( pev.type == LockEvent::Type::Release || pev.type == LockEvent::Type::ReleaseShared ) ? pev.thread : prev.lockingThread;
+            if( releaser == idx ) break;
+
+            auto wit = it - 1;
+            int64_t waitStart = lo;
+            size_t wscan = 0;
+            while( wscan++ < MaxLockWaitScan )
+            {
+                const auto& wev = *wit->ptr;
+                if( wev.Time() <= lo ) break;
+                if( wev.thread == idx && ( wev.type == LockEvent::Type::Wait || wev.type == LockEvent::Type::WaitShared ) )
+                {
+                    waitStart = wev.Time();
+                    break;
+                }
+                if( wit == tl.begin() ) break;
+                --wit;
+            }
+
+            out.lockId = id;
+            out.waitStart = waitStart;
+            out.obtain = time;
+            out.release = pev.Time();
+            out.holder = lm.threadList[releaser];
+            found = true;
+            break;
+        }
+    }
+    return found;
+}
+
+void View::CalcCriticalPath( const ZoneEvent& zone )
+{
+    auto& cp = m_criticalPath;
+    cp.zone = &zone;
+    cp.path.clear();
+    cp.truncated = false;
+
+    const auto zoneStart = zone.Start();
+    auto thread = GetZoneThread( zone );
+    auto t = m_worker.GetZoneEnd( zone );
+
+    // Lock holder currently being followed. Its running time up to the moment the waiter
+    // started blocking is attributed to the lock.
+    bool followLock = false;
+    uint32_t lockId = 0;
+    uint64_t lockHolder = 0;
+    int64_t lockWaitStart = 0;
+
+    auto AddSegment = [this, &cp] ( uint64_t tid, int64_t start, int64_t end, CriticalPathType type, uint32_t lock ) {
+        if( end <= start ) return;
+        const auto zone = FindZoneAtTime( tid, start + ( end - start ) / 2 );
+        cp.path.emplace_back( CriticalPathSegment { tid, start, end, type, lock, zone } );
+    };
+    auto AddRunning = [&] ( int64_t start, int64_t end ) {
+        start = std::max( start, zoneStart );
+        if( followLock && thread == lockHolder && end > lockWaitStart )
+        {
+            const auto split = std::max( start, lockWaitStart );
+            AddSegment( thread, split, end, CriticalPathType::Lock, lockId );
+            end = split;
+        }
+        AddSegment( thread, start, end, CriticalPathType::Running, 0 );
+    };
+    auto FollowLock = [&] ( const CriticalPathLockWait& lw ) {
+        AddSegment( thread, std::max( lw.release, zoneStart ), t, CriticalPathType::Runnable, 0 );
+        followLock = true;
+        lockId = lw.lockId;
+        lockHolder = lw.holder;
+        lockWaitStart = lw.waitStart;
+        thread = lw.holder;
+        t = lw.release;
+    };
+
+    size_t iterations = 0;
+    CriticalPathLockWait lw;
+    while( t > zoneStart )
+    {
+        if( cp.path.size() >= MaxCriticalPathSegments || iterations++ >= MaxCriticalPathIterations )
+        {
+            cp.truncated = true;
+            break;
+        }
+        if( followLock && thread != lockHolder ) followLock = false;
+
+        auto ctx = m_worker.GetContextSwitchData( thread );
+        if( !ctx || ctx->v.empty() )
+        {
+            // Without scheduler data only lock hand-offs can be followed.
+            if( FindLockWait( m_worker, thread, zoneStart, t, lw ) )
+            {
+                AddRunning( lw.obtain, t );
+                t = lw.obtain;
+                FollowLock( lw );
+                continue;
+            }
+            AddRunning( zoneStart, t );
+            break;
+        }
+
+        auto& v = ctx->v;
+        auto it = std::lower_bound( v.begin(), v.end(), t, [] ( const auto& l, const auto& r ) { return l.Start() < r; } );
+        if( it == v.begin() )
+        {
+            AddSegment( thread, zoneStart, t, CriticalPathType::Blocked, 0 );
+            break;
+        }
+        --it;
+
+        const auto isWakeup = it->Reason() == ContextSwitchData::Wakeup;
+        const auto runStart = it->Start();
+        const auto runEnd = isWakeup ? runStart : ( it->IsEndValid() ? it->End() : t );
+        if( runEnd < t )
+        {
+            AddSegment( thread, std::max( runEnd, zoneStart ), t, isWakeup ? CriticalPathType::Runnable : CriticalPathType::Blocked, 0 );
+            t = runEnd;
+            if( t <= zoneStart ) break;
+        }
+        AddRunning( runStart, t );
+        t = std::min( t, runStart );
+        if( t <= zoneStart ) break;
+
+        const auto wake = it->WakeupVal();
+        const auto hasWakeup = isWakeup || wake < runStart;
+        if( hasWakeup )
+        {
+            AddSegment( thread, std::max( wake, zoneStart ), t, CriticalPathType::Runnable, 0 );
+            t = wake;
+            if( t <= zoneStart ) break;
+        }
+
+        if( it == v.begin() )
+        {
+            AddSegment( thread, zoneStart, t, CriticalPathType::Blocked, 0 );
+            break;
+        }
+        const auto& prev = *(it-1);
+        const auto prevEnd = prev.IsEndValid() ? prev.End() : zoneStart;
+
+        if( hasWakeup )
+        {
+            const auto waker = GetRunningThreadForCpu( m_worker, it->WakeupCpu(), wake );
+            if( waker != 0 && waker != thread )
+            {
+                if( FindLockWait( m_worker, thread, prevEnd, runStart, lw ) && lw.holder == waker )
+                {
+                    followLock = true;
+                    lockId = lw.lockId;
+                    lockHolder = waker;
+                    lockWaitStart = lw.waitStart;
+                }
+                thread = waker;
+                continue;
+            }
+        }
+        else if( IsPreemptedState( prev.State() ) )
+        {
+            AddSegment( thread, std::max( prevEnd, zoneStart ), t, CriticalPathType::Runnable, 0 );
+            t = prevEnd;
+            continue;
+        }
+        else if( FindLockWait( m_worker, thread, prevEnd, runStart, lw ) && lw.release <= t )
+        {
+            FollowLock( lw );
+            continue;
+        }
+
+        AddSegment( thread, std::max( prevEnd, zoneStart ), t, CriticalPathType::Blocked, 0 );
+        t = prevEnd;
+    }
+
+    std::reverse( cp.path.begin(), cp.path.end() );
+}
+
+static const char* CriticalPathTypeName( int type )
+{
+    switch( type )
+    {
+    case 0: return "Running";
+    case 1: return "Runnable";
+    case 2: return "Blocked";
+    case 3: return "Lock";
+    default: return "???";
+    }
+}
+
+static uint32_t CriticalPathTypeColor( int type )
+{
+    switch( type )
+    {
+    case 0: return 0xFF22CC22;
+    case 1: return 0xFF2288EE;
+    case 2: return 0xFF2222DD;
+    case 3: return 0xFFDD44AA;
+    default: return 0xFF888888;
+    }
+}
+
+void View::DrawCriticalPath()
+{
+    const auto scale = GetScale();
+    ImGui::SetNextWindowSize( ImVec2( 700 * scale, 600 * scale ), ImGuiCond_FirstUseEver );
+    ImGui::Begin( "Critical path", &m_criticalPath.show );
+    if( ImGui::GetCurrentWindowRead()->SkipItems ) { ImGui::End(); return; }
+
+    auto& cp = m_criticalPath;
+    if( !cp.zone )
+    {
+        ImGui::TextUnformatted( "No zone selected." );
+        ImGui::End();
+        return;
+    }
+
+    const auto& zone = *cp.zone;
+    const auto zoneStart = zone.Start();
+    const auto zoneTime = m_worker.GetZoneEnd( zone ) - zoneStart;
+    ImGui::PushFont( m_bigFont );
+    ImGui::TextUnformatted( m_worker.GetZoneName( zone ) );
+    ImGui::PopFont();
+    TextFocused( "Zone time:", TimeToString( zoneTime ) );
+    ImGui::SameLine();
+    TextFocused( "Thread:", m_worker.GetThreadName( GetZoneThread( zone ) ) );
+    if( ImGui::Button( ICON_FA_MICROSCOPE " Zoom to zone" ) )
+    {
+        ZoomToZone( zone );
+    }
+    ImGui::SameLine();
+    if( ImGui::Button( ICON_FA_ARROWS_ROTATE " Recalculate" ) )
+    {
+        CalcCriticalPath( zone );
+    }
+    ImGui::SameLine();
+    SmallCheckbox( "Highlight on timeline", &cp.highlight );
+    if( cp.truncated )
+    {
+        TextColoredUnformatted( ImVec4( 1.f, 1.f, 0.2f, 1.f ), ICON_FA_TRIANGLE_EXCLAMATION " Path was truncated." );
+    }
+
+    struct ThreadBreakdown
+    {
+        uint64_t thread;
+        int64_t time[4];
+        int64_t total;
+    };
+
+    int64_t typeTime[4] = {};
+    unordered_flat_map<uint64_t, ThreadBreakdown> threads;
+    for( auto& seg : cp.path )
+    {
+        const auto dt = seg.end - seg.start;
+        const auto type = int( seg.type );
+        typeTime[type] += dt;
+        auto it = threads.find( seg.thread );
+        if( it == threads.end() ) it = threads.emplace( seg.thread, ThreadBreakdown { seg.thread, {}, 0 } ).first;
+        it->second.time[type] += dt;
+        it->second.total += dt;
+    }
+
+    char buf[64];
+    const auto rtime = zoneTime == 0 ? 0. : 100. / zoneTime;
+    ImGui::Separator();
+    for( int i=0; i<4; i++ )
+    {
+        if( i != 0 ) ImGui::SameLine();
+        SmallColorBox( CriticalPathTypeColor( i ) );
+        ImGui::SameLine();
+        PrintStringPercent( buf, TimeToString( typeTime[i] ), typeTime[i] * rtime );
+        TextFocused( CriticalPathTypeName( i ), buf );
+    }
+    TextFocused( "Threads on path:", RealToString( threads.size() ) );
+    ImGui::SameLine();
+    TextFocused( "Segments:", RealToString( cp.path.size() ) );
+
+    ImGui::Separator();
+    if( ImGui::TreeNodeEx( "Breakdown by thread", ImGuiTreeNodeFlags_DefaultOpen ) )
+    {
+        if( ImGui::BeginTable( "##criticalpaththreads", 6, ImGuiTableFlags_Resizable | ImGuiTableFlags_Sortable | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_SizingStretchProp ) )
+        {
+            ImGui::TableSetupColumn( "Thread" );
+            ImGui::TableSetupColumn( "Running", ImGuiTableColumnFlags_PreferSortDescending );
+            ImGui::TableSetupColumn( "Runnable", ImGuiTableColumnFlags_PreferSortDescending );
+            ImGui::TableSetupColumn( "Blocked", ImGuiTableColumnFlags_PreferSortDescending );
+            ImGui::TableSetupColumn( "Lock", ImGuiTableColumnFlags_PreferSortDescending );
+            ImGui::TableSetupColumn( "Total", ImGuiTableColumnFlags_PreferSortDescending | ImGuiTableColumnFlags_DefaultSort );
+            ImGui::TableHeadersRow();
+
+            std::vector<const ThreadBreakdown*> tsort;
+            tsort.reserve( threads.size() );
+            for( auto& v : threads ) tsort.emplace_back( &v.second );
+            const auto& sortspec = *ImGui::TableGetSortSpecs()->Specs;
+            const auto col = sortspec.ColumnIndex;
+            const auto desc = sortspec.SortDirection == ImGuiSortDirection_Descending;
+            if( col == 0 )
+            {
+                pdqsort_branchless( tsort.begin(), tsort.end(), [this, desc] ( const auto& l, const auto& r ) { return ( strcmp( m_worker.GetThreadName( l->thread ), m_worker.GetThreadName( r->thread ) ) < 0 ) != desc; } );
+            }
+            else
+            {
+                pdqsort_branchless( tsort.begin(), tsort.end(), [col, desc] ( const auto& l, const auto& r ) {
+                    const auto lv = col == 5 ? l->total : l->time[col-1];
+                    const auto rv = col == 5 ? r->total : r->time[col-1];
+                    return desc ? lv > rv : lv < rv;
+                } );
+            }
+
+            for( auto& v : tsort )
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted( m_worker.GetThreadName( v->thread ) );
+                ImGui::SameLine();
+                ImGui::TextDisabled( "(%s)", RealToString( v->thread ) );
+                if( ImGui::IsItemHovered() ) m_drawThreadHighlight = v->thread;
+                for( int i=0; i<4; i++ )
+                {
+                    ImGui::TableNextColumn();
+                    if( v->time[i] == 0 )
+                    {
+                        TextDisabledUnformatted( "-" );
+                    }
+                    else
+                    {
+                        ImGui::TextUnformatted( TimeToString( v->time[i] ) );
+                    }
+                }
+                ImGui::TableNextColumn();
+                PrintStringPercent( buf, TimeToString( v->total ), v->total * rtime );
+                ImGui::TextUnformatted( buf );
+            }
+            ImGui::EndTable();
+        }
+        ImGui::TreePop();
+    }
+
+    ImGui::Separator();
+    ImGui::BeginChild( "##criticalpath" );
+    if( ImGui::BeginTable( "##criticalpathsegments", 5, ImGuiTableFlags_Resizable | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_ScrollY ) )
+    {
+        ImGui::TableSetupScrollFreeze( 0, 1 );
+        ImGui::TableSetupColumn( "Start", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoResize );
+        ImGui::TableSetupColumn( "Duration", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoResize );
+        ImGui::TableSetupColumn( "State", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoResize );
+        ImGui::TableSetupColumn( "Thread" );
+        ImGui::TableSetupColumn( "Zone" );
+        ImGui::TableHeadersRow();
+
+        const auto& lockMap = m_worker.GetLockMap();
+        ImGuiListClipper clipper;
+        clipper.Begin( cp.path.size() );
+        while( clipper.Step() )
+        {
+            for( auto i=clipper.DisplayStart; i<clipper.DisplayEnd; i++ )
+            {
+                const auto& seg = cp.path[i];
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::PushID( i );
+                if( ImGui::Selectable( TimeToString( seg.start - zoneStart ), false, ImGuiSelectableFlags_SpanAllColumns | ImGuiSelectableFlags_AllowItemOverlap ) )
+                {
+                    ZoomToRange( seg.start, seg.end );
+                }
+                if( ImGui::IsItemHovered() )
+                {
+                    m_drawThreadHighlight = seg.thread;
+                    if( IsMouseClicked( 2 ) ) ZoomToRange( seg.start, seg.end );
+                }
+                ImGui::PopID();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted( TimeToString( seg.end - seg.start ) );
+                ImGui::TableNextColumn();
+                SmallColorBox( CriticalPathTypeColor( int( seg.type ) ) );
+                ImGui::SameLine();
+                ImGui::TextUnformatted( CriticalPathTypeName( int( seg.type ) ) );
+                if( seg.type == CriticalPathType::Lock )
+                {
+                    auto lit = lockMap.find( seg.lockId );
+                    if( lit != lockMap.end() )
+                    {
+                        const auto& srcloc = m_worker.GetSourceLocation( lit->second->srcloc );
+                        ImGui::SameLine();
+                        ImGui::TextDisabled( "(%s)", m_worker.GetString( srcloc.name.active ? srcloc.name : srcloc.function ) );
+                    }
+                }
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted( m_worker.GetThreadName( seg.thread ) );
+                ImGui::TableNextColumn();
+                if( seg.zone )
+                {
+                    ImGui::PushID( i );
+                    if( ImGui::SmallButton( m_worker.GetZoneName( *seg.zone ) ) )
+                    {
+                        ShowZoneInfo( *seg.zone );
+                    }
+                    ImGui::PopID();
+                }
+                else
+                {
+                    TextDisabledUnformatted( "-" );
+                }
+            }
+        }
+        ImGui::EndTable();
+    }
+    ImGui::EndChild();
+    ImGui::End();
+}
+
+void View::DrawCriticalPathOverlay( uint64_t thread, const ImVec2& ul, const ImVec2& dr )
+{
+    const auto& cp = m_criticalPath;
+    const auto vStart = m_vd.zvStart;
+    const auto vEnd = m_vd.zvEnd;
+    if( vEnd <= vStart ) return;
+    const auto pxns = ( dr.x - ul.x ) / double( vEnd - vStart );
+
+    // The path is walked back in time and then reversed, so segments are ordered and don't overlap.
+    auto it = std::lower_bound( cp.path.begin(), cp.path.end(), vStart, [] ( const auto& l, const auto& r ) { return l.start < r; } );
+    if( it != cp.path.begin() ) --it;
+
+    auto draw = ImGui::GetWindowDrawList();
+    for( ; it != cp.path.end() && it->start <= vEnd; ++it )
+    {
+        const auto& seg = *it;
+        if( seg.thread != thread || seg.end < vStart ) continue;
+        const auto px0 = std::max( ul.x, float( ul.x + ( seg.start - vStart ) * pxns ) );
+        const auto px1 = std::min( dr.x, std::max( px0 + 1.f, float( ul.x + ( seg.end - vStart ) * pxns ) ) );
+        const auto color = CriticalPathTypeColor( int( seg.type ) );
+        draw->AddRectFilled( ImVec2( px0, ul.y ), ImVec2( px1, dr.y ), ( color & 0x00FFFFFF ) | 0x22000000 );
+        draw->AddRect( ImVec2( px0, ul.y ), ImVec2( px1, dr.y ), ( color & 0x00FFFFFF ) | 0x66000000 );
+    }
+}
+
+}
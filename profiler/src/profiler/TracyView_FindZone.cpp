@@ -76,10 +76,7 @@ uint64_t View::GetSelectionTarget( const Worker::ZoneThreadData& ev, FindZone::G
     case FindZone::GroupBy::Callstack:
         return m_worker.GetZoneExtra( *ev.Zone() ).callstack.Val();
     case FindZone::GroupBy::Parent:
-    {
-        const auto parent = GetZoneParent( *ev.Zone(), m_worker.DecompressThread( ev.Thread() ), m_worker );
-        return parent ? uint64_t( parent->SrcLoc() ) : 0;
-    }
+        return uint64_t( ev.ParentSrcLoc() );
     case FindZone::GroupBy::NoGrouping:
         return 0;
     default:
@@ -1726,11 +1723,8 @@ void View::DrawFindZone()
                 gid = m_worker.GetZoneExtra( *ev.Zone() ).callstack.Val();
                 break;
             case FindZone::GroupBy::Parent:
-            {
-                const auto parent = GetZoneParent( *ev.Zone(), m_worker.DecompressThread( ev.Thread() ), m_worker );
-                if( parent ) gid = uint64_t( uint16_t( parent->SrcLoc() ) );
+                gid = uint64_t( uint16_t( ev.ParentSrcLoc() ) );
                 break;
-            }
             case FindZone::GroupBy::NoGrouping:
                 break;
             default:
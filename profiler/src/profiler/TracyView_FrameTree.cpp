@@ -58,7 +58,19 @@ unordered_flat_map<uint32_t, View::MemPathData> View::GetCallstackPaths( const M
     unordered_flat_map<uint32_t, MemPathData> pathSum;
     pathSum.reserve( m_worker.GetCallstackPayloadCount() );
 
-    const bool hide_inactive = memRange == MemRange::Active;
+    auto addPath = [&pathSum] ( const MemEvent& ev ) {
+        if( ev.CsAlloc() == 0 ) return;
+        auto it = pathSum.find( ev.CsAlloc() );
+        if( it == pathSum.end() )
+        {
+            pathSum.emplace( ev.CsAlloc(), MemPathData { 1, ev.Size() } );
+        }
+        else
+        {
+            it->second.cnt++;
+            it->second.mem += ev.Size();
+        }
+    };
 
     if( m_memInfo.range.active )
     {
@@ -66,83 +78,46 @@ unordered_flat_map<uint32_t, View::MemPathData> View::GetCallstackPaths( const M
         if( it != mem.data.end() )
         {
             auto end = std::lower_bound( mem.data.begin(), mem.data.end(), m_memInfo.range.max, []( const auto& lhs, const auto& rhs ) { return lhs.TimeAlloc() < rhs; } );
-            if( memRange != MemRange::Full )
+            if( memRange == MemRange::Active )
+            {
+                mem.freeIndex.Live( mem.data.data(), it - mem.data.begin(), end - mem.data.begin(), m_memInfo.range.max, addPath );
+            }
+            else if( memRange == MemRange::Inactive )
             {
                 while( it != end )
                 {
                     auto& ev = *it++;
-                    if( ev.CsAlloc() == 0 ) continue;
-                    const bool is_inactive =  ev.TimeFree() >= 0 && ev.TimeFree() < m_memInfo.range.max;
-                    if( hide_inactive == is_inactive ) continue;
-                    auto pit = pathSum.find( ev.CsAlloc() );
-                    if( pit == pathSum.end() )
-                    {
-                        pathSum.emplace( ev.CsAlloc(), MemPathData { 1, ev.Size() } );
-                    }
-                    else
-                    {
-                        pit->second.cnt++;
-                        pit->second.mem += ev.Size();
-                    }
+                    if( ev.TimeFree() >= 0 && ev.TimeFree() < m_memInfo.range.max ) addPath( ev );
                 }
             }
             else
             {
-                while( it != end )
-                {
-                    auto& ev = *it++;
-                    if( ev.CsAlloc() == 0 ) continue;
-                    auto pit = pathSum.find( ev.CsAlloc() );
-                    if( pit == pathSum.end() )
-                    {
-                        pathSum.emplace( ev.CsAlloc(), MemPathData { 1, ev.Size() } );
-                    }
-                    else
-                    {
-                        pit->second.cnt++;
-                        pit->second.mem += ev.Size();
-                    }
-                }
+                while( it != end ) addPath( *it++ );
             }
         }
     }
     else
     {
-        if( memRange != MemRange::Full )
+        for( auto& v : mem.callstacks )
         {
-            for( auto& ev : mem.data )
-            {
-                if( ev.CsAlloc() == 0 ) continue;
-                const bool is_inactive =  ev.TimeFree() >= 0;
-                if( hide_inactive == is_inactive ) continue;
-                auto it = pathSum.find( ev.CsAlloc() );
-                if( it == pathSum.end() )
-                {
-                    pathSum.emplace( ev.CsAlloc(), MemPathData { 1, ev.Size() } );
-                }
-                else
-                {
-                    it->second.cnt++;
-                    it->second.mem += ev.Size();
-                }
-            }
-        }
-        else
-        {
-            for( auto& ev : mem.data )
-            {
-                if( ev.CsAlloc() == 0 ) continue;
-                auto it = pathSum.find( ev.CsAlloc() );
-                if( it == pathSum.end() )
-                {
-                    pathSum.emplace( ev.CsAlloc(), MemPathData { 1, ev.Size() } );
-                }
-                else
-                {
-                    it->second.cnt++;
-                    it->second.mem += ev.Size();
-                }
-            }
+            const auto& cs = v.second;
+            MemPathData data;
+            switch( memRange )
+            {
+            case MemRange::Full:
+                data = MemPathData { uint32_t( cs.allocs ), cs.bytes };
+                break;
+            case MemRange::Active:
+                data = MemPathData { uint32_t( cs.allocs - cs.frees ), cs.liveBytes };
+                break;
+            case MemRange::Inactive:
+                data = MemPathData { uint32_t( cs.frees ), cs.bytes - cs.liveBytes };
+                break;
+            default:
+                assert( false );
+                break;
+            }
+            if( data.cnt != 0 ) pathSum.emplace( v.first, data );
         }
     }
     return pathSum;
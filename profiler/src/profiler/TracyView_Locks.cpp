@@ -781,4 +781,291 @@ void View::DrawLockInfoWindow()
     if( !visible ) m_lockInfoWindow = InvalidId;
 }
 
+static void DrawLockHistogram( const char* id, const std::array<uint32_t, LockStats::WaitHistogramSize>& histogram, const char* emptyText )
+{
+    uint32_t maxBucket = 0;
+    for( auto& v : histogram ) maxBucket = std::max( maxBucket, v );
+    if( maxBucket == 0 )
+    {
+        TextDisabledUnformatted( emptyText );
+    }
+    else if( ImGui::BeginTable( id, 2, ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_SizingStretchProp ) )
+    {
+        const auto ty = ImGui::GetTextLineHeight();
+        for( int i=0; i<LockStats::WaitHistogramSize; i++ )
+        {
+            const auto cnt = histogram[i];
+            if( cnt == 0 ) continue;
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted( TimeToString( int64_t( 1 ) << i ) );
+            ImGui::SameLine();
+            TextDisabledUnformatted( "-" );
+            ImGui::SameLine();
+            ImGui::TextUnformatted( TimeToString( int64_t( 1 ) << ( i + 1 ) ) );
+            ImGui::TableNextColumn();
+            ImGui::ProgressBar( float( cnt ) / maxBucket, ImVec2( -1, ty ), RealToString( cnt ) );
+        }
+        ImGui::EndTable();
+    }
+}
+
+void View::DrawLockContention()
+{
+    const auto scale = GetScale();
+    ImGui::SetNextWindowSize( ImVec2( 1000 * scale, 600 * scale ), ImGuiCond_FirstUseEver );
+    ImGui::Begin( "Lock contention", &m_showLockContention );
+    if( ImGui::GetCurrentWindowRead()->SkipItems ) { ImGui::End(); return; }
+
+    static bool contendedOnly = true;
+
+    const auto& lockMap = m_worker.GetLockMap();
+    auto GetLockName = [this] ( const LockMap& lock ) {
+        if( lock.customName.Active() ) return m_worker.GetString( lock.customName );
+        return m_worker.GetString( m_worker.GetSourceLocation( lock.srcloc ).function );
+    };
+
+    ImGui::AlignTextToFramePadding();
+    TextDisabledUnformatted( "Name" );
+    ImGui::SameLine();
+    m_lockContentionFilter.Draw( ICON_FA_FILTER "###lockFilter", 200 );
+    ImGui::SameLine();
+    if( ImGui::Button( ICON_FA_DELETE_LEFT " Clear" ) )
+    {
+        m_lockContentionFilter.Clear();
+    }
+    ImGui::SameLine();
+    SmallCheckbox( "Contended only", &contendedOnly );
+
+    std::vector<decltype(lockMap.begin())> locks;
+    locks.reserve( lockMap.size() );
+    for( auto it = lockMap.begin(); it != lockMap.end(); ++it )
+    {
+        const auto& lock = *it->second;
+        if( !lock.valid ) continue;
+        if( contendedOnly && lock.stats.contendedCount == 0 ) continue;
+        if( m_lockContentionFilter.IsActive() && !m_lockContentionFilter.PassFilter( GetLockName( lock ) ) ) continue;
+        locks.emplace_back( it );
+    }
+
+    ImGui::SameLine();
+    ImGui::Spacing();
+    ImGui::SameLine();
+    TextFocused( "Locks:", RealToString( locks.size() ) );
+    ImGui::Separator();
+
+    auto selIt = lockMap.find( m_lockContentionSelected );
+    if( selIt == lockMap.end() ) m_lockContentionSelected = InvalidId;
+
+    ImGui::BeginChild( "##lockcontention", ImVec2( 0, selIt != lockMap.end() ? ImGui::GetContentRegionAvail().y * 0.55f : 0 ) );
+    if( ImGui::BeginTable( "##lockcontention", 9, ImGuiTableFlags_Resizable | ImGuiTableFlags_Reorderable | ImGuiTableFlags_Hideable | ImGuiTableFlags_Sortable | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_ScrollY ) )
+    {
+        ImGui::TableSetupScrollFreeze( 0, 1 );
+        ImGui::TableSetupColumn( "Lock", ImGuiTableColumnFlags_NoHide );
+        ImGui::TableSetupColumn( "Threads", ImGuiTableColumnFlags_PreferSortDescending | ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoResize );
+        ImGui::TableSetupColumn( "Acquisitions", ImGuiTableColumnFlags_PreferSortDescending | ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoResize );
+        ImGui::TableSetupColumn( "Contended", ImGuiTableColumnFlags_PreferSortDescending | ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoResize );
+        ImGui::TableSetupColumn( "Wait time", ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending | ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoResize );
+        ImGui::TableSetupColumn( "Max wait", ImGuiTableColumnFlags_PreferSortDescending | ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoResize );
+        ImGui::TableSetupColumn( "Hold time", ImGuiTableColumnFlags_PreferSortDescending | ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoResize );
+        ImGui::TableSetupColumn( "Max hold", ImGuiTableColumnFlags_PreferSortDescending | ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoResize );
+        ImGui::TableSetupColumn( "Top call site", ImGuiTableColumnFlags_NoSort );
+        ImGui::TableHeadersRow();
+
+        const auto& sortspec = *ImGui::TableGetSortSpecs()->Specs;
+        const auto desc = sortspec.SortDirection == ImGuiSortDirection_Descending;
+        switch( sortspec.ColumnIndex )
+        {
+        case 0:
+            pdqsort_branchless( locks.begin(), locks.end(), [&] ( const auto& l, const auto& r ) { return ( strcmp( GetLockName( *l->second ), GetLockName( *r->second ) ) < 0 ) != desc; } );
+            break;
+        case 1:
+            pdqsort_branchless( locks.begin(), locks.end(), [desc] ( const auto& l, const auto& r ) { return desc ? l->second->threadList.size() > r->second->threadList.size() : l->second->threadList.size() < r->second->threadList.size(); } );
+            break;
+        case 2:
+            pdqsort_branchless( locks.begin(), locks.end(), [desc] ( const auto& l, const auto& r ) { return desc ? l->second->stats.obtainCount > r->second->stats.obtainCount : l->second->stats.obtainCount < r->second->stats.obtainCount; } );
+            break;
+        case 3:
+            pdqsort_branchless( locks.begin(), locks.end(), [desc] ( const auto& l, const auto& r ) { return desc ? l->second->stats.contendedCount > r->second->stats.contendedCount : l->second->stats.contendedCount < r->second->stats.contendedCount; } );
+            break;
+        case 4:
+            pdqsort_branchless( locks.begin(), locks.end(), [desc] ( const auto& l, const auto& r ) { return desc ? l->second->stats.waitTotal > r->second->stats.waitTotal : l->second->stats.waitTotal < r->second->stats.waitTotal; } );
+            break;
+        case 5:
+            pdqsort_branchless( locks.begin(), locks.end(), [desc] ( const auto& l, const auto& r ) { return desc ? l->second->stats.waitMax > r->second->stats.waitMax : l->second->stats.waitMax < r->second->stats.waitMax; } );
+            break;
+        case 6:
+            pdqsort_branchless( locks.begin(), locks.end(), [desc] ( const auto& l, const auto& r ) { return desc ? l->second->stats.holdTotal > r->second->stats.holdTotal : l->second->stats.holdTotal < r->second->stats.holdTotal; } );
+            break;
+        case 7:
+            pdqsort_branchless( locks.begin(), locks.end(), [desc] ( const auto& l, const auto& r ) { return desc ? l->second->stats.holdMax > r->second->stats.holdMax : l->second->stats.holdMax < r->second->stats.holdMax; } );
+            break;
+        default:
+            assert( false );
+            break;
+        }
+
+        ImGuiListClipper clipper;
+        clipper.Begin( locks.size() );
+        while( clipper.Step() )
+        {
+            for( auto i=clipper.DisplayStart; i<clipper.DisplayEnd; i++ )
+            {
+                const auto id = locks[i]->first;
+                const auto& lock = *locks[i]->second;
+                const auto& stats = lock.stats;
+
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::PushID( id );
+                if( ImGui::Selectable( GetLockName( lock ), m_lockContentionSelected == id, ImGuiSelectableFlags_SpanAllColumns | ImGuiSelectableFlags_AllowItemOverlap ) )
+                {
+                    m_lockContentionSelected = id;
+                }
+                if( ImGui::IsItemHovered() )
+                {
+                    m_lockHoverHighlight = id;
+                    if( ImGui::IsItemClicked( 1 ) ) m_lockInfoWindow = id;
+                }
+                ImGui::PopID();
+                ImGui::SameLine();
+                ImGui::TextDisabled( "#%" PRIu32, id );
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted( RealToString( lock.threadList.size() ) );
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted( RealToString( stats.obtainCount ) );
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted( RealToString( stats.contendedCount ) );
+                if( stats.obtainCount != 0 )
+                {
+                    char buf[64];
+                    ImGui::SameLine();
+                    PrintStringPercent( buf, 100. * stats.contendedCount / stats.obtainCount );
+                    TextDisabledUnformatted( buf );
+                }
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted( TimeToString( stats.waitTotal ) );
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted( TimeToString( stats.waitMax ) );
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted( TimeToString( stats.holdTotal ) );
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted( TimeToString( stats.holdMax ) );
+                ImGui::TableNextColumn();
+                int16_t top = 0;
+                int64_t topWait = -1;
+                for( auto& v : stats.srcloc )
+                {
+                    if( v.first != 0 && v.second.waitTotal > topWait )
+                    {
+                        top = v.first;
+                        topWait = v.second.waitTotal;
+                    }
+                }
+                if( top == 0 )
+                {
+                    TextDisabledUnformatted( "-" );
+                }
+                else
+                {
+                    const auto& srcloc = m_worker.GetSourceLocation( top );
+                    TextDisabledUnformatted( LocationToString( m_worker.GetString( srcloc.file ), srcloc.line ) );
+                }
+            }
+        }
+        ImGui::EndTable();
+    }
+    ImGui::EndChild();
+
+    if( selIt != lockMap.end() )
+    {
+        const auto& lock = *selIt->second;
+        const auto& stats = lock.stats;
+
+        ImGui::Separator();
+        ImGui::PushFont( m_bigFont );
+        ImGui::Text( "Lock #%" PRIu32 ": %s", selIt->first, GetLockName( lock ) );
+        ImGui::PopFont();
+        ImGui::SameLine();
+        if( ImGui::SmallButton( ICON_FA_CIRCLE_INFO " Lock info" ) )
+        {
+            m_lockInfoWindow = selIt->first;
+        }
+
+        ImGui::BeginChild( "##lockcontentiondetails" );
+        if( stats.aggregated.waitCount != 0 )
+        {
+            TextFocused( "Aggregated acquisitions:", RealToString( stats.aggregated.waitCount ) );
+            ImGui::SameLine();
+            TextDisabledUnformatted( "(counted on the client, not shown on the timeline)" );
+        }
+        if( ImGui::TreeNodeEx( "Wait time histogram", ImGuiTreeNodeFlags_DefaultOpen ) )
+        {
+            DrawLockHistogram( "##lockwaithistogram", stats.waitHistogram, "No contended acquisitions." );
+            ImGui::TreePop();
+        }
+        if( ImGui::TreeNodeEx( "Hold time histogram" ) )
+        {
+            DrawLockHistogram( "##lockholdhistogram", stats.holdHistogram, "No released acquisitions." );
+            ImGui::TreePop();
+        }
+
+        if( ImGui::TreeNodeEx( "Call sites", ImGuiTreeNodeFlags_DefaultOpen ) )
+        {
+            std::vector<decltype(stats.srcloc.begin())> sites;
+            sites.reserve( stats.srcloc.size() );
+            for( auto it = stats.srcloc.begin(); it != stats.srcloc.end(); ++it ) sites.emplace_back( it );
+            pdqsort_branchless( sites.begin(), sites.end(), [] ( const auto& l, const auto& r ) { return l->second.waitTotal > r->second.waitTotal; } );
+
+            if( ImGui::BeginTable( "##lockcallsites", 6, ImGuiTableFlags_Resizable | ImGuiTableFlags_BordersInnerV ) )
+            {
+                ImGui::TableSetupColumn( "Location" );
+                ImGui::TableSetupColumn( "Acquisitions", ImGuiTableColumnFlags_WidthFixed );
+                ImGui::TableSetupColumn( "Contended", ImGuiTableColumnFlags_WidthFixed );
+                ImGui::TableSetupColumn( "Wait time", ImGuiTableColumnFlags_WidthFixed );
+                ImGui::TableSetupColumn( "Max wait", ImGuiTableColumnFlags_WidthFixed );
+                ImGui::TableSetupColumn( "Hold time", ImGuiTableColumnFlags_WidthFixed );
+                ImGui::TableHeadersRow();
+                for( auto& v : sites )
+                {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    if( v->first == 0 )
+                    {
+                        TextDisabledUnformatted( "Unmarked" );
+                    }
+                    else
+                    {
+                        const auto& srcloc = m_worker.GetSourceLocation( v->first );
+                        const auto fileName = m_worker.GetString( srcloc.file );
+                        ImGui::TextUnformatted( LocationToString( fileName, srcloc.line ) );
+                        if( ImGui::IsItemHovered() )
+                        {
+                            DrawSourceTooltip( fileName, srcloc.line );
+                            if( ImGui::IsItemClicked( 1 ) && SourceFileValid( fileName, m_worker.GetCaptureTime(), *this, m_worker ) )
+                            {
+                                ViewSource( fileName, srcloc.line );
+                            }
+                        }
+                    }
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted( RealToString( v->second.count ) );
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted( RealToString( v->second.contended ) );
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted( TimeToString( v->second.waitTotal ) );
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted( TimeToString( v->second.waitMax ) );
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted( TimeToString( v->second.holdTotal ) );
+                }
+                ImGui::EndTable();
+            }
+            ImGui::TreePop();
+        }
+        ImGui::EndChild();
+    }
+    ImGui::End();
+}
+
 }
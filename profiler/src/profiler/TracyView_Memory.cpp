@@ -331,16 +331,10 @@ void View::DrawMemory()
             if( it != mem.data.end() )
             {
                 auto end = std::lower_bound( it, mem.data.end(), m_memInfo.range.max, [] ( const auto& lhs, const auto& rhs ) { return lhs.TimeAlloc() < rhs; } );
-                while( it != end )
-                {
-                    const auto tf = it->TimeFree();
-                    if( tf < 0 || tf >= m_memInfo.range.max )
-                    {
-                        items.emplace_back( it );
-                        total += it->Size();
-                    }
-                    ++it;
-                }
+                mem.freeIndex.Live( mem.data.data(), it - mem.data.begin(), end - mem.data.begin(), m_memInfo.range.max, [&] ( const MemEvent& ev ) {
+                    items.emplace_back( &ev );
+                    total += ev.Size();
+                } );
             }
         }
         else
@@ -238,6 +238,15 @@ void View::DrawNotificationArea()
         {
             ImGui::BeginTooltip();
             ImGui::TextUnformatted( "Processing background tasks" );
+            const auto& sp = m_worker.GetSampleProgress();
+            const auto sampleTotal = sp.subTotal.load( std::memory_order_relaxed );
+            const auto sampleDone = sp.subProgress.load( std::memory_order_relaxed );
+            if( sampleDone < sampleTotal )
+            {
+                TextDisabledUnformatted( "Samples:" );
+                ImGui::SameLine();
+                ImGui::Text( "%.1f%%", 100.f * sampleDone / sampleTotal );
+            }
             ImGui::EndTooltip();
         }
     }
@@ -16,6 +16,8 @@ struct SrcLocZonesSlim
     uint16_t numThreads;
     size_t numZones;
     int64_t total;
+    int64_t offCpu = 0;
+    int64_t percentile[DurationSketch::NumPercentiles] = {};
 };
 
 void View::AccumulationModeComboBox()
@@ -588,8 +590,29 @@ void View::DrawStatistics()
         }
         else
         {
+            // Off-CPU totals cover the whole capture, so they are not shown for range limited statistics.
+            const bool showOffCpu = m_statMode == 0 && !m_statRange.active && m_worker.AreZoneOffCpuTimesReady();
+            if( showOffCpu )
+            {
+                for( auto& v : srcloc )
+                {
+                    const auto& slz = m_worker.GetZonesForSourceLocation( v.srcloc );
+                    v.offCpu = slz.preemptedTotal + slz.lockWaitTotal + slz.otherWaitTotal;
+                }
+            }
+            // Percentiles come from the duration sketches, which cover the whole capture and include child zones.
+            const bool showPercentiles = m_statMode == 0 && !m_statRange.active;
+            if( showPercentiles )
+            {
+                for( auto& v : srcloc )
+                {
+                    auto& sketch = m_worker.GetZonesForSourceLocation( v.srcloc ).durations;
+                    if( sketch.total != 0 ) memcpy( v.percentile, sketch.Percentiles(), sizeof( v.percentile ) );
+                }
+            }
+
             ImGui::BeginChild( "##statistics" );
-            if( ImGui::BeginTable( "##statistics", m_statMode == 0 ? 6 : 5,
+            if( ImGui::BeginTable( "##statistics", m_statMode == 0 ? ( 6 + ( showOffCpu ? 1 : 0 ) + ( showPercentiles ? 4 : 0 ) ) : 5,
                 ImGuiTableFlags_Resizable | ImGuiTableFlags_Reorderable | ImGuiTableFlags_Hideable | ImGuiTableFlags_Sortable | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_ScrollY ) )
             {
                 ImGui::TableSetupScrollFreeze( 0, 1 );
@@ -599,10 +622,20 @@ void View::DrawStatistics()
                 ImGui::TableSetupColumn( "Counts", ImGuiTableColumnFlags_PreferSortDescending | ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoResize );
                 ImGui::TableSetupColumn( "MTPC", ImGuiTableColumnFlags_PreferSortDescending | ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoResize );
                 if( m_statMode == 0 ) ImGui::TableSetupColumn( ICON_FA_SHUFFLE, ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending | ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoResize );
+                if( showOffCpu ) ImGui::TableSetupColumn( "Off-CPU", ImGuiTableColumnFlags_PreferSortDescending | ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoResize );
+                if( showPercentiles )
+                {
+                    ImGui::TableSetupColumn( "p50", ImGuiTableColumnFlags_PreferSortDescending | ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoResize );
+                    ImGui::TableSetupColumn( "p90", ImGuiTableColumnFlags_PreferSortDescending | ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoResize );
+                    ImGui::TableSetupColumn( "p99", ImGuiTableColumnFlags_PreferSortDescending | ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoResize );
+                    ImGui::TableSetupColumn( "p999", ImGuiTableColumnFlags_PreferSortDescending | ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoResize );
+                }
                 ImGui::TableHeadersRow();
 
                 const auto& sortspec = *ImGui::TableGetSortSpecs()->Specs;
-                switch( sortspec.ColumnIndex )
+                auto sortColumn = sortspec.ColumnIndex;
+                if( !showOffCpu && sortColumn >= 6 ) sortColumn++;
+                switch( sortColumn )
                 {
                 case 0:
                     if( sortspec.SortDirection == ImGuiSortDirection_Ascending )
@@ -676,6 +709,32 @@ void View::DrawStatistics()
                         pdqsort_branchless( srcloc.begin(), srcloc.end(), []( const auto& lhs, const auto& rhs ) { return lhs.numThreads > rhs.numThreads; } );
                     }
                     break;
+                case 6:
+                    if( sortspec.SortDirection == ImGuiSortDirection_Ascending )
+                    {
+                        pdqsort_branchless( srcloc.begin(), srcloc.end(), []( const auto& lhs, const auto& rhs ) { return lhs.offCpu < rhs.offCpu; } );
+                    }
+                    else
+                    {
+                        pdqsort_branchless( srcloc.begin(), srcloc.end(), []( const auto& lhs, const auto& rhs ) { return lhs.offCpu > rhs.offCpu; } );
+                    }
+                    break;
+                case 7:
+                case 8:
+                case 9:
+                case 10:
+                {
+                    const auto idx = sortColumn - 7;
+                    if( sortspec.SortDirection == ImGuiSortDirection_Ascending )
+                    {
+                        pdqsort_branchless( srcloc.begin(), srcloc.end(), [idx]( const auto& lhs, const auto& rhs ) { return lhs.percentile[idx] < rhs.percentile[idx]; } );
+                    }
+                    else
+                    {
+                        pdqsort_branchless( srcloc.begin(), srcloc.end(), [idx]( const auto& lhs, const auto& rhs ) { return lhs.percentile[idx] > rhs.percentile[idx]; } );
+                    }
+                    break;
+                }
                 default:
                     assert( false );
                     break;
@@ -754,6 +813,34 @@ void View::DrawStatistics()
                         ImGui::TableNextColumn();
                         ImGui::TextUnformatted( RealToString( v.numThreads ) );
                     }
+                    if( showOffCpu )
+                    {
+                        ImGui::TableNextColumn();
+                        const auto& slz = m_worker.GetZonesForSourceLocation( v.srcloc );
+                        ImGui::TextUnformatted( TimeToString( v.offCpu ) );
+                        ImGui::SameLine();
+                        PrintStringPercent( buf, slz.total == 0 ? 0. : 100. * v.offCpu / slz.total );
+                        TextDisabledUnformatted( buf );
+                        if( ImGui::IsItemHovered() )
+                        {
+                            ImGui::BeginTooltip();
+                            TextFocused( "On-CPU time:", TimeToString( slz.onCpuTotal ) );
+                            TextFocused( "Preempted:", TimeToString( slz.preemptedTotal ) );
+                            TextFocused( "Waiting on lock:", TimeToString( slz.lockWaitTotal ) );
+                            TextFocused( "Other waits:", TimeToString( slz.otherWaitTotal ) );
+                            ImGui::Separator();
+                            TextDisabledUnformatted( "Includes time spent in child zones." );
+                            ImGui::EndTooltip();
+                        }
+                    }
+                    if( showPercentiles )
+                    {
+                        for( auto& p : v.percentile )
+                        {
+                            ImGui::TableNextColumn();
+                            ImGui::TextUnformatted( TimeToString( p ) );
+                        }
+                    }
                     ImGui::PopID();
 
                     if( copySrclocsToClipboard )
@@ -170,6 +170,9 @@ const ZoneEvent* View::FindZoneAtTime( uint64_t thread, int64_t time ) const
     }
     if( !td ) return nullptr;
 
+#ifndef TRACY_NO_STATISTICS
+    return td->zoneIndex.ZoneAt( time );
+#else
     const Vector<short_ptr<ZoneEvent>>* timeline = &td->timeline;
     if( timeline->empty() ) return nullptr;
     const ZoneEvent* ret = nullptr;
@@ -195,6 +198,7 @@ const ZoneEvent* View::FindZoneAtTime( uint64_t thread, int64_t time ) const
             timeline = &m_worker.GetZoneChildren( (*it)->Child() );
         }
     }
+#endif
 }
 
 const ZoneEvent* View::GetZoneChild( const ZoneEvent& zone, int64_t time ) const
@@ -271,6 +275,9 @@ const ZoneEvent* View::GetZoneParent( const ZoneEvent& zone ) const
 const ZoneEvent* View::GetZoneParent( const ZoneEvent& zone, uint64_t tid, const Worker &worker ) const
 {
     const auto thread = worker.GetThreadData( tid );
+#ifndef TRACY_NO_STATISTICS
+    return thread->zoneIndex.Parent( zone );
+#else
     const ZoneEvent* parent = nullptr;
     const Vector<short_ptr<ZoneEvent>>* timeline = &thread->timeline;
     if( timeline->empty() ) return nullptr;
@@ -299,6 +306,7 @@ const ZoneEvent* View::GetZoneParent( const ZoneEvent& zone, uint64_t tid, const
         }
     }
     return nullptr;
+#endif
 }
 
 bool View::IsZoneReentry( const ZoneEvent& zone ) const
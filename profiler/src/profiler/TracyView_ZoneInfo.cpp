@@ -344,6 +344,13 @@ void View::DrawZoneInfoWindow()
 			}
 		}
 
+		ImGui::SameLine();
+		if ( ImGui::Button( ICON_FA_ROUTE " Critical path" ) )
+		{
+			CalcCriticalPath( ev );
+			m_criticalPath.show = true;
+		}
+
 		ImGui::NewLine();
 
         if( m_worker.HasZoneExtra( ev ) && m_worker.GetZoneExtra( ev ).callstack.Val() != 0 )
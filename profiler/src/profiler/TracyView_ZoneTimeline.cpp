@@ -224,6 +224,10 @@ void View::DrawThreadOverlays( const ThreadData& thread, const ImVec2& ul, const
         draw->AddRectFilled( ul, dr, 0x2DFF8888 );
         draw->AddRect( ul, dr, 0x4DFF8888 );
     }
+    if( m_criticalPath.show && m_criticalPath.highlight )
+    {
+        DrawCriticalPathOverlay( thread.id, ul, dr );
+    }
 }
 
 void View::DrawZoneList( const TimelineContext& ctx, const std::vector<TimelineDraw>& drawList, int _offset, uint64_t tidOrCoreIndex )
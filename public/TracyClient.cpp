@@ -47,6 +47,7 @@
 #      include "libbacktrace/elf.cpp"
 #    endif
 #    include "common/TracyStackFrames.cpp"
+#    include "common/TracySymbolCache.cpp"
 #  endif
 #endif
 
@@ -1,4 +1,5 @@
 #include <limits>
+#include <mutex>
 #include <new>
 #include <stdio.h>
 #include <string.h>
@@ -6,6 +7,7 @@
 #include "TracyDebug.hpp"
 #include "TracyFastVector.hpp"
 #include "TracyStringHelpers.hpp"
+#include "TracyThread.hpp"
 #include "../common/TracyAlloc.hpp"
 #include "../common/TracySystem.hpp"
 
@@ -94,6 +96,7 @@ extern "C" const char* ___tracy_demangle( const char* mangled )
 #if TRACY_HAS_CALLSTACK == 3
 #   define TRACY_USE_IMAGE_CACHE
 #   include <link.h>
+#   include "../common/TracySymbolCache.hpp"
 #endif
 
 namespace tracy
@@ -103,6 +106,8 @@ namespace tracy
 // when we have access to dl_iterate_phdr(), we can build a cache of address ranges to image paths
 // so we can quickly determine which image an address falls into.
 // We refresh this cache only when we hit an address that doesn't fall into any known range.
+// With a symbol cache directory, the build ids of the images are recorded as well, so that
+// resolved symbols can be persisted across runs.
 class ImageCache
 {
 public:
@@ -111,10 +116,15 @@ public:
         void* m_startAddress = nullptr;
         void* m_endAddress = nullptr;
         char* m_name = nullptr;
+        uint8_t* m_buildId = nullptr;
+        size_t m_buildIdSize = 0;
+        SymbolCache* m_symbolCache = nullptr;
+        bool m_symbolCacheOpened = false;
     };
 
-    ImageCache()
+    ImageCache( const char* symbolCacheDir )
         : m_images( 512 )
+        , m_symbolCacheDir( symbolCacheDir )
     {
         Refresh();
     }
@@ -124,9 +134,9 @@ public:
         Clear();
     }
 
-    const ImageEntry* GetImageForAddress( void* address )
+    ImageEntry* GetImageForAddress( void* address )
     {
-        const ImageEntry* entry = GetImageForAddressImpl( address );
+        ImageEntry* entry = GetImageForAddressImpl( address );
         if( !entry )
         {
             Refresh();
@@ -135,8 +145,19 @@ public:
         return entry;
     }
 
+    SymbolCache* GetSymbolCache( ImageEntry& entry )
+    {
+        if( !entry.m_symbolCacheOpened )
+        {
+            entry.m_symbolCacheOpened = true;
+            if( entry.m_buildId ) entry.m_symbolCache = SymbolCache::Open( m_symbolCacheDir, entry.m_buildId, entry.m_buildIdSize );
+        }
+        return entry.m_symbolCache;
+    }
+
 private:
     tracy::FastVector<ImageEntry> m_images;
+    const char* m_symbolCacheDir;
     bool m_updated = false;
     bool m_haveMainImageName = false;
 
@@ -169,6 +190,28 @@ private:
             image->m_name = nullptr;
         }
 
+        image->m_buildId = nullptr;
+        image->m_buildIdSize = 0;
+        image->m_symbolCache = nullptr;
+        image->m_symbolCacheOpened = false;
+        if( cache->m_symbolCacheDir )
+        {
+            uint8_t buildId[SymbolCacheMaxBuildId];
+            size_t buildIdSize;
+            for( uint32_t i=0; i<headerCount; i++ )
+            {
+                const auto& phdr = info->dlpi_phdr[i];
+                if( phdr.p_type != PT_NOTE ) continue;
+                if( GetElfBuildIdFromNotes( (const void*)( info->dlpi_addr + phdr.p_vaddr ), phdr.p_memsz, buildId, buildIdSize ) )
+                {
+                    image->m_buildId = (uint8_t*)tracy_malloc( buildIdSize );
+                    memcpy( image->m_buildId, buildId, buildIdSize );
+                    image->m_buildIdSize = buildIdSize;
+                    break;
+                }
+            }
+        }
+
         cache->m_updated = true;
 
         return 0;
@@ -224,7 +267,7 @@ private:
         m_haveMainImageName = true;
     }
 
-    const ImageEntry* GetImageForAddressImpl( void* address ) const
+    ImageEntry* GetImageForAddressImpl( void* address )
     {
         auto it = std::lower_bound( m_images.begin(), m_images.end(), address,
             []( const ImageEntry& lhs, const void* rhs ) { return lhs.m_startAddress > rhs; } );
@@ -241,6 +284,8 @@ private:
         for( ImageEntry& entry : m_images )
         {
             tracy_free( entry.m_name );
+            tracy_free( entry.m_buildId );
+            SymbolCache::Close( entry.m_symbolCache );
         }
 
         m_images.clear();
@@ -755,16 +800,28 @@ CallstackEntryData DecodeCallstackPtr( uint64_t ptr )
 
 #elif TRACY_HAS_CALLSTACK == 2 || TRACY_HAS_CALLSTACK == 3 || TRACY_HAS_CALLSTACK == 4 || TRACY_HAS_CALLSTACK == 6
 
-enum { MaxCbTrace = 64 };
+enum { MaxCbTrace = CallstackMaxFrames };
 
 struct backtrace_state* cb_bts = nullptr;
 
-int cb_num;
+// Frames decoded by one call to DecodeCallstackPtr(), passed to the libbacktrace callbacks.
+struct CallstackDecode
+{
+    CallstackEntry* data;
+    int num;
+};
+
 CallstackEntry cb_data[MaxCbTrace];
 int cb_fixup;
+static int s_symbolThreads = 1;
 #ifdef TRACY_USE_IMAGE_CACHE
 static ImageCache* s_imageCache = nullptr;
+static char* s_symbolCacheDir = nullptr;
+// Guards the image cache and the symbol caches when more than one symbol thread is used.
+static std::mutex s_imageCacheLock;
 #endif //#ifdef TRACY_USE_IMAGE_CACHE
+// The demangling function may reuse its buffer between calls.
+static std::mutex s_demangleLock;
 
 #ifdef TRACY_DEBUGINFOD
 debuginfod_client* s_debuginfod;
@@ -955,18 +1012,61 @@ void InitCallstackCritical()
 {
 }
 
+struct PrebuildJob
+{
+    int index;
+    int count;
+};
+
+static void InitErrorCb( void*, const char*, int )
+{
+}
+
+static void PrebuildWorker( void* ptr )
+{
+    ThreadExitHandler threadExitHandler;
+    SetThreadName( "Tracy Symbols" );
+    auto job = (const PrebuildJob*)ptr;
+    backtrace_prebuild( cb_bts, job->index, job->count, InitErrorCb, nullptr );
+}
+
+// Reads the line and function tables of all compilation units on the given number of threads,
+// instead of doing it serially as the first callstack from each unit gets resolved.
+static void PrebuildDebugInfo( int threads )
+{
+    if( !backtrace_fileline_initialize( cb_bts, InitErrorCb, nullptr ) ) return;
+
+    auto jobs = (PrebuildJob*)tracy_malloc( sizeof( PrebuildJob ) * threads );
+    auto workers = (Thread*)tracy_malloc( sizeof( Thread ) * threads );
+    for( int i=0; i<threads; i++ )
+    {
+        jobs[i] = { i, threads };
+        new(workers+i) Thread( PrebuildWorker, jobs+i );
+    }
+    for( int i=0; i<threads; i++ ) workers[i].~Thread();
+    tracy_free( workers );
+    tracy_free( jobs );
+}
+
 void InitCallstack()
 {
     InitRpmalloc();
 
-#ifdef TRACY_USE_IMAGE_CACHE
-    s_imageCache = (ImageCache*)tracy_malloc( sizeof( ImageCache ) );
-    new(s_imageCache) ImageCache();
-#endif //#ifdef TRACY_USE_IMAGE_CACHE
-
 #ifndef TRACY_SYMBOL_OFFLINE_RESOLVE
     s_shouldResolveSymbolsOffline = ShouldResolveSymbolsOffline();
 #endif //#ifndef TRACY_SYMBOL_OFFLINE_RESOLVE
+
+#ifdef TRACY_USE_IMAGE_CACHE
+    // use TRACY_SYMBOL_CACHE_DIR to persist resolved symbols of images with a build id
+    const char* symbolCacheDir = GetEnvVar( "TRACY_SYMBOL_CACHE_DIR" );
+    if( symbolCacheDir && *symbolCacheDir && !s_shouldResolveSymbolsOffline )
+    {
+        s_symbolCacheDir = CopyString( symbolCacheDir );
+    }
+
+    s_imageCache = (ImageCache*)tracy_malloc( sizeof( ImageCache ) );
+    new(s_imageCache) ImageCache( s_symbolCacheDir );
+#endif //#ifdef TRACY_USE_IMAGE_CACHE
     if( s_shouldResolveSymbolsOffline )
     {
         cb_bts = nullptr; // disable use of libbacktrace calls
@@ -974,7 +1074,31 @@ void InitCallstack()
     }
     else
     {
-        cb_bts = backtrace_create_state( nullptr, 0, nullptr, nullptr );
+        // use TRACY_SYMBOL_THREADS to resolve symbols on this many threads, sharing a threaded libbacktrace state
+        const char* symbolThreads = GetEnvVar( "TRACY_SYMBOL_THREADS" );
+        if( symbolThreads )
+        {
+            s_symbolThreads = std::min( std::max( atoi( symbolThreads ), 1 ), (int)CallstackMaxSymbolThreads );
+        }
+        if( s_symbolThreads > 1 )
+        {
+            // Lookups on a threaded state must not race on reading the executable for the first time.
+            cb_bts = backtrace_create_state( nullptr, 1, InitErrorCb, nullptr );
+            if( cb_bts && !backtrace_fileline_initialize( cb_bts, InitErrorCb, nullptr ) ) s_symbolThreads = 1;
+        }
+        if( !cb_bts )
+        {
+            s_symbolThreads = 1;
+            cb_bts = backtrace_create_state( nullptr, 0, nullptr, nullptr );
+        }
+
+        // use TRACY_SYMBOL_PREBUILD_THREADS to read the debug info upfront, on this many threads
+        const char* prebuildThreads = GetEnvVar( "TRACY_SYMBOL_PREBUILD_THREADS" );
+        if( prebuildThreads && cb_bts )
+        {
+            const int threads = atoi( prebuildThreads );
+            if( threads > 0 ) PrebuildDebugInfo( std::min( threads, 64 ) );
+        }
     }
 
 #ifndef TRACY_DEMANGLE
@@ -1062,6 +1186,7 @@ void EndCallstack()
         s_imageCache->~ImageCache();
         tracy_free( s_imageCache );
     }
+    tracy_free( s_symbolCacheDir );
 #endif //#ifdef TRACY_USE_IMAGE_CACHE
 #ifndef TRACY_DEMANGLE
     ___tracy_free_demangle_buffer();
@@ -1096,6 +1221,11 @@ const char* DecodeCallstackPtrFast( uint64_t ptr )
     return ret;
 }
 
+int GetSymbolThreadCount()
+{
+    return s_symbolThreads;
+}
+
 static int SymbolAddressDataCb( void* data, uintptr_t pc, uintptr_t lowaddr, const char* fn, int lineno, const char* function )
 {
     auto& sym = *(CallstackSymbolData*)data;
@@ -1139,11 +1269,13 @@ CallstackSymbolData DecodeSymbolAddress( uint64_t ptr )
     return sym;
 }
 
-static int CallstackDataCb( void* /*data*/, uintptr_t pc, uintptr_t lowaddr, const char* fn, int lineno, const char* function )
+static int CallstackDataCb( void* data, uintptr_t pc, uintptr_t lowaddr, const char* fn, int lineno, const char* function )
 {
-    cb_data[cb_num].symLen = 0;
-    cb_data[cb_num].symAddr = (uint64_t)lowaddr;
+    auto& cb = *(CallstackDecode*)data;
+    cb.data[cb.num].symLen = 0;
+    cb.data[cb.num].symAddr = (uint64_t)lowaddr;
 
+    std::unique_lock<std::mutex> demangleLock( s_demangleLock, std::defer_lock );
     if( !fn && !function )
     {
         const char* symname = nullptr;
@@ -1155,6 +1287,7 @@ static int CallstackDataCb( void* /*data*/, uintptr_t pc, uintptr_t lowaddr, con
         {
             symname = dlinfo.dli_sname;
             symoff = (char*)pc - (char*)dlinfo.dli_saddr;
+            demangleLock.lock();
             const char* demangled = ___tracy_demangle( symname );
             if( demangled ) symname = demangled;
         }
@@ -1164,7 +1297,7 @@ static int CallstackDataCb( void* /*data*/, uintptr_t pc, uintptr_t lowaddr, con
         if( symoff == 0 )
         {
             const auto len = std::min<size_t>( strlen( symname ), std::numeric_limits<uint16_t>::max() );
-            cb_data[cb_num].name = CopyStringFast( symname, len );
+            cb.data[cb.num].name = CopyStringFast( symname, len );
         }
         else
         {
@@ -1175,11 +1308,11 @@ static int CallstackDataCb( void* /*data*/, uintptr_t pc, uintptr_t lowaddr, con
             memcpy( name, symname, namelen );
             memcpy( name + namelen, buf, offlen );
             name[namelen + offlen] = '\0';
-            cb_data[cb_num].name = name;
+            cb.data[cb.num].name = name;
         }
 
-        cb_data[cb_num].file = CopyStringFast( "[unknown]" );
-        cb_data[cb_num].line = 0;
+        cb.data[cb.num].file = CopyStringFast( "[unknown]" );
+        cb.data[cb.num].line = 0;
     }
     else
     {
@@ -1190,18 +1323,19 @@ static int CallstackDataCb( void* /*data*/, uintptr_t pc, uintptr_t lowaddr, con
         }
         else
         {
+            demangleLock.lock();
             const char* demangled = ___tracy_demangle( function );
             if( demangled ) function = demangled;
         }
 
         const auto len = std::min<size_t>( strlen( function ), std::numeric_limits<uint16_t>::max() );
-        cb_data[cb_num].name = CopyStringFast( function, len );
-        cb_data[cb_num].file = NormalizePath( fn );
-        if( !cb_data[cb_num].file ) cb_data[cb_num].file = CopyStringFast( fn );
-        cb_data[cb_num].line = lineno;
+        cb.data[cb.num].name = CopyStringFast( function, len );
+        cb.data[cb.num].file = NormalizePath( fn );
+        if( !cb.data[cb.num].file ) cb.data[cb.num].file = CopyStringFast( fn );
+        cb.data[cb.num].line = lineno;
     }
 
-    if( ++cb_num >= MaxCbTrace )
+    if( ++cb.num >= MaxCbTrace )
     {
         return 1;
     }
@@ -1211,33 +1345,77 @@ static int CallstackDataCb( void* /*data*/, uintptr_t pc, uintptr_t lowaddr, con
     }
 }
 
-static void CallstackErrorCb( void* /*data*/, const char* /*msg*/, int /*errnum*/ )
+static void CallstackErrorCb( void* data, const char* /*msg*/, int /*errnum*/ )
 {
-    for( int i=0; i<cb_num; i++ )
+    auto& cb = *(CallstackDecode*)data;
+    for( int i=0; i<cb.num; i++ )
     {
-        tracy_free_fast( (void*)cb_data[i].name );
-        tracy_free_fast( (void*)cb_data[i].file );
+        tracy_free_fast( (void*)cb.data[i].name );
+        tracy_free_fast( (void*)cb.data[i].file );
     }
 
-    cb_data[0].name = CopyStringFast( "[error]" );
-    cb_data[0].file = CopyStringFast( "[error]" );
-    cb_data[0].line = 0;
+    cb.data[0].name = CopyStringFast( "[error]" );
+    cb.data[0].file = CopyStringFast( "[error]" );
+    cb.data[0].line = 0;
 
-    cb_num = 1;
+    cb.num = 1;
 }
 
-void SymInfoCallback( void* /*data*/, uintptr_t pc, const char* symname, uintptr_t symval, uintptr_t symsize )
+void SymInfoCallback( void* data, uintptr_t pc, const char* symname, uintptr_t symval, uintptr_t symsize )
 {
-    cb_data[cb_num-1].symLen = (uint32_t)symsize;
-    cb_data[cb_num-1].symAddr = (uint64_t)symval;
+    auto& cb = *(CallstackDecode*)data;
+    cb.data[cb.num-1].symLen = (uint32_t)symsize;
+    cb.data[cb.num-1].symAddr = (uint64_t)symval;
 }
 
-void SymInfoError( void* /*data*/, const char* /*msg*/, int /*errnum*/ )
+void SymInfoError( void* data, const char* /*msg*/, int /*errnum*/ )
 {
-    cb_data[cb_num-1].symLen = 0;
-    cb_data[cb_num-1].symAddr = 0;
+    auto& cb = *(CallstackDecode*)data;
+    cb.data[cb.num-1].symLen = 0;
+    cb.data[cb.num-1].symAddr = 0;
 }
 
+#ifdef TRACY_USE_IMAGE_CACHE
+static bool GetCachedCallstackFrames( const SymbolCache* cache, uint64_t offset, uint64_t imageBaseAddress, CallstackDecode& cb )
+{
+    SymbolCacheFrame frames[MaxCbTrace];
+    uint8_t flags;
+    std::lock_guard<std::mutex> lock( s_imageCacheLock );
+    const auto num = cache->Find( offset, frames, MaxCbTrace, flags );
+    // Offline records lack the inline frames and symbol addresses, resolve these again.
+    if( num == 0 || ( flags & SymbolCache::Offline ) ) return false;
+    for( int i=0; i<num; i++ )
+    {
+        cb.data[i].name = CopyStringFast( frames[i].name, frames[i].nameLen );
+        cb.data[i].file = CopyStringFast( frames[i].file, frames[i].fileLen );
+        cb.data[i].line = frames[i].line;
+        cb.data[i].symLen = frames[i].symLen;
+        cb.data[i].symAddr = frames[i].symOffset == SymbolCacheNoOffset ? 0 : frames[i].symOffset + imageBaseAddress;
+    }
+    cb.num = num;
+    return true;
+}
+
+static void StoreCachedCallstackFrames( SymbolCache* cache, uint64_t offset, uint64_t imageBaseAddress, const CallstackDecode& cb )
+{
+    if( strcmp( cb.data[0].name, "[error]" ) == 0 ) return;
+
+    SymbolCacheFrame frames[MaxCbTrace];
+    for( int i=0; i<cb.num; i++ )
+    {
+        frames[i].name = cb.data[i].name;
+        frames[i].file = cb.data[i].file;
+        frames[i].nameLen = uint16_t( std::min<size_t>( strlen( cb.data[i].name ), std::numeric_limits<uint16_t>::max() ) );
+        frames[i].fileLen = uint16_t( std::min<size_t>( strlen( cb.data[i].file ), std::numeric_limits<uint16_t>::max() ) );
+        frames[i].line = cb.data[i].line;
+        frames[i].symLen = cb.data[i].symLen;
+        frames[i].symOffset = cb.data[i].symAddr >= imageBaseAddress ? cb.data[i].symAddr - imageBaseAddress : SymbolCacheNoOffset;
+    }
+    std::lock_guard<std::mutex> lock( s_imageCacheLock );
+    cache->Add( offset, frames, cb.num, 0 );
+}
+#endif //#ifdef TRACY_USE_IMAGE_CACHE
+
 void GetSymbolForOfflineResolve(void* address, uint64_t imageBaseAddress, CallstackEntry& cbEntry)
 {
     // tagged with a string that we can identify as an unresolved symbol
@@ -1250,19 +1428,31 @@ void GetSymbolForOfflineResolve(void* address, uint64_t imageBaseAddress, Callst
 }
 
 CallstackEntryData DecodeCallstackPtr( uint64_t ptr )
+{
+    return DecodeCallstackPtr( ptr, cb_data );
+}
+
+CallstackEntryData DecodeCallstackPtr( uint64_t ptr, CallstackEntry* frames )
 {
     InitRpmalloc();
+    CallstackDecode cb = { frames, 0 };
     if( ptr >> 63 == 0 )
     {
         const char* imageName = nullptr;
         uint64_t imageBaseAddress = 0x0;
 
 #ifdef TRACY_USE_IMAGE_CACHE
-        const auto* image = s_imageCache->GetImageForAddress((void*)ptr);
-        if( image )
+        SymbolCache* symbolCache = nullptr;
         {
-            imageName = image->m_name;
-            imageBaseAddress = uint64_t(image->m_startAddress);
+            // The image entry may move once the lock is released, but its name stays valid.
+            std::lock_guard<std::mutex> lock( s_imageCacheLock );
+            auto* image = s_imageCache->GetImageForAddress((void*)ptr);
+            if( image )
+            {
+                imageName = image->m_name;
+                imageBaseAddress = uint64_t(image->m_startAddress);
+                if( !s_shouldResolveSymbolsOffline ) symbolCache = s_imageCache->GetSymbolCache( *image );
+            }
         }
 #else
         Dl_info dlinfo;
@@ -1275,19 +1465,27 @@ CallstackEntryData DecodeCallstackPtr( uint64_t ptr )
 
         if( s_shouldResolveSymbolsOffline )
         {
-            cb_num = 1;
-            GetSymbolForOfflineResolve( (void*)ptr, imageBaseAddress, cb_data[0] );
+            cb.num = 1;
+            GetSymbolForOfflineResolve( (void*)ptr, imageBaseAddress, cb.data[0] );
         }
         else
         {
-            cb_num = 0;
-            backtrace_pcinfo( cb_bts, ptr, CallstackDataCb, CallstackErrorCb, nullptr );
-            assert( cb_num > 0 );
+#ifdef TRACY_USE_IMAGE_CACHE
+            if( !symbolCache || !GetCachedCallstackFrames( symbolCache, ptr - imageBaseAddress, imageBaseAddress, cb ) )
+#endif
+            {
+                cb.num = 0;
+                backtrace_pcinfo( cb_bts, ptr, CallstackDataCb, CallstackErrorCb, &cb );
+                assert( cb.num > 0 );
 
-            backtrace_syminfo( cb_bts, ptr, SymInfoCallback, SymInfoError, nullptr );
+                backtrace_syminfo( cb_bts, ptr, SymInfoCallback, SymInfoError, &cb );
+#ifdef TRACY_USE_IMAGE_CACHE
+                if( symbolCache ) StoreCachedCallstackFrames( symbolCache, ptr - imageBaseAddress, imageBaseAddress, cb );
+#endif
+            }
         }
 
-        return { cb_data, uint8_t( cb_num ), imageName ? imageName : "[unknown]" };
+        return { cb.data, uint8_t( cb.num ), imageName ? imageName : "[unknown]" };
     }
 #ifdef __linux
     else if( s_kernelSym )
@@ -1295,22 +1493,22 @@ CallstackEntryData DecodeCallstackPtr( uint64_t ptr )
         auto it = std::lower_bound( s_kernelSym, s_kernelSym + s_kernelSymCnt, ptr, []( const KernelSymbol& lhs, const uint64_t& rhs ) { return lhs.addr + lhs.size < rhs; } );
         if( it != s_kernelSym + s_kernelSymCnt )
         {
-            cb_data[0].name = CopyStringFast( it->name );
-            cb_data[0].file = CopyStringFast( "<kernel>" );
-            cb_data[0].line = 0;
-            cb_data[0].symLen = it->size;
-            cb_data[0].symAddr = it->addr;
-            return { cb_data, 1, it->mod ? it->mod : "<kernel>" };
+            cb.data[0].name = CopyStringFast( it->name );
+            cb.data[0].file = CopyStringFast( "<kernel>" );
+            cb.data[0].line = 0;
+            cb.data[0].symLen = it->size;
+            cb.data[0].symAddr = it->addr;
+            return { cb.data, 1, it->mod ? it->mod : "<kernel>" };
         }
     }
 #endif
 
-    cb_data[0].name = CopyStringFast( "[unknown]" );
-    cb_data[0].file = CopyStringFast( "<kernel>" );
-    cb_data[0].line = 0;
-    cb_data[0].symLen = 0;
-    cb_data[0].symAddr = 0;
-    return { cb_data, 1, "<kernel>" };
+    cb.data[0].name = CopyStringFast( "[unknown]" );
+    cb.data[0].file = CopyStringFast( "<kernel>" );
+    cb.data[0].line = 0;
+    cb.data[0].symLen = 0;
+    cb.data[0].symAddr = 0;
+    return { cb.data, 1, "<kernel>" };
 }
 
 #elif TRACY_HAS_CALLSTACK == 5
@@ -75,6 +75,19 @@ const uint8_t* GetBuildIdForImage( const char* image, size_t& size );
 debuginfod_client* GetDebuginfodClient();
 #endif
 
+#if TRACY_HAS_CALLSTACK == 2 || TRACY_HAS_CALLSTACK == 3 || TRACY_HAS_CALLSTACK == 4 || TRACY_HAS_CALLSTACK == 6
+#  define TRACY_HAS_SYMBOL_THREADS
+enum { CallstackMaxFrames = 64 };
+enum { CallstackMaxSymbolThreads = 64 };
+
+// Number of threads that may resolve symbols at the same time, set by TRACY_SYMBOL_THREADS.
+// Valid after InitCallstack().
+int GetSymbolThreadCount();
+// Decodes into the given array of CallstackMaxFrames entries. Up to GetSymbolThreadCount()
+// threads may call this and DecodeSymbolAddress() at once.
+CallstackEntryData DecodeCallstackPtr( uint64_t ptr, CallstackEntry* frames );
+#endif
+
 #if TRACY_HAS_CALLSTACK == 1
 
 extern "C"
@@ -6,11 +6,153 @@
 
 #include "../common/TracySystem.hpp"
 #include "../common/TracyAlign.hpp"
+#include "../common/TracyYield.hpp"
 #include "TracyProfiler.hpp"
 
 namespace tracy
 {
 
+#ifdef TRACY_LOCK_AGGREGATE
+#  ifndef TRACY_LOCK_AGGREGATE_THRESHOLD
+#    define TRACY_LOCK_AGGREGATE_THRESHOLD 10000    // ns
+#  endif
+#  ifndef TRACY_LOCK_AGGREGATE_FLUSH
+#    define TRACY_LOCK_AGGREGATE_FLUSH 100          // ms
+#  endif
+
+// Per thread accumulator for one lock. Acquisitions that waited less than the
+// threshold are only counted here, slower ones are sent as regular events.
+struct LockAggregateSlot
+{
+    enum { HistogramSize = 32 };
+
+    uint32_t id;
+    uint32_t depth;
+    bool full;
+    int64_t waitStart;
+    int64_t holdStart;
+    uint32_t waitCount;
+    uint32_t holdCount;
+    int64_t waitTotal;
+    int64_t waitMax;
+    int64_t holdTotal;
+    int64_t holdMax;
+    uint32_t waitHistogram[HistogramSize];
+    uint32_t holdHistogram[HistogramSize];
+};
+
+class LockAggregateTable
+{
+public:
+    enum { Size = 32 };
+
+    // Tables register themselves with the profiler, which flushes them every
+    // TRACY_LOCK_AGGREGATE_FLUSH ms. Counters left at thread exit are flushed
+    // by the destructor.
+    LockAggregateTable();
+    ~LockAggregateTable();
+
+    // Returns the slot for a lock that is about to be acquired. A slot used by a
+    // currently held lock is never evicted, nullptr means full events are to be sent.
+    tracy_force_inline LockAggregateSlot* Acquire( uint32_t id )
+    {
+        auto& slot = m_slots[id % Size];
+        if( slot.id == id ) return &slot;
+        if( slot.depth != 0 ) return nullptr;
+        Lock();
+        Flush( slot );
+        slot.id = id;
+        Unlock();
+        return &slot;
+    }
+
+    tracy_force_inline LockAggregateSlot* Find( uint32_t id )
+    {
+        auto& slot = m_slots[id % Size];
+        return slot.id == id ? &slot : nullptr;
+    }
+
+    tracy_force_inline int64_t Threshold() const { return m_threshold; }
+
+    // Counters are only changed with the table locked, as the profiler thread may
+    // flush them at any time. The lock is only ever contended by a flush.
+    tracy_force_inline void Lock() { while( m_lock.exchange( true, std::memory_order_acquire ) ) YieldThread(); }
+    tracy_force_inline void Unlock() { m_lock.store( false, std::memory_order_release ); }
+
+    void FlushAll()
+    {
+        Lock();
+        for( auto& v : m_slots ) Flush( v );
+        Unlock();
+    }
+
+    static tracy_force_inline void AddToHistogram( uint32_t* histogram, int64_t time )
+    {
+        int bucket = 0;
+        while( time > 1 && bucket < LockAggregateSlot::HistogramSize - 1 )
+        {
+            time >>= 1;
+            bucket++;
+        }
+        histogram[bucket]++;
+    }
+
+    static void Flush( LockAggregateSlot& slot )
+    {
+        if( slot.waitCount != 0 )
+        {
+            SendCounter( QueueType::LockAggregateWait, slot.id, slot.waitCount, slot.waitTotal, slot.waitMax );
+            SendHistogram( slot.id, 0, slot.waitHistogram );
+        }
+        if( slot.holdCount != 0 )
+        {
+            SendCounter( QueueType::LockAggregateHold, slot.id, slot.holdCount, slot.holdTotal, slot.holdMax );
+            SendHistogram( slot.id, 1, slot.holdHistogram );
+        }
+        slot.waitCount = slot.holdCount = 0;
+        slot.waitTotal = slot.waitMax = slot.holdTotal = slot.holdMax = 0;
+        memset( slot.waitHistogram, 0, sizeof( slot.waitHistogram ) );
+        memset( slot.holdHistogram, 0, sizeof( slot.holdHistogram ) );
+    }
+
+private:
+    static void SendCounter( QueueType type, uint32_t id, uint32_t count, int64_t total, int64_t max )
+    {
+        auto item = Profiler::QueueSerial();
+        MemWrite( &item->hdr.type, type );
+        MemWrite( &item->lockAggregate.id, id );
+        MemWrite( &item->lockAggregate.count, count );
+        MemWrite( &item->lockAggregate.total, total );
+        MemWrite( &item->lockAggregate.max, max );
+        Profiler::QueueSerialFinish();
+    }
+
+    static void SendHistogram( uint32_t id, uint8_t hold, const uint32_t* histogram )
+    {
+        for( uint8_t i=0; i<LockAggregateSlot::HistogramSize; i++ )
+        {
+            if( histogram[i] == 0 ) continue;
+            auto item = Profiler::QueueSerial();
+            MemWrite( &item->hdr.type, QueueType::LockAggregateHistogram );
+            MemWrite( &item->lockAggregateHistogram.id, id );
+            MemWrite( &item->lockAggregateHistogram.hold, hold );
+            MemWrite( &item->lockAggregateHistogram.bucket, i );
+            MemWrite( &item->lockAggregateHistogram.count, histogram[i] );
+            Profiler::QueueSerialFinish();
+        }
+    }
+
+    LockAggregateSlot m_slots[Size];
+    int64_t m_threshold;
+    std::atomic<bool> m_lock;
+    LockAggregateTable* m_next;
+
+    friend class Profiler;
+};
+
+TRACY_API LockAggregateTable& GetLockAggregateTable();
+#endif
+
 class LockableCtx
 {
 public:
@@ -40,6 +182,15 @@ public:
 
     tracy_force_inline ~LockableCtx()
     {
+#ifdef TRACY_LOCK_AGGREGATE
+        auto& table = GetLockAggregateTable();
+        if( auto slot = table.Find( m_id ) )
+        {
+            table.Lock();
+            LockAggregateTable::Flush( *slot );
+            table.Unlock();
+        }
+#endif
         auto item = Profiler::QueueSerial();
         MemWrite( &item->hdr.type, QueueType::LockTerminate );
         MemWrite( &item->lockTerminate.id, m_id );
@@ -65,6 +216,14 @@ public:
         if( !queue ) return false;
 #endif
 
+#ifdef TRACY_LOCK_AGGREGATE
+        if( auto slot = GetLockAggregateTable().Acquire( m_id ) )
+        {
+            slot->waitStart = Profiler::GetTime();
+            return true;
+        }
+#endif
+
         auto item = Profiler::QueueSerial();
         MemWrite( &item->hdr.type, QueueType::LockWait );
         MemWrite( &item->lockWait.thread, GetThreadHandle() );
@@ -76,6 +235,38 @@ public:
 
     tracy_force_inline void AfterLock()
     {
+#ifdef TRACY_LOCK_AGGREGATE
+        auto& table = GetLockAggregateTable();
+        if( auto slot = table.Find( m_id ) )
+        {
+            const auto time = Profiler::GetTime();
+            const auto wait = time - slot->waitStart;
+            if( slot->depth == 0 ) slot->full = wait >= table.Threshold();
+            slot->depth++;
+            if( !slot->full )
+            {
+                Aggregate( table, *slot, wait, time );
+                return;
+            }
+
+            // The wait was too long to only be counted, send it with its original start time.
+            auto item = Profiler::QueueSerial();
+            MemWrite( &item->hdr.type, QueueType::LockWait );
+            MemWrite( &item->lockWait.thread, GetThreadHandle() );
+            MemWrite( &item->lockWait.id, m_id );
+            MemWrite( &item->lockWait.time, slot->waitStart );
+            Profiler::QueueSerialFinish();
+
+            item = Profiler::QueueSerial();
+            MemWrite( &item->hdr.type, QueueType::LockObtain );
+            MemWrite( &item->lockObtain.thread, GetThreadHandle() );
+            MemWrite( &item->lockObtain.id, m_id );
+            MemWrite( &item->lockObtain.time, time );
+            Profiler::QueueSerialFinish();
+            return;
+        }
+#endif
+
         auto item = Profiler::QueueSerial();
         MemWrite( &item->hdr.type, QueueType::LockObtain );
         MemWrite( &item->lockObtain.thread, GetThreadHandle() );
@@ -86,6 +277,10 @@ public:
 
     tracy_force_inline void AfterUnlock()
     {
+#ifdef TRACY_LOCK_AGGREGATE
+        if( AfterUnlockAggregated() ) return;
+#endif
+
 #ifdef TRACY_ON_DEMAND
         m_lockCount.fetch_sub( 1, std::memory_order_relaxed );
         if( !m_active.load( std::memory_order_relaxed ) ) return;
@@ -122,6 +317,18 @@ public:
 
         if( acquired )
         {
+#ifdef TRACY_LOCK_AGGREGATE
+            auto& table = GetLockAggregateTable();
+            auto slot = table.Acquire( m_id );
+            if( slot && ( slot->depth == 0 || !slot->full ) )
+            {
+                slot->full = false;
+                slot->depth++;
+                Aggregate( table, *slot, 0, Profiler::GetTime() );
+                return;
+            }
+            if( slot ) slot->depth++;
+#endif
             auto item = Profiler::QueueSerial();
             MemWrite( &item->hdr.type, QueueType::LockObtain );
             MemWrite( &item->lockObtain.thread, GetThreadHandle() );
@@ -144,6 +351,12 @@ public:
         }
 #endif
 
+#ifdef TRACY_LOCK_AGGREGATE
+        // Aggregated acquisitions have no event on the server to attach the mark to.
+        auto slot = GetLockAggregateTable().Find( m_id );
+        if( slot && slot->depth != 0 && !slot->full ) return;
+#endif
+
         auto item = Profiler::QueueSerial();
         MemWrite( &item->hdr.type, QueueType::LockMark );
         MemWrite( &item->lockMark.thread, GetThreadHandle() );
@@ -169,6 +382,67 @@ public:
     }
 
 private:
+#ifdef TRACY_LOCK_AGGREGATE
+    // The slot bookkeeping is done even when disconnected, so that the slot is not left pinned.
+    tracy_force_inline bool AfterUnlockAggregated()
+    {
+        auto& table = GetLockAggregateTable();
+        auto slot = table.Find( m_id );
+        if( !slot || slot->depth == 0 ) return false;
+
+#ifdef TRACY_ON_DEMAND
+        m_lockCount.fetch_sub( 1, std::memory_order_relaxed );
+#endif
+
+        const auto time = Profiler::GetTime();
+        const auto full = slot->full;
+        if( --slot->depth == 0 )
+        {
+            slot->full = false;
+            if( !full )
+            {
+                const auto hold = time - slot->holdStart;
+                table.Lock();
+                slot->holdCount++;
+                slot->holdTotal += hold;
+                if( slot->holdMax < hold ) slot->holdMax = hold;
+                LockAggregateTable::AddToHistogram( slot->holdHistogram, hold );
+                table.Unlock();
+            }
+        }
+
+#ifdef TRACY_ON_DEMAND
+        if( !m_active.load( std::memory_order_relaxed ) ) return true;
+        if( !GetProfiler().IsConnected() )
+        {
+            m_active.store( false, std::memory_order_relaxed );
+            return true;
+        }
+#endif
+
+        if( full )
+        {
+            auto item = Profiler::QueueSerial();
+            MemWrite( &item->hdr.type, QueueType::LockRelease );
+            MemWrite( &item->lockRelease.id, m_id );
+            MemWrite( &item->lockRelease.time, time );
+            Profiler::QueueSerialFinish();
+        }
+        return true;
+    }
+
+    static tracy_force_inline void Aggregate( LockAggregateTable& table, LockAggregateSlot& slot, int64_t wait, int64_t time )
+    {
+        table.Lock();
+        slot.waitCount++;
+        slot.waitTotal += wait;
+        if( slot.waitMax < wait ) slot.waitMax = wait;
+        LockAggregateTable::AddToHistogram( slot.waitHistogram, wait );
+        table.Unlock();
+        if( slot.depth == 1 ) slot.holdStart = time;
+    }
+#endif
+
     uint32_t m_id;
 
 #ifdef TRACY_ON_DEMAND
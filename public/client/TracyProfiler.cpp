@@ -59,7 +59,9 @@
 #include <assert.h>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <limits>
+#include <mutex>
 #include <new>
 #include <stdlib.h>
 #include <string.h>
@@ -67,9 +69,11 @@
 #include <thread>
 #include <unordered_set>
 #include <unordered_map>
+#include <vector>
 
 #include "../common/TracyAlign.hpp"
 #include "../common/TracyAlloc.hpp"
+#include "../common/TracyHistogram.hpp"
 #include "../common/TracySocket.hpp"
 #include "../common/TracySystem.hpp"
 #include "../common/TracyYield.hpp"
@@ -1092,6 +1096,15 @@ void Profiler::AckServerQuery()
     AppendDataUnsafe( &item, QueueDataSize[(int)QueueType::AckServerQueryNoop] );
 }
 
+void Profiler::AckServerQueryBatch( uint32_t seq )
+{
+    QueueItem item;
+    MemWrite( &item.hdr.type, QueueType::AckServerQueryBatch );
+    MemWrite( &item.serverQueryBatchAck.seq, seq );
+    NeedDataSize( QueueDataSize[(int)QueueType::AckServerQueryBatch] );
+    AppendDataUnsafe( &item, QueueDataSize[(int)QueueType::AckServerQueryBatch] );
+}
+
 void Profiler::AckSymbolCodeNotAvailable()
 {
     QueueItem item;
@@ -1244,6 +1257,12 @@ static Thread* s_sysTraceThread = nullptr;
 
 static long s_profilerTid = 0;
 static long s_symbolTid = 0;
+#  ifdef TRACY_HAS_SYMBOL_THREADS
+// Helpers reserve a slot, store their tid in it and only then publish it in the count.
+static std::atomic<long> s_symbolHelperTid[CallstackMaxSymbolThreads];
+static std::atomic<int> s_symbolHelperSlots { 0 };
+static std::atomic<int> s_symbolHelperCount { 0 };
+#  endif
 static char s_crashText[1024];
 static std::atomic<bool> s_alreadyCrashed( false );
 
@@ -1252,6 +1271,19 @@ static void ThreadFreezer( int /*signal*/ )
     for(;;) sleep( 1000 );
 }
 
+static bool IsSymbolThread( long tid )
+{
+    if( tid == s_symbolTid ) return true;
+#  ifdef TRACY_HAS_SYMBOL_THREADS
+    const auto num = s_symbolHelperCount.load( std::memory_order_acquire );
+    for( int i=0; i<num; i++ )
+    {
+        if( s_symbolHelperTid[i].load( std::memory_order_acquire ) == tid ) return true;
+    }
+#  endif
+    return false;
+}
+
 static inline void HexPrint( char*& ptr, uint64_t val )
 {
     if( val == 0 )
@@ -1448,7 +1480,7 @@ static void CrashHandler( int signal, siginfo_t* info, void* /*ucontext*/ )
     {
         if( ep->d_name[0] == '.' ) continue;
         int tid = atoi( ep->d_name );
-        if( tid != selfTid && tid != s_profilerTid && tid != s_symbolTid )
+        if( tid != selfTid && tid != s_profilerTid && !IsSymbolThread( tid ) )
         {
             syscall( SYS_tkill, tid, TRACY_CRASH_SIGNAL );
         }
@@ -1456,7 +1488,7 @@ static void CrashHandler( int signal, siginfo_t* info, void* /*ucontext*/ )
     closedir( dp );
 
 #ifdef TRACY_NEEDS_SYMBOL_WORKER
-    if( selfTid == s_symbolTid ) s_symbolThreadGone.store( true, std::memory_order_release );
+    if( IsSymbolThread( selfTid ) ) s_symbolThreadGone.store( true, std::memory_order_release );
 #endif
 
     TracyLfqPrepare( QueueType::Crash );
@@ -1470,6 +1502,116 @@ static void CrashHandler( int signal, siginfo_t* info, void* /*ucontext*/ )
 }
 #endif
 
+#ifdef TRACY_HAS_SYMBOL_THREADS
+// Helper threads of the symbol worker. A batch of symbol queries is split between them and
+// the symbol worker itself, which waits for all of them to finish before sending the results.
+class SymbolThreadPool
+{
+public:
+    SymbolThreadPool( int threads )
+        : m_num( threads )
+        , m_threads( (Thread*)tracy_malloc( sizeof( Thread ) * threads ) )
+    {
+        for( int i=0; i<threads; i++ ) new(m_threads+i) Thread( LaunchWorker, this );
+
+        // The crash handler must not freeze a helper before its tid is known, Run() would never return.
+        std::unique_lock<std::mutex> lock( m_lock );
+        m_done.wait( lock, [this] { return m_started == m_num; } );
+    }
+
+    ~SymbolThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock( m_lock );
+            m_exit = true;
+        }
+        m_cv.notify_all();
+        for( int i=0; i<m_num; i++ ) m_threads[i].~Thread();
+        tracy_free( m_threads );
+    }
+
+    // Calls func for every index in [0, count) and returns when all calls are done.
+    void Run( size_t count, void(*func)( size_t idx, void* ptr ), void* ptr )
+    {
+        {
+            std::lock_guard<std::mutex> lock( m_lock );
+            m_func = func;
+            m_ptr = ptr;
+            m_count = count;
+            m_next.store( 0, std::memory_order_relaxed );
+            m_busy = m_num;
+            m_generation++;
+        }
+        m_cv.notify_all();
+        Process();
+        std::unique_lock<std::mutex> lock( m_lock );
+        m_done.wait( lock, [this] { return m_busy == 0; } );
+    }
+
+private:
+    static void LaunchWorker( void* ptr ) { ((SymbolThreadPool*)ptr)->Worker(); }
+
+    void Worker()
+    {
+#if defined __linux__ && !defined TRACY_NO_CRASH_HANDLER
+        const auto idx = s_symbolHelperSlots.fetch_add( 1, std::memory_order_relaxed );
+        s_symbolHelperTid[idx].store( syscall( SYS_gettid ), std::memory_order_release );
+        s_symbolHelperCount.fetch_add( 1, std::memory_order_release );
+#endif
+        {
+            std::lock_guard<std::mutex> lock( m_lock );
+            if( ++m_started == m_num ) m_done.notify_one();
+        }
+        ThreadExitHandler threadExitHandler;
+        SetThreadName( "Tracy Symbol Helper" );
+#ifdef TRACY_USE_RPMALLOC
+        InitRpmalloc();
+#endif
+        uint64_t generation = 0;
+        for(;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock( m_lock );
+                m_cv.wait( lock, [this, generation] { return m_exit || m_generation != generation; } );
+                if( m_exit ) return;
+                generation = m_generation;
+            }
+            Process();
+            std::lock_guard<std::mutex> lock( m_lock );
+            if( --m_busy == 0 ) m_done.notify_one();
+        }
+    }
+
+    void Process()
+    {
+        for(;;)
+        {
+            const auto idx = m_next.fetch_add( 1, std::memory_order_relaxed );
+            if( idx >= m_count ) break;
+            m_func( idx, m_ptr );
+        }
+    }
+
+    int m_num;
+    Thread* m_threads;
+
+    std::mutex m_lock;
+    std::condition_variable m_cv;
+    std::condition_variable m_done;
+    uint64_t m_generation = 0;
+    bool m_exit = false;
+    int m_busy = 0;
+    int m_started = 0;
+
+    void(*m_func)( size_t idx, void* ptr ) = nullptr;
+    void* m_ptr = nullptr;
+    size_t m_count = 0;
+    std::atomic<size_t> m_next { 0 };
+};
+
+static SymbolThreadPool* s_symbolPool = nullptr;
+#endif
+
 
 enum { QueuePrealloc = 256 * 1024 };
 
@@ -1709,6 +1851,45 @@ TRACY_API LuaZoneState& GetLuaZoneState() { return s_luaZoneState; }
 TRACY_API bool ProfilerAvailable() { return s_instance != nullptr; }
 TRACY_API bool ProfilerAllocatorAvailable() { return !RpThreadShutdown; }
 
+#ifdef TRACY_LOCK_AGGREGATE
+static TracyMutex& GetLockAggregateTablesLock()
+{
+    static TracyMutex lock;
+    return lock;
+}
+
+static LockAggregateTable* s_lockAggregateTables = nullptr;
+
+LockAggregateTable::LockAggregateTable()
+    : m_lock( false )
+{
+    memset( m_slots, 0, sizeof( m_slots ) );
+    for( auto& v : m_slots ) v.id = (std::numeric_limits<uint32_t>::max)();
+    m_threshold = int64_t( TRACY_LOCK_AGGREGATE_THRESHOLD / GetProfiler().GetTimerMul() );
+
+    std::lock_guard<TracyMutex> lock( GetLockAggregateTablesLock() );
+    m_next = s_lockAggregateTables;
+    s_lockAggregateTables = this;
+}
+
+LockAggregateTable::~LockAggregateTable()
+{
+    {
+        std::lock_guard<TracyMutex> lock( GetLockAggregateTablesLock() );
+        auto ptr = &s_lockAggregateTables;
+        while( *ptr != this ) ptr = &(*ptr)->m_next;
+        *ptr = m_next;
+    }
+    if( ProfilerAvailable() ) FlushAll();
+}
+
+TRACY_API LockAggregateTable& GetLockAggregateTable()
+{
+    thread_local LockAggregateTable table;
+    return table;
+}
+#endif
+
 TRACY_API void RequestListenAndBroadcast()
 {
 	GetProfiler().RequestListenAndBroadcast();
@@ -1741,7 +1922,7 @@ Profiler::Profiler()
     , m_fiDequeue( 16 )
 #endif
 #if defined(TRACY_NEEDS_SYMBOL_WORKER)
-    , m_symbolQueue( 8*1024 )
+    , m_symbolQueue( SymbolQueueSize )
 #endif
     , m_frameCount( 0 )
     , m_isConnected( false )
@@ -2924,6 +3105,7 @@ void Profiler::Worker()
         for(;;)
         {
             ProcessSysTime();
+            ProcessLockAggregates();
 #ifdef TRACY_HAS_SYSPOWER
             m_sysPower.Tick();
 #endif
@@ -3228,6 +3410,10 @@ static void FreeAssociatedMemory( const QueueItem& item )
         ptr = MemRead<uint64_t>( &item.callstackFat.ptr );
         tracy_free( (void*)ptr );
         break;
+    case QueueType::HistogramData:
+        ptr = MemRead<uint64_t>( &item.histogramDataFat.payload );
+        tracy_free( (void*)ptr );
+        break;
     case QueueType::CallstackAlloc:
         ptr = MemRead<uint64_t>( &item.callstackAllocFat.nativePtr );
         tracy_free( (void*)ptr );
@@ -3508,6 +3694,25 @@ Profiler::DequeueStatus Profiler::Dequeue( moodycamel::ConsumerToken& token )
                         MemWrite( &item->plotDataInt.time, dt );
                         break;
                     }
+                    case QueueType::CounterData:
+                    {
+                        int64_t t = MemRead<int64_t>( &item->counterData.time );
+                        int64_t dt = t - refThread;
+                        refThread = t;
+                        MemWrite( &item->counterData.time, dt );
+                        break;
+                    }
+                    case QueueType::HistogramData:
+                    {
+                        ptr = MemRead<uint64_t>( &item->histogramDataFat.payload );
+                        SendHistogramPayload( ptr );
+                        tracy_free_fast( (void*)ptr );
+                        int64_t t = MemRead<int64_t>( &item->histogramData.time );
+                        int64_t dt = t - refThread;
+                        refThread = t;
+                        MemWrite( &item->histogramData.time, dt );
+                        break;
+                    }
                     case QueueType::ContextSwitch:
                     {
                         int64_t t = MemRead<int64_t>( &item->contextSwitch.time );
@@ -4234,6 +4439,201 @@ void Profiler::SendCallstackAlloc( uint64_t _ptr )
     AppendDataUnsafe( ptr, len );
 }
 
+void Profiler::SendHistogramPayload( uint64_t _ptr )
+{
+    auto ptr = (const char*)_ptr;
+
+    QueueItem item;
+    MemWrite( &item.hdr.type, QueueType::HistogramPayload );
+    MemWrite( &item.stringTransfer.ptr, _ptr );
+
+    uint16_t len;
+    memcpy( &len, ptr, 2 );
+    ptr += 2;
+
+    NeedDataSize( QueueDataSize[(int)QueueType::HistogramPayload] + sizeof( len ) + len );
+
+    AppendDataUnsafe( &item, QueueDataSize[(int)QueueType::HistogramPayload] );
+    AppendDataUnsafe( &len, sizeof( len ) );
+    AppendDataUnsafe( ptr, len );
+}
+
+#ifndef TRACY_METRICS_FLUSH
+#  define TRACY_METRICS_FLUSH 100
+#endif
+
+// Per-thread accumulators for TracyCounter and TracyHistogram. Windows are aligned
+// to a global grid, so that the server can merge the data sent by each thread for
+// the same window. This also makes an early flush, when a table runs full, lossless.
+class MetricsTable
+{
+public:
+    enum { MaxCounters = 32 };
+    enum { MaxHistograms = 8 };
+
+    MetricsTable()
+        : m_numCounters( 0 )
+        , m_numHistograms( 0 )
+        , m_windowEnd( 0 )
+    {
+        m_period = int64_t( TRACY_METRICS_FLUSH * 1000000. / GetProfiler().GetTimerMul() );
+        if( m_period < 1 ) m_period = 1;
+        // The destructor sends through the thread's queue token, which has to be
+        // created first, so that it is destroyed after the table.
+        GetToken();
+    }
+
+    ~MetricsTable()
+    {
+        if( ProfilerAvailable() && ProfilerAllocatorAvailable() ) Flush();
+    }
+
+    tracy_force_inline void Advance()
+    {
+        const auto time = Profiler::GetTime();
+        if( time < m_windowEnd ) return;
+        Flush();
+        m_windowEnd = ( time / m_period + 1 ) * m_period;
+    }
+
+    void AddCounter( const char* name, int64_t val )
+    {
+        Advance();
+        for( int i=0; i<m_numCounters; i++ )
+        {
+            if( m_counters[i].name == name )
+            {
+                m_counters[i].val += val;
+                return;
+            }
+        }
+        if( m_numCounters == MaxCounters ) Flush();
+        m_counters[m_numCounters++] = { name, val };
+    }
+
+    void AddHistogram( const char* name, int64_t val )
+    {
+        Advance();
+        Histogram* hist = nullptr;
+        for( int i=0; i<m_numHistograms; i++ )
+        {
+            if( m_histograms[i].name == name )
+            {
+                hist = m_histograms + i;
+                break;
+            }
+        }
+        if( !hist )
+        {
+            if( m_numHistograms == MaxHistograms ) Flush();
+            hist = m_histograms + m_numHistograms++;
+            hist->name = name;
+            hist->min = val;
+            hist->max = val;
+            hist->sum = 0;
+            memset( hist->buckets, 0, sizeof( hist->buckets ) );
+        }
+        if( hist->min > val ) hist->min = val;
+        else if( hist->max < val ) hist->max = val;
+        hist->sum += double( val );
+        hist->buckets[HistogramBucket( val < 0 ? 0 : uint64_t( val ) )]++;
+    }
+
+private:
+    struct Counter
+    {
+        const char* name;
+        int64_t val;
+    };
+
+    struct Histogram
+    {
+        const char* name;
+        int64_t min;
+        int64_t max;
+        double sum;
+        uint32_t buckets[HistogramBuckets];
+    };
+
+    void Flush()
+    {
+#ifdef TRACY_ON_DEMAND
+        if( !GetProfiler().IsConnected() )
+        {
+            m_numCounters = 0;
+            m_numHistograms = 0;
+            return;
+        }
+#endif
+        for( int i=0; i<m_numCounters; i++ )
+        {
+            TracyLfqPrepare( QueueType::CounterData );
+            MemWrite( &item->counterData.name, (uint64_t)m_counters[i].name );
+            MemWrite( &item->counterData.time, m_windowEnd );
+            MemWrite( &item->counterData.val, m_counters[i].val );
+            TracyLfqCommit;
+        }
+        for( int i=0; i<m_numHistograms; i++ )
+        {
+            // Payload: min, max, sum, then ( bucket, count ) pairs of the non-empty buckets.
+            auto& hist = m_histograms[i];
+            uint16_t num = 0;
+            for( auto& v : hist.buckets ) if( v != 0 ) num++;
+            const auto len = uint16_t( 24 + num * 6 );
+            auto ptr = (char*)tracy_malloc( sizeof( len ) + len );
+            auto dst = ptr;
+            memcpy( dst, &len, 2 ); dst += 2;
+            memcpy( dst, &hist.min, 8 ); dst += 8;
+            memcpy( dst, &hist.max, 8 ); dst += 8;
+            memcpy( dst, &hist.sum, 8 ); dst += 8;
+            for( uint16_t b=0; b<HistogramBuckets; b++ )
+            {
+                if( hist.buckets[b] == 0 ) continue;
+                memcpy( dst, &b, 2 );
+                memcpy( dst+2, hist.buckets + b, 4 );
+                dst += 6;
+            }
+
+            TracyLfqPrepare( QueueType::HistogramData );
+            MemWrite( &item->histogramDataFat.name, (uint64_t)hist.name );
+            MemWrite( &item->histogramDataFat.time, m_windowEnd );
+            MemWrite( &item->histogramDataFat.payload, (uint64_t)ptr );
+            TracyLfqCommit;
+        }
+        m_numCounters = 0;
+        m_numHistograms = 0;
+    }
+
+    int m_numCounters;
+    int m_numHistograms;
+    int64_t m_windowEnd;
+    int64_t m_period;
+    Counter m_counters[MaxCounters];
+    Histogram m_histograms[MaxHistograms];
+};
+
+static MetricsTable& GetMetricsTable()
+{
+    thread_local MetricsTable table;
+    return table;
+}
+
+void Profiler::CounterAdd( const char* name, int64_t val )
+{
+#ifdef TRACY_ON_DEMAND
+    if( !GetProfiler().IsConnected() ) return;
+#endif
+    GetMetricsTable().AddCounter( name, val );
+}
+
+void Profiler::HistogramRecord( const char* name, int64_t val )
+{
+#ifdef TRACY_ON_DEMAND
+    if( !GetProfiler().IsConnected() ) return;
+#endif
+    GetMetricsTable().AddHistogram( name, val );
+}
+
 void Profiler::QueueCallstackFrame( uint64_t ptr )
 {
 #ifdef TRACY_HAS_CALLSTACK
@@ -4300,6 +4700,28 @@ void Profiler::QueueSourceCodeQuery( uint32_t id )
 }
 
 #ifdef TRACY_NEEDS_SYMBOL_WORKER
+#ifdef TRACY_HAS_CALLSTACK
+static void CommitCallstackFrame( uint64_t ptr, void* data, uint8_t size, const char* imageName )
+{
+    TracyLfqPrepare( QueueType::CallstackFrameSize );
+    MemWrite( &item->callstackFrameSizeFat.ptr, ptr );
+    MemWrite( &item->callstackFrameSizeFat.size, size );
+    MemWrite( &item->callstackFrameSizeFat.data, (uint64_t)data );
+    MemWrite( &item->callstackFrameSizeFat.imageName, (uint64_t)imageName );
+    TracyLfqCommit;
+}
+
+static void CommitSymbolInformation( uint64_t ptr, const CallstackSymbolData& sym )
+{
+    TracyLfqPrepare( QueueType::SymbolInformation );
+    MemWrite( &item->symbolInformationFat.line, sym.line );
+    MemWrite( &item->symbolInformationFat.symAddr, ptr );
+    MemWrite( &item->symbolInformationFat.fileString, (uint64_t)sym.file );
+    MemWrite( &item->symbolInformationFat.needFree, (uint8_t)sym.needFree );
+    TracyLfqCommit;
+}
+#endif
+
 void Profiler::HandleSymbolQueueItem( const SymbolQueueItem& si )
 {
     switch( si.type )
@@ -4310,12 +4732,7 @@ void Profiler::HandleSymbolQueueItem( const SymbolQueueItem& si )
         const auto frameData = DecodeCallstackPtr( si.ptr );
         auto data = tracy_malloc_fast( sizeof( CallstackEntry ) * frameData.size );
         memcpy( data, frameData.data, sizeof( CallstackEntry ) * frameData.size );
-        TracyLfqPrepare( QueueType::CallstackFrameSize );
-        MemWrite( &item->callstackFrameSizeFat.ptr, si.ptr );
-        MemWrite( &item->callstackFrameSizeFat.size, frameData.size );
-        MemWrite( &item->callstackFrameSizeFat.data, (uint64_t)data );
-        MemWrite( &item->callstackFrameSizeFat.imageName, (uint64_t)frameData.imageName );
-        TracyLfqCommit;
+        CommitCallstackFrame( si.ptr, data, frameData.size, frameData.imageName );
         break;
     }
     case SymbolQueueItemType::SymbolQuery:
@@ -4330,13 +4747,7 @@ void Profiler::HandleSymbolQueueItem( const SymbolQueueItem& si )
             break;
         }
 #endif
-        const auto sym = DecodeSymbolAddress( si.ptr );
-        TracyLfqPrepare( QueueType::SymbolInformation );
-        MemWrite( &item->symbolInformationFat.line, sym.line );
-        MemWrite( &item->symbolInformationFat.symAddr, si.ptr );
-        MemWrite( &item->symbolInformationFat.fileString, (uint64_t)sym.file );
-        MemWrite( &item->symbolInformationFat.needFree, (uint8_t)sym.needFree );
-        TracyLfqCommit;
+        CommitSymbolInformation( si.ptr, DecodeSymbolAddress( si.ptr ) );
         break;
     }
 #endif
@@ -4413,6 +4824,80 @@ void Profiler::HandleSymbolQueueItem( const SymbolQueueItem& si )
     }
 }
 
+#ifdef TRACY_HAS_SYMBOL_THREADS
+bool Profiler::IsBatchedSymbolQuery( SymbolQueueItemType type )
+{
+#ifdef __ANDROID__
+    // Symbol queries may need to make the code readable first, which is not thread safe.
+    return type == SymbolQueueItemType::CallstackFrame;
+#else
+    return type == SymbolQueueItemType::CallstackFrame || type == SymbolQueueItemType::SymbolQuery;
+#endif
+}
+
+void Profiler::ResolveSymbolBatchItem( size_t idx, void* ptr )
+{
+    auto& v = ((SymbolBatchItem*)ptr)[idx];
+    if( v.si.type == SymbolQueueItemType::CallstackFrame )
+    {
+        CallstackEntry frames[CallstackMaxFrames];
+        const auto frameData = DecodeCallstackPtr( v.si.ptr, frames );
+        v.data = tracy_malloc_fast( sizeof( CallstackEntry ) * frameData.size );
+        memcpy( v.data, frameData.data, sizeof( CallstackEntry ) * frameData.size );
+        v.size = frameData.size;
+        v.imageName = frameData.imageName;
+    }
+    else
+    {
+        v.sym = DecodeSymbolAddress( v.si.ptr );
+    }
+}
+
+void Profiler::HandleSymbolQueueBatch()
+{
+    SymbolBatchItem batch[SymbolBatchSize];
+    size_t num = 0;
+    while( num < SymbolBatchSize )
+    {
+        auto si = m_symbolQueue.front();
+        if( !si || !IsBatchedSymbolQuery( si->type ) ) break;
+        // Make sure we don't send data to the server that was requested by a previous conneciton!
+        if( si->connectionId == ConnectionId() ) batch[num++].si = *si;
+        m_symbolQueue.pop();
+    }
+    if( num == 0 ) return;
+
+    s_symbolPool->Run( num, ResolveSymbolBatchItem, batch );
+
+    // Responses are sent in request order, from this thread only.
+    for( size_t i=0; i<num; i++ )
+    {
+        auto& v = batch[i];
+        if( v.si.type == SymbolQueueItemType::CallstackFrame )
+        {
+            CommitCallstackFrame( v.si.ptr, v.data, v.size, v.imageName );
+        }
+        else
+        {
+            CommitSymbolInformation( v.si.ptr, v.sym );
+        }
+    }
+}
+#endif
+
+static void EndSymbolThreads()
+{
+#ifdef TRACY_HAS_SYMBOL_THREADS
+    if( s_symbolPool )
+    {
+        s_symbolPool->~SymbolThreadPool();
+        tracy_free( s_symbolPool );
+        s_symbolPool = nullptr;
+    }
+#endif
+    s_symbolThreadGone.store( true, std::memory_order_release );
+}
+
 void Profiler::SymbolWorker()
 {
 #if defined __linux__ && !defined TRACY_NO_CRASH_HANDLER
@@ -4428,6 +4913,13 @@ void Profiler::SymbolWorker()
 #ifdef TRACY_HAS_CALLSTACK
     InitCallstack();
 #endif
+#ifdef TRACY_HAS_SYMBOL_THREADS
+    if( GetSymbolThreadCount() > 1 )
+    {
+        s_symbolPool = (SymbolThreadPool*)tracy_malloc( sizeof( SymbolThreadPool ) );
+        new(s_symbolPool) SymbolThreadPool( GetSymbolThreadCount() - 1 );
+    }
+#endif
 
     while( m_timeBegin.load( std::memory_order_relaxed ) == 0 ) std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
 
@@ -4439,7 +4931,7 @@ void Profiler::SymbolWorker()
         {
             if( shouldExit )
             {
-                s_symbolThreadGone.store( true, std::memory_order_release );
+                EndSymbolThreads();
                 return;
             }
             while( m_symbolQueue.front() ) m_symbolQueue.pop();
@@ -4448,6 +4940,13 @@ void Profiler::SymbolWorker()
         }
 #endif
         auto si = m_symbolQueue.front();
+#ifdef TRACY_HAS_SYMBOL_THREADS
+        if( si && s_symbolPool && IsBatchedSymbolQuery( si->type ) )
+        {
+            HandleSymbolQueueBatch();
+            continue;
+        }
+#endif
         if( si )
         {
             // Make sure we don't send data to the server that was requested by a previous conneciton!
@@ -4461,7 +4960,7 @@ void Profiler::SymbolWorker()
         {
             if( shouldExit )
             {
-                s_symbolThreadGone.store( true, std::memory_order_release );
+                EndSymbolThreads();
                 return;
             }
             std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
@@ -4477,9 +4976,26 @@ bool Profiler::HandleServerQuery()
 
     uint8_t type;
     uint64_t ptr;
+    uint32_t extra;
     memcpy( &type, &payload.type, sizeof( payload.type ) );
     memcpy( &ptr, &payload.ptr, sizeof( payload.ptr ) );
+    memcpy( &extra, &payload.extra, sizeof( payload.extra ) );
+
+    if( type != ServerQueryBatch ) return HandleServerQuery( type, ptr, extra );
+
+    if( extra > ServerQueryBatchMaxItems ) return false;
+    uint64_t ids[ServerQueryBatchMaxItems];
+    if( !m_sock->Read( ids, extra * sizeof( uint64_t ), 10 ) ) return false;
+    for( uint32_t i=0; i<extra; i++ )
+    {
+        if( !HandleServerQuery( uint8_t( ptr ), ids[i], 0 ) ) return false;
+    }
+    AckServerQueryBatch( uint32_t( ptr >> 8 ) );
+    return true;
+}
 
+bool Profiler::HandleServerQuery( uint8_t type, uint64_t ptr, uint32_t extra )
+{
     switch( type )
     {
     case ServerQueryString:
@@ -4540,7 +5056,7 @@ bool Profiler::HandleServerQuery()
         break;
 #ifndef TRACY_NO_CODE_TRANSFER
     case ServerQuerySymbolCode:
-        HandleSymbolCodeQuery( ptr, payload.extra );
+        HandleSymbolCodeQuery( ptr, extra );
         break;
 #endif
     case ServerQuerySourceCode:
@@ -4560,7 +5076,7 @@ bool Profiler::HandleServerQuery()
     case ServerQueryDataTransferPart:
 #if defined(TRACY_NEEDS_SYMBOL_WORKER)
         memcpy( m_queryDataPtr, &ptr, 8 );
-        memcpy( m_queryDataPtr+8, &payload.extra, 4 );
+        memcpy( m_queryDataPtr+8, &extra, 4 );
         m_queryDataPtr += 12;
 #endif
         AckServerQuery();
@@ -5035,6 +5551,18 @@ void Profiler::ProcessSysTime()
 }
 #endif
 
+#ifdef TRACY_LOCK_AGGREGATE
+void Profiler::ProcessLockAggregates()
+{
+    auto t = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    if( t - m_lockAggregateLast < TRACY_LOCK_AGGREGATE_FLUSH * 1000000ll ) return;
+    m_lockAggregateLast = t;
+
+    std::lock_guard<TracyMutex> lock( GetLockAggregateTablesLock() );
+    for( auto table = s_lockAggregateTables; table; table = table->m_next ) table->FlushAll();
+}
+#endif
+
 void Profiler::HandleParameter( uint64_t payload )
 {
     assert( m_paramCallback );
@@ -203,6 +203,19 @@ class Profiler
         uint32_t id;
     };
 
+#ifdef TRACY_HAS_SYMBOL_THREADS
+    enum { SymbolBatchSize = 256 };
+
+    struct SymbolBatchItem
+    {
+        SymbolQueueItem si;
+        void* data;
+        uint8_t size;
+        const char* imageName;
+        CallstackSymbolData sym;
+    };
+#endif
+
 public:
     Profiler();
     ~Profiler();
@@ -272,6 +285,7 @@ public:
     }
 
     tracy_force_inline int64_t TscTime( int64_t tsc ) { return int64_t( ( tsc - m_initTime ) * m_timerMul ); }
+    tracy_force_inline double GetTimerMul() const { return m_timerMul; }
 
     tracy_force_inline uint32_t GetNextZoneId()
     {
@@ -398,6 +412,11 @@ public:
         TracyLfqCommit;
     }
 
+    // Counters and histograms are accumulated per thread and sent once per
+    // TRACY_METRICS_FLUSH ms window.
+    static void CounterAdd( const char* name, int64_t val );
+    static void HistogramRecord( const char* name, int64_t val );
+
     static tracy_force_inline void ConfigurePlot( const char* name, PlotFormatType type, bool step, bool fill, uint32_t color )
     {
         TracyLfqPrepare( QueueType::PlotConfig );
@@ -842,6 +861,11 @@ private:
     static void LaunchSymbolWorker( void* ptr ) { ((Profiler*)ptr)->SymbolWorker(); }
     void SymbolWorker();
     void HandleSymbolQueueItem( const SymbolQueueItem& si );
+#  ifdef TRACY_HAS_SYMBOL_THREADS
+    static bool IsBatchedSymbolQuery( SymbolQueueItemType type );
+    static void ResolveSymbolBatchItem( size_t idx, void* ptr );
+    void HandleSymbolQueueBatch();
+#  endif
 #endif
 
     void InstallCrashHandler();
@@ -886,6 +910,7 @@ private:
     void SendCallstackPayload( uint64_t ptr );
     void SendCallstackPayload64( uint64_t ptr );
     void SendCallstackAlloc( uint64_t ptr );
+    void SendHistogramPayload( uint64_t ptr );
 
     void QueueCallstackFrame( uint64_t ptr );
     void QueueSymbolQuery( uint64_t symbol );
@@ -894,12 +919,14 @@ private:
     void QueueSourceCodeQuery( uint32_t id );
 
     bool HandleServerQuery();
+    bool HandleServerQuery( uint8_t type, uint64_t ptr, uint32_t extra );
     void HandleDisconnect();
     void HandleParameter( uint64_t payload );
     void HandleSymbolCodeQuery( uint64_t symbol, uint32_t size );
     void HandleSourceCodeQuery( char* data, char* image, uint32_t id );
 
     void AckServerQuery();
+    void AckServerQueryBatch( uint32_t seq );
     void AckSymbolCodeNotAvailable();
 
     void CalibrateTimer();
@@ -1036,6 +1063,14 @@ private:
     void ProcessSysTime() {}
 #endif
 
+#ifdef TRACY_LOCK_AGGREGATE
+    void ProcessLockAggregates();
+
+    int64_t m_lockAggregateLast = 0;
+#else
+    void ProcessLockAggregates() {}
+#endif
+
 #ifdef TRACY_HAS_SYSPOWER
     SysPower m_sysPower;
 #endif
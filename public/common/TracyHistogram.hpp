@@ -0,0 +1,61 @@
+#ifndef __TRACYHISTOGRAM_HPP__
+#define __TRACYHISTOGRAM_HPP__
+
+#include <stdint.h>
+
+#ifdef _MSC_VER
+#  include <intrin.h>
+#endif
+
+#include "TracyForceInline.hpp"
+
+namespace tracy
+{
+
+// Log-linear histogram buckets. Values below 2^HistogramSubBits have their own
+// bucket, each power of two above is split into 2^HistogramSubBits buckets,
+// which bounds the relative error of a bucket to 1/2^HistogramSubBits. The
+// server uses finer subdivisions for its own duration sketches.
+enum { HistogramSubBits = 3 };
+enum { HistogramBuckets = ( 64 - HistogramSubBits + 1 ) << HistogramSubBits };
+
+template<int SubBits = HistogramSubBits>
+tracy_force_inline int HistogramBucket( uint64_t val )
+{
+    if( val < ( 1 << SubBits ) ) return int( val );
+#if defined _MSC_VER && defined _WIN64
+    unsigned long bit;
+    _BitScanReverse64( &bit, val );
+    const int exp = int( bit );
+#elif defined _MSC_VER
+    unsigned long bit;
+    if( val >> 32 )
+    {
+        _BitScanReverse( &bit, uint32_t( val >> 32 ) );
+        bit += 32;
+    }
+    else
+    {
+        _BitScanReverse( &bit, uint32_t( val ) );
+    }
+    const int exp = int( bit );
+#else
+    const int exp = 63 - __builtin_clzll( val );
+#endif
+    const auto sub = int( val >> ( exp - SubBits ) ) & ( ( 1 << SubBits ) - 1 );
+    return ( ( exp - SubBits + 1 ) << SubBits ) | sub;
+}
+
+// Smallest value that falls into the bucket.
+template<int SubBits = HistogramSubBits>
+tracy_force_inline uint64_t HistogramBucketValue( int bucket )
+{
+    if( bucket < ( 1 << SubBits ) ) return uint64_t( bucket );
+    const auto exp = ( bucket >> SubBits ) + SubBits - 1;
+    const auto sub = uint64_t( bucket & ( ( 1 << SubBits ) - 1 ) );
+    return ( ( 1ull << SubBits ) | sub ) << ( exp - SubBits );
+}
+
+}
+
+#endif
@@ -9,7 +9,7 @@ namespace tracy
 
 constexpr unsigned Lz4CompressBound( unsigned isize ) { return isize + ( isize / 255 ) + 16; }
 
-enum : uint32_t { ProtocolVersion = 68 };
+enum : uint32_t { ProtocolVersion = 71 };
 enum : uint16_t { BroadcastVersion = 3 };
 
 using lz4sz_t = uint32_t;
@@ -55,7 +55,8 @@ enum ServerQuery : uint8_t
     ServerQuerySymbolCode,
     ServerQuerySourceCode,
     ServerQueryDataTransfer,
-    ServerQueryDataTransferPart
+    ServerQueryDataTransferPart,
+    ServerQueryBatch
 };
 
 struct ServerQueryPacket
@@ -67,6 +68,15 @@ struct ServerQueryPacket
 
 enum { ServerQueryPacketSize = sizeof( ServerQueryPacket ) };
 
+// ServerQueryBatch packet is followed by extra query ids, all of the query type stored in
+// the low byte of ptr. The rest of ptr is the batch sequence number, acknowledged by the
+// client with AckServerQueryBatch after all queries were handled.
+enum { ServerQueryBatchMaxItems = 512 };
+
+// Capacity of the client queue holding callstack frame, symbol and other queries for the symbol
+// worker. The server never has more of these queries in flight.
+enum { SymbolQueueSize = 8 * 1024 };
+
 
 enum CpuArchitecture : uint8_t
 {
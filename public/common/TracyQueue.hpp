@@ -57,6 +57,8 @@ enum class QueueType : uint8_t
     PlotDataInt,
     PlotDataFloat,
     PlotDataDouble,
+    CounterData,
+    HistogramData,
     ContextSwitch,
     ThreadWakeup,
     GpuTime,
@@ -89,6 +91,9 @@ enum class QueueType : uint8_t
     LockTerminate,
     LockMark,
     LockMarkFileLine,
+    LockAggregateWait,
+    LockAggregateHold,
+    LockAggregateHistogram,
     MessageLiteral,
     MessageLiteralColor,
     MessageLiteralCallstack,
@@ -109,6 +114,7 @@ enum class QueueType : uint8_t
     AckServerQueryNoop,
     AckSourceCodeNotAvailable,
     AckSymbolCodeNotAvailable,
+    AckServerQueryBatch,
     CpuTopology,
     SingleStringData,
     SecondStringData,
@@ -120,6 +126,7 @@ enum class QueueType : uint8_t
     SourceLocationPayload,
     CallstackPayload,
     CallstackAllocPayload,
+    HistogramPayload,
     FrameName,
     FrameImageData,
     ExternalName,
@@ -339,6 +346,22 @@ struct QueueLockMarkFileLine
     int32_t line;
 };
 
+struct QueueLockAggregate
+{
+    uint32_t id;
+    uint32_t count;
+    int64_t total;
+    int64_t max;
+};
+
+struct QueueLockAggregateHistogram
+{
+    uint32_t id;
+    uint8_t hold;
+    uint8_t bucket;
+    uint32_t count;
+};
+
 struct QueueLockName
 {
     uint32_t id;
@@ -371,6 +394,24 @@ struct QueuePlotDataDouble : public QueuePlotDataBase
     double val;
 };
 
+struct QueueCounterData
+{
+    uint64_t name;  // ptr
+    int64_t time;
+    int64_t val;
+};
+
+struct QueueHistogramData
+{
+    uint64_t name;  // ptr
+    int64_t time;
+};
+
+struct QueueHistogramDataFat : public QueueHistogramData
+{
+    uint64_t payload;   // ptr
+};
+
 struct QueueMessage
 {
     int64_t time;
@@ -678,6 +719,11 @@ struct QueueSourceCodeNotAvailable
     uint32_t id;
 };
 
+struct QueueServerQueryBatchAck
+{
+    uint32_t seq;
+};
+
 enum class CpuType : uint32_t
 {
     Normal = 0,
@@ -762,11 +808,16 @@ struct QueueItem
         QueueLockReleaseShared lockReleaseShared;
         QueueLockMark lockMark;
         QueueLockMarkFileLine lockMarkFileLine;
+        QueueLockAggregate lockAggregate;
+        QueueLockAggregateHistogram lockAggregateHistogram;
         QueueLockName lockName;
         QueueLockNameFat lockNameFat;
         QueuePlotDataInt plotDataInt;
         QueuePlotDataFloat plotDataFloat;
         QueuePlotDataDouble plotDataDouble;
+        QueueCounterData counterData;
+        QueueHistogramData histogramData;
+        QueueHistogramDataFat histogramDataFat;
         QueueMessage message;
         QueueMessageColor messageColor;
         QueueMessageLiteral messageLiteral;
@@ -816,6 +867,7 @@ struct QueueItem
         QueueSymbolCodeMetadata symbolCodeMetadata;
         QueueSourceCodeMetadata sourceCodeMetadata;
         QueueSourceCodeNotAvailable sourceCodeNotAvailable;
+        QueueServerQueryBatchAck serverQueryBatchAck;
         QueueFiberEnter fiberEnter;
         QueueFiberLeave fiberLeave;
     };
@@ -873,6 +925,8 @@ static constexpr size_t QueueDataSize[] = {
     sizeof( QueueHeader ) + sizeof( QueuePlotDataInt ),
     sizeof( QueueHeader ) + sizeof( QueuePlotDataFloat ),
     sizeof( QueueHeader ) + sizeof( QueuePlotDataDouble ),
+    sizeof( QueueHeader ) + sizeof( QueueCounterData ),
+    sizeof( QueueHeader ) + sizeof( QueueHistogramData ),
     sizeof( QueueHeader ) + sizeof( QueueContextSwitch ),
     sizeof( QueueHeader ) + sizeof( QueueThreadWakeup ),
     sizeof( QueueHeader ) + sizeof( QueueGpuTime ),
@@ -906,6 +960,9 @@ static constexpr size_t QueueDataSize[] = {
     sizeof( QueueHeader ) + sizeof( QueueLockTerminate ),
     sizeof( QueueHeader ) + sizeof( QueueLockMark ),
     sizeof( QueueHeader ) + sizeof( QueueLockMarkFileLine ),
+    sizeof( QueueHeader ) + sizeof( QueueLockAggregate ),   // wait
+    sizeof( QueueHeader ) + sizeof( QueueLockAggregate ),   // hold
+    sizeof( QueueHeader ) + sizeof( QueueLockAggregateHistogram ),
     sizeof( QueueHeader ) + sizeof( QueueMessageLiteral ),
     sizeof( QueueHeader ) + sizeof( QueueMessageColorLiteral ),
     sizeof( QueueHeader ) + sizeof( QueueMessageLiteral ),  // callstack
@@ -926,6 +983,7 @@ static constexpr size_t QueueDataSize[] = {
     sizeof( QueueHeader ),                                  // server query acknowledgement
     sizeof( QueueHeader ) + sizeof( QueueSourceCodeNotAvailable ),
     sizeof( QueueHeader ),                                  // symbol code not available
+    sizeof( QueueHeader ) + sizeof( QueueServerQueryBatchAck ),
     sizeof( QueueHeader ) + sizeof( QueueCpuTopology ),
     sizeof( QueueHeader ),                                  // single string data
     sizeof( QueueHeader ),                                  // second string data
@@ -938,6 +996,7 @@ static constexpr size_t QueueDataSize[] = {
     sizeof( QueueHeader ) + sizeof( QueueStringTransfer ),  // allocated source location payload
     sizeof( QueueHeader ) + sizeof( QueueStringTransfer ),  // callstack payload
     sizeof( QueueHeader ) + sizeof( QueueStringTransfer ),  // callstack alloc payload
+    sizeof( QueueHeader ) + sizeof( QueueStringTransfer ),  // histogram payload
     sizeof( QueueHeader ) + sizeof( QueueStringTransfer ),  // frame name
     sizeof( QueueHeader ) + sizeof( QueueStringTransfer ),  // frame image data
     sizeof( QueueHeader ) + sizeof( QueueStringTransfer ),  // external name
@@ -0,0 +1,367 @@
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#  include <process.h>
+#else
+#  include <unistd.h>
+#endif
+
+#include "TracyAlloc.hpp"
+#include "TracySymbolCache.hpp"
+
+namespace tracy
+{
+
+static constexpr char SymbolCacheMagic[4] = { 'T', 'r', 'S', 'C' };
+enum { SymbolCacheVersion = 2 };
+enum { SymbolCacheHeaderSize = sizeof( SymbolCacheMagic ) + sizeof( uint32_t ) };
+enum { SymbolCacheRecordHeader = sizeof( uint32_t ) * 2 };
+enum { SymbolCacheRecordPrefix = sizeof( uint64_t ) + 2 };
+enum { SymbolCacheFlushSize = 64 * 1024 };
+enum { SymbolCacheFrameHeader = sizeof( uint32_t ) * 2 + sizeof( uint64_t ) + sizeof( uint16_t ) * 2 };
+
+template<typename T>
+static inline T ReadValue( const char* ptr )
+{
+    T val;
+    memcpy( &val, ptr, sizeof( T ) );
+    return val;
+}
+
+template<typename T>
+static inline char* WriteValue( char* ptr, T val )
+{
+    memcpy( ptr, &val, sizeof( T ) );
+    return ptr + sizeof( T );
+}
+
+static uint32_t Checksum( const char* data, size_t size )
+{
+    uint32_t hash = 2166136261u;
+    for( size_t i=0; i<size; i++ )
+    {
+        hash ^= (uint8_t)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool GetElfBuildIdFromNotes( const void* notes, size_t notesSize, uint8_t* buildId, size_t& size )
+{
+    auto ptr = (const char*)notes;
+    auto end = ptr + notesSize;
+    while( end - ptr >= 12 )
+    {
+        const auto namesz = ReadValue<uint32_t>( ptr );
+        const auto descsz = ReadValue<uint32_t>( ptr + 4 );
+        const auto type = ReadValue<uint32_t>( ptr + 8 );
+        const auto name = ptr + 12;
+        const auto desc = name + ( ( namesz + 3 ) & ~3u );
+        if( desc > end || desc + descsz > end ) return false;
+        if( type == 3 && namesz == 4 && memcmp( name, "GNU", 4 ) == 0 && descsz > 0 && descsz <= SymbolCacheMaxBuildId )
+        {
+            memcpy( buildId, desc, descsz );
+            size = descsz;
+            return true;
+        }
+        ptr = desc + ( ( descsz + 3 ) & ~3u );
+    }
+    return false;
+}
+
+bool GetElfBuildId( const char* path, uint8_t* buildId, size_t& size )
+{
+    FILE* f = fopen( path, "rb" );
+    if( !f ) return false;
+
+    bool found = false;
+    char ehdr[64];
+    const uint16_t endian = 1;
+    if( fread( ehdr, 1, sizeof( ehdr ), f ) == sizeof( ehdr ) && memcmp( ehdr, "\177ELF", 4 ) == 0 &&
+        ( ehdr[5] == 1 ) == ( *(const uint8_t*)&endian == 1 ) )
+    {
+        const bool is64 = ehdr[4] == 2;
+        const uint64_t phoff = is64 ? ReadValue<uint64_t>( ehdr + 0x20 ) : ReadValue<uint32_t>( ehdr + 0x1C );
+        const auto phentsize = ReadValue<uint16_t>( ehdr + ( is64 ? 0x36 : 0x2A ) );
+        const auto phnum = ReadValue<uint16_t>( ehdr + ( is64 ? 0x38 : 0x2C ) );
+        char phdr[56];
+        for( uint16_t i=0; i<phnum && !found; i++ )
+        {
+            if( phentsize > sizeof( phdr ) ) break;
+            if( fseek( f, long( phoff + uint64_t( i ) * phentsize ), SEEK_SET ) != 0 ) break;
+            if( fread( phdr, 1, phentsize, f ) != phentsize ) break;
+            if( ReadValue<uint32_t>( phdr ) != 4 ) continue;    // PT_NOTE
+            const uint64_t offset = is64 ? ReadValue<uint64_t>( phdr + 8 ) : ReadValue<uint32_t>( phdr + 4 );
+            const uint64_t filesz = is64 ? ReadValue<uint64_t>( phdr + 0x20 ) : ReadValue<uint32_t>( phdr + 0x10 );
+            if( filesz > 64 * 1024 ) continue;
+            auto notes = (char*)tracy_malloc( filesz );
+            if( fseek( f, long( offset ), SEEK_SET ) == 0 && fread( notes, 1, filesz, f ) == filesz )
+            {
+                found = GetElfBuildIdFromNotes( notes, filesz, buildId, size );
+            }
+            tracy_free( notes );
+        }
+    }
+
+    fclose( f );
+    return found;
+}
+
+SymbolCache* SymbolCache::Open( const char* dir, const uint8_t* buildId, size_t buildIdSize )
+{
+    if( !dir || !*dir || buildIdSize == 0 || buildIdSize > SymbolCacheMaxBuildId ) return nullptr;
+
+    auto cache = (SymbolCache*)tracy_malloc( sizeof( SymbolCache ) );
+    new(cache) SymbolCache();
+
+    const auto dirLen = strlen( dir );
+    cache->m_path = (char*)tracy_malloc( dirLen + 1 + buildIdSize * 2 + 6 + 1 );
+    memcpy( cache->m_path, dir, dirLen );
+    auto ptr = cache->m_path + dirLen;
+    *ptr++ = '/';
+    for( size_t i=0; i<buildIdSize; i++ )
+    {
+        ptr += sprintf( ptr, "%02x", buildId[i] );
+    }
+    memcpy( ptr, ".tsym", 6 );
+
+    if( !cache->Load() )
+    {
+        Close( cache );
+        return nullptr;
+    }
+    return cache;
+}
+
+void SymbolCache::Close( SymbolCache* cache )
+{
+    if( !cache ) return;
+    cache->Flush();
+    cache->~SymbolCache();
+    tracy_free( cache );
+}
+
+SymbolCache::~SymbolCache()
+{
+    tracy_free( m_path );
+    tracy_free( m_data );
+    tracy_free( m_keys );
+    tracy_free( m_pos );
+}
+
+bool SymbolCache::Load()
+{
+    m_mask = 255;
+    m_keys = (uint64_t*)tracy_malloc( sizeof( uint64_t ) * ( m_mask + 1 ) );
+    m_pos = (uint32_t*)tracy_malloc( sizeof( uint32_t ) * ( m_mask + 1 ) );
+    memset( m_pos, 0, sizeof( uint32_t ) * ( m_mask + 1 ) );
+
+    size_t fileSize = 0;
+    FILE* f = fopen( m_path, "rb" );
+    if( f )
+    {
+        fseek( f, 0, SEEK_END );
+        const auto sz = ftell( f );
+        fseek( f, 0, SEEK_SET );
+        if( sz > 0 && size_t( sz ) < 0xFFFFFFFF ) fileSize = size_t( sz );
+    }
+
+    m_capacity = fileSize > SymbolCacheHeaderSize ? fileSize : 4096;
+    m_data = (char*)tracy_malloc( m_capacity );
+    if( f )
+    {
+        if( fread( m_data, 1, fileSize, f ) != fileSize ) fileSize = 0;
+        fclose( f );
+    }
+
+    if( fileSize < SymbolCacheHeaderSize || memcmp( m_data, SymbolCacheMagic, sizeof( SymbolCacheMagic ) ) != 0 ||
+        ReadValue<uint32_t>( m_data + sizeof( SymbolCacheMagic ) ) != SymbolCacheVersion )
+    {
+        auto ptr = m_data;
+        memcpy( ptr, SymbolCacheMagic, sizeof( SymbolCacheMagic ) );
+        WriteValue<uint32_t>( ptr + sizeof( SymbolCacheMagic ), SymbolCacheVersion );
+        m_size = SymbolCacheHeaderSize;
+        m_flushed = m_size;
+        m_rewrite = true;
+        return true;
+    }
+
+    size_t pos = SymbolCacheHeaderSize;
+    while( fileSize - pos >= SymbolCacheRecordHeader )
+    {
+        const auto size = ReadValue<uint32_t>( m_data + pos );
+        const auto payload = m_data + pos + SymbolCacheRecordHeader;
+        if( size < SymbolCacheRecordPrefix || fileSize - pos - SymbolCacheRecordHeader < size ) break;
+        if( ReadValue<uint32_t>( m_data + pos + sizeof( uint32_t ) ) != Checksum( payload, size ) ) break;
+        Insert( ReadValue<uint64_t>( payload ), uint32_t( pos ) );
+        pos += SymbolCacheRecordHeader + size;
+    }
+    m_size = pos;
+    m_flushed = pos;
+    m_rewrite = pos != fileSize;
+    return true;
+}
+
+void SymbolCache::Insert( uint64_t offset, uint32_t pos )
+{
+    if( ( m_count + 1 ) * 2 > m_mask + 1 )
+    {
+        auto keys = m_keys;
+        auto positions = m_pos;
+        const auto oldSize = m_mask + 1;
+        m_mask = oldSize * 2 - 1;
+        m_keys = (uint64_t*)tracy_malloc( sizeof( uint64_t ) * ( m_mask + 1 ) );
+        m_pos = (uint32_t*)tracy_malloc( sizeof( uint32_t ) * ( m_mask + 1 ) );
+        memset( m_pos, 0, sizeof( uint32_t ) * ( m_mask + 1 ) );
+        m_count = 0;
+        for( size_t i=0; i<oldSize; i++ )
+        {
+            if( positions[i] != 0 ) Insert( keys[i], positions[i] );
+        }
+        tracy_free( keys );
+        tracy_free( positions );
+    }
+
+    auto idx = size_t( ( offset * 0x9E3779B97F4A7C15ull ) >> 32 ) & m_mask;
+    while( m_pos[idx] != 0 )
+    {
+        if( m_keys[idx] == offset )
+        {
+            m_pos[idx] = pos;
+            return;
+        }
+        idx = ( idx + 1 ) & m_mask;
+    }
+    m_keys[idx] = offset;
+    m_pos[idx] = pos;
+    m_count++;
+}
+
+uint32_t SymbolCache::Lookup( uint64_t offset ) const
+{
+    auto idx = size_t( ( offset * 0x9E3779B97F4A7C15ull ) >> 32 ) & m_mask;
+    while( m_pos[idx] != 0 )
+    {
+        if( m_keys[idx] == offset ) return m_pos[idx];
+        idx = ( idx + 1 ) & m_mask;
+    }
+    return 0;
+}
+
+int SymbolCache::Find( uint64_t offset, SymbolCacheFrame* frames, int maxFrames, uint8_t& flags ) const
+{
+    const auto pos = Lookup( offset );
+    if( pos == 0 ) return 0;
+
+    const auto size = ReadValue<uint32_t>( m_data + pos );
+    auto ptr = m_data + pos + SymbolCacheRecordHeader;
+    const auto end = ptr + size;
+    ptr += sizeof( uint64_t );
+    const int num = std::min<int>( (uint8_t)*ptr++, maxFrames );
+    flags = (uint8_t)*ptr++;
+    for( int i=0; i<num; i++ )
+    {
+        if( end - ptr < SymbolCacheFrameHeader ) return i;
+        auto& frame = frames[i];
+        frame.line = ReadValue<uint32_t>( ptr );
+        frame.symLen = ReadValue<uint32_t>( ptr + 4 );
+        frame.symOffset = ReadValue<uint64_t>( ptr + 8 );
+        frame.nameLen = ReadValue<uint16_t>( ptr + 16 );
+        frame.fileLen = ReadValue<uint16_t>( ptr + 18 );
+        ptr += SymbolCacheFrameHeader;
+        if( end - ptr < frame.nameLen + frame.fileLen ) return i;
+        frame.name = ptr;
+        frame.file = ptr + frame.nameLen;
+        ptr += frame.nameLen + frame.fileLen;
+    }
+    return num;
+}
+
+void SymbolCache::Add( uint64_t offset, const SymbolCacheFrame* frames, int num, uint8_t flags )
+{
+    if( num <= 0 ) return;
+    if( num > MaxFrames ) num = MaxFrames;
+
+    size_t size = SymbolCacheRecordPrefix;
+    for( int i=0; i<num; i++ ) size += SymbolCacheFrameHeader + frames[i].nameLen + frames[i].fileLen;
+    const auto recordSize = SymbolCacheRecordHeader + size;
+    if( m_size + recordSize >= 0xFFFFFFFF ) return;
+
+    if( m_size + recordSize > m_capacity )
+    {
+        m_capacity = std::max( m_capacity * 2, m_size + recordSize );
+        m_data = (char*)tracy_realloc( m_data, m_capacity );
+    }
+
+    const auto pos = m_size;
+    auto ptr = m_data + pos + SymbolCacheRecordHeader;
+    ptr = WriteValue<uint64_t>( ptr, offset );
+    *ptr++ = char( num );
+    *ptr++ = char( flags );
+    for( int i=0; i<num; i++ )
+    {
+        auto& frame = frames[i];
+        ptr = WriteValue<uint32_t>( ptr, frame.line );
+        ptr = WriteValue<uint32_t>( ptr, frame.symLen );
+        ptr = WriteValue<uint64_t>( ptr, frame.symOffset );
+        ptr = WriteValue<uint16_t>( ptr, frame.nameLen );
+        ptr = WriteValue<uint16_t>( ptr, frame.fileLen );
+        memcpy( ptr, frame.name, frame.nameLen );
+        ptr += frame.nameLen;
+        memcpy( ptr, frame.file, frame.fileLen );
+        ptr += frame.fileLen;
+    }
+    WriteValue<uint32_t>( m_data + pos, uint32_t( size ) );
+    WriteValue<uint32_t>( m_data + pos + sizeof( uint32_t ), Checksum( m_data + pos + SymbolCacheRecordHeader, size ) );
+    m_size += recordSize;
+    Insert( offset, uint32_t( pos ) );
+
+    if( m_size - m_flushed >= SymbolCacheFlushSize ) Flush();
+}
+
+void SymbolCache::Flush()
+{
+    if( m_flushed == m_size ) return;
+
+    if( !m_rewrite )
+    {
+        // Whole batches are appended with a single write, other processes may be extending the same file.
+        const auto pos = m_flushed;
+        m_flushed = m_size;
+        FILE* f = fopen( m_path, "ab" );
+        if( !f ) return;
+        setvbuf( f, nullptr, _IONBF, 0 );
+        fwrite( m_data + pos, 1, m_size - pos, f );
+        fclose( f );
+        return;
+    }
+
+    // Truncating the file in place would clobber it for other processes reading or appending to it,
+    // so the new contents are written to a temporary file which then replaces it.
+    const auto pathLen = strlen( m_path );
+    auto tmp = (char*)tracy_malloc( pathLen + 32 );
+#ifdef _WIN32
+    sprintf( tmp, "%s.%d.tmp", m_path, _getpid() );
+#else
+    sprintf( tmp, "%s.%d.tmp", m_path, (int)getpid() );
+#endif
+    m_flushed = m_size;
+    FILE* f = fopen( tmp, "wb" );
+    if( f )
+    {
+        const bool ok = fwrite( m_data, 1, m_size, f ) == m_size;
+        if( fclose( f ) == 0 && ok )
+        {
+#ifdef _WIN32
+            remove( m_path );
+#endif
+            if( rename( tmp, m_path ) == 0 ) m_rewrite = false;
+        }
+        if( m_rewrite ) remove( tmp );
+    }
+    tracy_free( tmp );
+}
+
+}
@@ -0,0 +1,81 @@
+#ifndef __TRACYSYMBOLCACHE_HPP__
+#define __TRACYSYMBOLCACHE_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace tracy
+{
+
+enum { SymbolCacheMaxBuildId = 64 };
+
+// Reads the GNU build id of an ELF file, or from the contents of its PT_NOTE segment.
+bool GetElfBuildId( const char* path, uint8_t* buildId, size_t& size );
+bool GetElfBuildIdFromNotes( const void* notes, size_t notesSize, uint8_t* buildId, size_t& size );
+
+// Resolved frames of an image address. The first frame is the innermost inlined
+// function. Offsets are relative to the image base, SymbolCacheNoOffset marks an
+// unknown symbol address.
+struct SymbolCacheFrame
+{
+    const char* name;
+    const char* file;
+    uint16_t nameLen;
+    uint16_t fileLen;
+    uint32_t line;
+    uint32_t symLen;
+    uint64_t symOffset;
+};
+
+static constexpr uint64_t SymbolCacheNoOffset = ~uint64_t( 0 );
+
+// Persistent cache of symbolized image offsets, stored in one append-only file
+// per build id, so that repeated runs don't have to parse the debug info again.
+// Added records are written in batches, at the latest on Close(). Records that
+// fail validation end the file, which is then rewritten through a temporary file.
+// Not thread safe.
+class SymbolCache
+{
+public:
+    enum { MaxFrames = 255 };
+
+    enum Flags : uint8_t
+    {
+        // Resolved offline, only the reported frame is known and the symbol address is missing.
+        Offline = 1 << 0
+    };
+
+    static SymbolCache* Open( const char* dir, const uint8_t* buildId, size_t buildIdSize );
+    static void Close( SymbolCache* cache );
+
+    // Returns the number of frames, or 0 if the offset is not cached. The strings
+    // are not null terminated and are only valid until the next Add().
+    int Find( uint64_t offset, SymbolCacheFrame* frames, int maxFrames, uint8_t& flags ) const;
+    void Add( uint64_t offset, const SymbolCacheFrame* frames, int num, uint8_t flags );
+    void Flush();
+
+private:
+    SymbolCache() = default;
+    ~SymbolCache();
+
+    bool Load();
+    void Insert( uint64_t offset, uint32_t pos );
+    uint32_t Lookup( uint64_t offset ) const;
+
+    char* m_path = nullptr;
+    char* m_data = nullptr;
+    size_t m_size = 0;
+    size_t m_capacity = 0;
+    size_t m_flushed = 0;
+    bool m_rewrite = false;
+
+    // Open addressing hash of offset to record position, position 0 marks an empty slot.
+    uint64_t* m_keys = nullptr;
+    uint32_t* m_pos = nullptr;
+    size_t m_count = 0;
+    size_t m_mask = 0;
+};
+
+}
+
+#endif
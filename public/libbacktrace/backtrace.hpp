@@ -87,6 +87,17 @@ extern struct backtrace_state *backtrace_create_state (
     const char *filename, int threaded,
     backtrace_error_callback error_callback, void *data);
 
+/* Create state information for an ELF file that is not loaded into
+   the current process, e.g. for resolving addresses offline.  PCs
+   passed to the backtrace functions are link-time addresses within
+   FILENAME.  The modules of the running process are not added, and no
+   other executable is tried if FILENAME cannot be opened.  THREADED
+   has the same meaning as for backtrace_create_state.  */
+
+extern struct backtrace_state *backtrace_create_state_offline (
+    const char *filename, int threaded,
+    backtrace_error_callback error_callback, void *data);
+
 /* The type of the callback argument to the backtrace_full function.
    DATA is the argument passed to backtrace_full.  PC is the program
    counter.  FILENAME is the name of the file containing PC, or NULL
@@ -181,6 +192,27 @@ extern int backtrace_syminfo (struct backtrace_state *state, uintptr_t addr,
 			      backtrace_error_callback error_callback,
 			      void *data);
 
+/* Read the symbol and debug info of the executable, which would
+   otherwise be done by the first lookup.  Returns 1 on success, 0 on
+   error.  */
+
+extern int backtrace_fileline_initialize (struct backtrace_state *state,
+					  backtrace_error_callback error_callback,
+					  void *data);
+
+/* Read the line number and function tables of every INDEX'th out of
+   COUNT compilation units, which would otherwise be done by the first
+   lookup in each of them.  This must be called after
+   backtrace_fileline_initialize.  Calls with different INDEX values
+   may run in parallel, so that the tables are read by COUNT threads,
+   but no other routines may be called on STATE in the meantime unless
+   it is threaded.  ERROR_CALLBACK may be called concurrently.  */
+
+extern void backtrace_prebuild (struct backtrace_state *state, int index,
+				int count,
+				backtrace_error_callback error_callback,
+				void *data);
+
 }
 
 #endif
@@ -33,6 +33,7 @@ POSSIBILITY OF SUCH DAMAGE.  */
 #include "config.h"
 
 #include <errno.h>
+#include <sched.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
@@ -665,14 +666,24 @@ struct unit
   const char *comp_dir;
   /* Absolute file name, only set if needed.  */
   const char *abs_filename;
-  /* The abbreviations for this unit.  */
-  struct abbrevs abbrevs;
+  /* Offset of the abbreviations for this unit in .debug_abbrev.  */
+  uint64_t abbrev_offset;
 
   /* The fields above this point are read in during initialization and
      may be accessed freely.  The fields below this point are read in
      as needed, and therefore require care, as different threads may
      try to initialize them simultaneously.  */
 
+  /* The abbreviations for this unit.  Unless the state is threaded,
+     these are only read when the unit is first looked up, the address
+     map is built from the single abbreviation of the unit DIE.  */
+  struct abbrevs abbrevs;
+  /* Non-zero once abbrevs has been read.  */
+  int abbrevs_read;
+  /* Held while reading the line information when threaded, so that
+     the fields below are only ever written once.  */
+  int lock;
+
   /* PC to line number mapping.  This is NULL if the values have not
      been read.  This is (struct line *) -1 if there was an error
      reading the values.  */
@@ -1679,6 +1690,68 @@ abbrev_compare (const void *v1, const void *v2)
     }
 }
 
+/* Read the attributes of an abbreviation from ABBREV_BUF into
+   ABBREV.  Returns 1 on success, 0 on failure.  */
+
+static int
+read_abbrev_attrs (struct backtrace_state *state, struct dwarf_buf *abbrev_buf,
+		   backtrace_error_callback error_callback, void *data,
+		   struct abbrev *abbrev)
+{
+  struct dwarf_buf count_buf;
+  size_t num_attrs;
+  struct attr *attrs;
+
+  count_buf = *abbrev_buf;
+  num_attrs = 0;
+  while (read_uleb128 (&count_buf) != 0)
+    {
+      uint64_t form;
+
+      ++num_attrs;
+      form = read_uleb128 (&count_buf);
+      if ((enum dwarf_form) form == DW_FORM_implicit_const)
+	read_sleb128 (&count_buf);
+    }
+
+  if (num_attrs == 0)
+    {
+      attrs = NULL;
+      read_uleb128 (abbrev_buf);
+      read_uleb128 (abbrev_buf);
+    }
+  else
+    {
+      attrs = ((struct attr *)
+	       backtrace_alloc (state, num_attrs * sizeof *attrs,
+				error_callback, data));
+      if (attrs == NULL)
+	return 0;
+      num_attrs = 0;
+      while (1)
+	{
+	  uint64_t name;
+	  uint64_t form;
+
+	  name = read_uleb128 (abbrev_buf);
+	  form = read_uleb128 (abbrev_buf);
+	  if (name == 0)
+	    break;
+	  attrs[num_attrs].name = (enum dwarf_attribute) name;
+	  attrs[num_attrs].form = (enum dwarf_form) form;
+	  if ((enum dwarf_form) form == DW_FORM_implicit_const)
+	    attrs[num_attrs].val = read_sleb128 (abbrev_buf);
+	  else
+	    attrs[num_attrs].val = 0;
+	  ++num_attrs;
+	}
+    }
+
+  abbrev->num_attrs = num_attrs;
+  abbrev->attrs = attrs;
+  return 1;
+}
+
 /* Read the abbreviation table for a compilation unit.  Returns 1 on
    success, 0 on failure.  */
 
@@ -1756,8 +1829,6 @@ read_abbrevs (struct backtrace_state *state, uint64_t abbrev_offset,
     {
       uint64_t code;
       struct abbrev a;
-      size_t num_attrs;
-      struct attr *attrs;
 
       if (abbrev_buf.reported_underflow)
 	goto fail;
@@ -1770,53 +1841,8 @@ read_abbrevs (struct backtrace_state *state, uint64_t abbrev_offset,
       a.tag = (enum dwarf_tag) read_uleb128 (&abbrev_buf);
       a.has_children = read_byte (&abbrev_buf);
 
-      count_buf = abbrev_buf;
-      num_attrs = 0;
-      while (read_uleb128 (&count_buf) != 0)
-	{
-	  uint64_t form;
-
-	  ++num_attrs;
-	  form = read_uleb128 (&count_buf);
-	  if ((enum dwarf_form) form == DW_FORM_implicit_const)
-	    read_sleb128 (&count_buf);
-	}
-
-      if (num_attrs == 0)
-	{
-	  attrs = NULL;
-	  read_uleb128 (&abbrev_buf);
-	  read_uleb128 (&abbrev_buf);
-	}
-      else
-	{
-	  attrs = ((struct attr *)
-		   backtrace_alloc (state, num_attrs * sizeof *attrs,
-				    error_callback, data));
-	  if (attrs == NULL)
-	    goto fail;
-	  num_attrs = 0;
-	  while (1)
-	    {
-	      uint64_t name;
-	      uint64_t form;
-
-	      name = read_uleb128 (&abbrev_buf);
-	      form = read_uleb128 (&abbrev_buf);
-	      if (name == 0)
-		break;
-	      attrs[num_attrs].name = (enum dwarf_attribute) name;
-	      attrs[num_attrs].form = (enum dwarf_form) form;
-	      if ((enum dwarf_form) form == DW_FORM_implicit_const)
-		attrs[num_attrs].val = read_sleb128 (&abbrev_buf);
-	      else
-		attrs[num_attrs].val = 0;
-	      ++num_attrs;
-	    }
-	}
-
-      a.num_attrs = num_attrs;
-      a.attrs = attrs;
+      if (!read_abbrev_attrs (state, &abbrev_buf, error_callback, data, &a))
+	goto fail;
 
       abbrevs->abbrevs[num_abbrevs] = a;
       ++num_abbrevs;
@@ -1832,6 +1858,104 @@ read_abbrevs (struct backtrace_state *state, uint64_t abbrev_offset,
   return 0;
 }
 
+/* Read only the abbreviation CODE of the table at ABBREV_OFFSET into
+   ABBREV, skipping over the entries before it.  This avoids reading
+   the whole table for units that are only referenced in passing.  The
+   attributes must be released with free_single_abbrev.  Returns 1 on
+   success, 0 on failure.  */
+
+static int
+read_single_abbrev (struct backtrace_state *state, uint64_t abbrev_offset,
+		    const unsigned char *dwarf_abbrev, size_t dwarf_abbrev_size,
+		    int is_bigendian, uint64_t code,
+		    backtrace_error_callback error_callback, void *data,
+		    struct abbrev *abbrev)
+{
+  struct dwarf_buf abbrev_buf;
+
+  if (abbrev_offset >= dwarf_abbrev_size)
+    {
+      error_callback (data, "abbrev offset out of range", 0);
+      return 0;
+    }
+
+  abbrev_buf.name = ".debug_abbrev";
+  abbrev_buf.start = dwarf_abbrev;
+  abbrev_buf.buf = dwarf_abbrev + abbrev_offset;
+  abbrev_buf.left = dwarf_abbrev_size - abbrev_offset;
+  abbrev_buf.is_bigendian = is_bigendian;
+  abbrev_buf.error_callback = error_callback;
+  abbrev_buf.data = data;
+  abbrev_buf.reported_underflow = 0;
+
+  while (1)
+    {
+      uint64_t c;
+
+      c = read_uleb128 (&abbrev_buf);
+      if (abbrev_buf.reported_underflow)
+	return 0;
+      if (c == 0)
+	{
+	  error_callback (data, "invalid abbreviation code", 0);
+	  return 0;
+	}
+
+      abbrev->code = c;
+      abbrev->tag = (enum dwarf_tag) read_uleb128 (&abbrev_buf);
+      abbrev->has_children = read_byte (&abbrev_buf);
+
+      if (c == code)
+	return read_abbrev_attrs (state, &abbrev_buf, error_callback, data,
+				  abbrev);
+
+      // Skip attributes.
+      while (read_uleb128 (&abbrev_buf) != 0)
+	{
+	  uint64_t form;
+
+	  form = read_uleb128 (&abbrev_buf);
+	  if ((enum dwarf_form) form == DW_FORM_implicit_const)
+	    read_sleb128 (&abbrev_buf);
+	}
+      // Skip form of last attribute.
+      read_uleb128 (&abbrev_buf);
+    }
+}
+
+/* Free an abbreviation read by read_single_abbrev.  */
+
+static void
+free_single_abbrev (struct backtrace_state *state, struct abbrev *abbrev,
+		    backtrace_error_callback error_callback, void *data)
+{
+  backtrace_free (state, abbrev->attrs,
+		  abbrev->num_attrs * sizeof (struct attr),
+		  error_callback, data);
+}
+
+/* Read the abbreviations of unit U if that has not been done yet.
+   The flag is published with release semantics, so that threads
+   prebuilding other units can tell whether the table is complete.
+   Returns 1 on success, 0 on failure.  */
+
+static int
+read_unit_abbrevs (struct backtrace_state *state,
+		   const struct dwarf_sections *dwarf_sections,
+		   int is_bigendian, struct unit *u,
+		   backtrace_error_callback error_callback, void *data)
+{
+  if (u->abbrevs_read)
+    return 1;
+  if (!read_abbrevs (state, u->abbrev_offset,
+		     dwarf_sections->data[DEBUG_ABBREV],
+		     dwarf_sections->size[DEBUG_ABBREV],
+		     is_bigendian, error_callback, data, &u->abbrevs))
+    return 0;
+  backtrace_atomic_store_int (&u->abbrevs_read, 1);
+  return 1;
+}
+
 /* Return the abbrev information for an abbrev code.  */
 
 static const struct abbrev *
@@ -2283,6 +2407,9 @@ find_address_ranges (struct backtrace_state *state, uintptr_t base_address,
 		     struct unit *u, struct unit_addrs_vector *addrs,
 		     enum dwarf_tag *unit_tag)
 {
+  struct abbrev single;
+  int have_single = 0;
+
   while (unit_buf->left > 0)
     {
       uint64_t code;
@@ -2298,9 +2425,23 @@ find_address_ranges (struct backtrace_state *state, uintptr_t base_address,
       if (code == 0)
 	return 1;
 
-      abbrev = lookup_abbrev (&u->abbrevs, code, error_callback, data);
-      if (abbrev == NULL)
-	return 0;
+      if (u->abbrevs_read)
+	{
+	  abbrev = lookup_abbrev (&u->abbrevs, code, error_callback, data);
+	  if (abbrev == NULL)
+	    return 0;
+	}
+      else
+	{
+	  if (!read_single_abbrev (state, u->abbrev_offset,
+				   dwarf_sections->data[DEBUG_ABBREV],
+				   dwarf_sections->size[DEBUG_ABBREV],
+				   is_bigendian, code, error_callback, data,
+				   &single))
+	    return 0;
+	  have_single = 1;
+	  abbrev = &single;
+	}
 
       if (unit_tag != NULL)
 	*unit_tag = abbrev->tag;
@@ -2317,7 +2458,7 @@ find_address_ranges (struct backtrace_state *state, uintptr_t base_address,
 	  if (!read_attribute (abbrev->attrs[i].form, abbrev->attrs[i].val,
 			       unit_buf, u->is_dwarf64, u->version,
 			       u->addrsize, dwarf_sections, altlink, &val))
-	    return 0;
+	    goto fail;
 
 	  switch (abbrev->attrs[i].name)
 	    {
@@ -2384,14 +2525,14 @@ find_address_ranges (struct backtrace_state *state, uintptr_t base_address,
 	  if (!resolve_string (dwarf_sections, u->is_dwarf64, is_bigendian,
 			       u->str_offsets_base, &name_val,
 			       error_callback, data, &u->filename))
-	    return 0;
+	    goto fail;
 	}
       if (have_comp_dir_val)
 	{
 	  if (!resolve_string (dwarf_sections, u->is_dwarf64, is_bigendian,
 			       u->str_offsets_base, &comp_dir_val,
 			       error_callback, data, &u->comp_dir))
-	    return 0;
+	    goto fail;
 	}
 
       if (abbrev->tag == DW_TAG_compile_unit
@@ -2402,7 +2543,7 @@ find_address_ranges (struct backtrace_state *state, uintptr_t base_address,
 			   is_bigendian, u, pcrange.lowpc, &pcrange,
 			   add_unit_addr, (void *) u, error_callback, data,
 			   (void *) addrs))
-	    return 0;
+	    goto fail;
 
 	  /* If we found the PC range in the DW_TAG_compile_unit or
 	     DW_TAG_skeleton_unit, we can stop now.  */
@@ -2410,19 +2551,43 @@ find_address_ranges (struct backtrace_state *state, uintptr_t base_address,
 	       || abbrev->tag == DW_TAG_skeleton_unit)
 	      && (pcrange.have_ranges
 		  || (pcrange.have_lowpc && pcrange.have_highpc)))
-	    return 1;
+	    {
+	      if (have_single)
+		free_single_abbrev (state, &single, error_callback, data);
+	      return 1;
+	    }
 	}
 
       if (abbrev->has_children)
 	{
+	  /* The unit DIE does not cover the PC range, so the children
+	     have to be walked with the full abbreviation table.  */
+	  if (have_single)
+	    {
+	      free_single_abbrev (state, &single, error_callback, data);
+	      have_single = 0;
+	      if (!read_unit_abbrevs (state, dwarf_sections, is_bigendian, u,
+				      error_callback, data))
+		return 0;
+	    }
 	  if (!find_address_ranges (state, base_address, unit_buf,
 				    dwarf_sections, is_bigendian, altlink,
 				    error_callback, data, u, addrs, NULL))
 	    return 0;
 	}
+      else if (have_single)
+	{
+	  free_single_abbrev (state, &single, error_callback, data);
+	  have_single = 0;
+	}
     }
 
   return 1;
+
+ fail:
+  if (have_single)
+    free_single_abbrev (state, &single, error_callback, data);
+  return 0;
 }
 
 /* Build a mapping from address ranges to the compilation units where
@@ -2474,7 +2639,6 @@ build_address_map (struct backtrace_state *state, uintptr_t base_address,
       struct dwarf_buf unit_buf;
       int version;
       int unit_type;
-      uint64_t abbrev_offset;
       int addrsize;
       struct unit *u;
       enum dwarf_tag unit_tag;
@@ -2530,11 +2694,15 @@ build_address_map (struct backtrace_state *state, uintptr_t base_address,
 	addrsize = read_byte (&unit_buf);
 
       memset (&u->abbrevs, 0, sizeof u->abbrevs);
-      abbrev_offset = read_offset (&unit_buf, is_dwarf64);
-      if (!read_abbrevs (state, abbrev_offset,
-			 dwarf_sections->data[DEBUG_ABBREV],
-			 dwarf_sections->size[DEBUG_ABBREV],
-			 is_bigendian, error_callback, data, &u->abbrevs))
+      u->abbrev_offset = read_offset (&unit_buf, is_dwarf64);
+      u->abbrevs_read = 0;
+      u->lock = 0;
+
+      /* Lookups in a threaded state could race on reading the table
+	 lazily, so read it now.  */
+      if (state->threaded
+	  && !read_unit_abbrevs (state, dwarf_sections, is_bigendian, u,
+				 error_callback, data))
 	goto fail;
 
       if (version < 5)
@@ -3346,14 +3514,16 @@ read_line_info (struct backtrace_state *state, struct dwarf_data *ddata,
   return 0;
 }
 
-static const char *read_referenced_name (struct dwarf_data *, struct unit *,
+static const char *read_referenced_name (struct backtrace_state *,
+					 struct dwarf_data *, struct unit *,
 					 uint64_t, backtrace_error_callback,
 					 void *);
 
 /* Read the name of a function from a DIE referenced by ATTR with VAL.  */
 
 static const char *
-read_referenced_name_from_attr (struct dwarf_data *ddata, struct unit *u,
+read_referenced_name_from_attr (struct backtrace_state *state,
+				struct dwarf_data *ddata, struct unit *u,
 				struct attr *attr, struct attr_val *val,
 				backtrace_error_callback error_callback,
 				void *data)
@@ -3379,12 +3549,14 @@ read_referenced_name_from_attr (struct dwarf_data *ddata, struct unit *u,
 	return NULL;
 
       uint64_t offset = val->u.uint - unit->low_offset;
-      return read_referenced_name (ddata, unit, offset, error_callback, data);
+      return read_referenced_name (state, ddata, unit, offset, error_callback,
+				   data);
     }
 
   if (val->encoding == ATTR_VAL_UINT
       || val->encoding == ATTR_VAL_REF_UNIT)
-    return read_referenced_name (ddata, u, val->u.uint, error_callback, data);
+    return read_referenced_name (state, ddata, u, val->u.uint, error_callback,
+				 data);
 
   if (val->encoding == ATTR_VAL_REF_ALT_INFO)
     {
@@ -3395,72 +3567,34 @@ read_referenced_name_from_attr (struct dwarf_data *ddata, struct unit *u,
 	return NULL;
 
       uint64_t offset = val->u.uint - alt_unit->low_offset;
-      return read_referenced_name (ddata->altlink, alt_unit, offset,
+      return read_referenced_name (state, ddata->altlink, alt_unit, offset,
 				   error_callback, data);
     }
 
   return NULL;
 }
 
-/* Read the name of a function from a DIE referenced by a
-   DW_AT_abstract_origin or DW_AT_specification tag.  OFFSET is within
-   the same compilation unit.  */
+/* Read the name of a function from the attributes of a DIE described
+   by ABBREV, starting at UNIT_BUF.  */
 
 static const char *
-read_referenced_name (struct dwarf_data *ddata, struct unit *u,
-		      uint64_t offset, backtrace_error_callback error_callback,
-		      void *data)
+read_referenced_name_attrs (struct backtrace_state *state,
+			    struct dwarf_data *ddata, struct unit *u,
+			    struct dwarf_buf *unit_buf,
+			    const struct abbrev *abbrev,
+			    backtrace_error_callback error_callback,
+			    void *data)
 {
-  struct dwarf_buf unit_buf;
-  uint64_t code;
-  const struct abbrev *abbrev;
   const char *ret;
   size_t i;
 
-  /* OFFSET is from the start of the data for this compilation unit.
-     U->unit_data is the data, but it starts U->unit_data_offset bytes
-     from the beginning.  */
-
-  if (offset < u->unit_data_offset
-      || offset - u->unit_data_offset >= u->unit_data_len)
-    {
-      error_callback (data,
-		      "abstract origin or specification out of range",
-		      0);
-      return NULL;
-    }
-
-  offset -= u->unit_data_offset;
-
-  unit_buf.name = ".debug_info";
-  unit_buf.start = ddata->dwarf_sections.data[DEBUG_INFO];
-  unit_buf.buf = u->unit_data + offset;
-  unit_buf.left = u->unit_data_len - offset;
-  unit_buf.is_bigendian = ddata->is_bigendian;
-  unit_buf.error_callback = error_callback;
-  unit_buf.data = data;
-  unit_buf.reported_underflow = 0;
-
-  code = read_uleb128 (&unit_buf);
-  if (code == 0)
-    {
-      dwarf_buf_error (&unit_buf,
-		      "invalid abstract origin or specification",
-		      0);
-      return NULL;
-    }
-
-  abbrev = lookup_abbrev (&u->abbrevs, code, error_callback, data);
-  if (abbrev == NULL)
-    return NULL;
-
   ret = NULL;
   for (i = 0; i < abbrev->num_attrs; ++i)
     {
       struct attr_val val;
 
       if (!read_attribute (abbrev->attrs[i].form, abbrev->attrs[i].val,
-			   &unit_buf, u->is_dwarf64, u->version, u->addrsize,
+			   unit_buf, u->is_dwarf64, u->version, u->addrsize,
 			   &ddata->dwarf_sections, ddata->altlink, &val))
 	return NULL;
 
@@ -3500,8 +3634,9 @@ read_referenced_name (struct dwarf_data *ddata, struct unit *u,
 	  {
 	    const char *name;
 
-	    name = read_referenced_name_from_attr (ddata, u, &abbrev->attrs[i],
-						   &val, error_callback, data);
+	    name = read_referenced_name_from_attr (state, ddata, u,
+						   &abbrev->attrs[i], &val,
+						   error_callback, data);
 	    if (name != NULL)
 	      ret = name;
 	  }
@@ -3515,6 +3650,77 @@ read_referenced_name (struct dwarf_data *ddata, struct unit *u,
   return ret;
 }
 
+/* Read the name of a function from a DIE referenced by a
+   DW_AT_abstract_origin or DW_AT_specification tag.  OFFSET is within
+   the same compilation unit.  */
+
+static const char *
+read_referenced_name (struct backtrace_state *state, struct dwarf_data *ddata,
+		      struct unit *u, uint64_t offset,
+		      backtrace_error_callback error_callback, void *data)
+{
+  struct dwarf_buf unit_buf;
+  uint64_t code;
+  const struct abbrev *abbrev;
+  struct abbrev single;
+  const char *ret;
+
+  /* OFFSET is from the start of the data for this compilation unit.
+     U->unit_data is the data, but it starts U->unit_data_offset bytes
+     from the beginning.  */
+
+  if (offset < u->unit_data_offset
+      || offset - u->unit_data_offset >= u->unit_data_len)
+    {
+      error_callback (data,
+		      "abstract origin or specification out of range",
+		      0);
+      return NULL;
+    }
+
+  offset -= u->unit_data_offset;
+
+  unit_buf.name = ".debug_info";
+  unit_buf.start = ddata->dwarf_sections.data[DEBUG_INFO];
+  unit_buf.buf = u->unit_data + offset;
+  unit_buf.left = u->unit_data_len - offset;
+  unit_buf.is_bigendian = ddata->is_bigendian;
+  unit_buf.error_callback = error_callback;
+  unit_buf.data = data;
+  unit_buf.reported_underflow = 0;
+
+  code = read_uleb128 (&unit_buf);
+  if (code == 0)
+    {
+      dwarf_buf_error (&unit_buf,
+		      "invalid abstract origin or specification",
+		      0);
+      return NULL;
+    }
+
+  if (backtrace_atomic_load_int (&u->abbrevs_read))
+    {
+      abbrev = lookup_abbrev (&u->abbrevs, code, error_callback, data);
+      if (abbrev == NULL)
+	return NULL;
+      return read_referenced_name_attrs (state, ddata, u, &unit_buf, abbrev,
+					 error_callback, data);
+    }
+
+  /* The DIE may be in a unit whose abbreviations have not been read
+     yet.  Only decode the one we need rather than the whole table.  */
+  if (!read_single_abbrev (state, u->abbrev_offset,
+			   ddata->dwarf_sections.data[DEBUG_ABBREV],
+			   ddata->dwarf_sections.size[DEBUG_ABBREV],
+			   ddata->is_bigendian, code, error_callback, data,
+			   &single))
+    return NULL;
+  ret = read_referenced_name_attrs (state, ddata, u, &unit_buf, &single,
+				    error_callback, data);
+  free_single_abbrev (state, &single, error_callback, data);
+  return ret;
+}
+
 /* Add a range to a unit that maps to a function.  This is called via
    add_ranges.  Returns 1 on success, 0 on error.  */
 
@@ -3669,7 +3875,7 @@ read_function_entry (struct backtrace_state *state, struct dwarf_data *ddata,
 		    const char *name;
 
 		    name
-		      = read_referenced_name_from_attr (ddata, u,
+		      = read_referenced_name_from_attr (state, ddata, u,
 							&abbrev->attrs[i], &val,
 							error_callback, data);
 		    if (name != NULL)
@@ -3979,6 +4185,41 @@ report_inlined_functions (uintptr_t pc, struct function *function, const char* c
   return 0;
 }
 
+/* Read the line and function information of the unit U.  If the
+   information can't be read, *LINES is set to -1.  Returns 1 if any new
+   data was read.  If FVEC is not NULL it is used as scratch space.  */
+
+static int
+read_unit_info (struct backtrace_state *state, struct dwarf_data *ddata,
+		struct unit *u, struct function_vector *fvec,
+		backtrace_error_callback error_callback, void *data,
+		struct line **lines, size_t *lines_count,
+		struct function_addrs **function_addrs,
+		size_t *function_addrs_count)
+{
+  struct line_header lhdr;
+
+  *function_addrs = NULL;
+  *function_addrs_count = 0;
+
+  if (!read_unit_abbrevs (state, &ddata->dwarf_sections, ddata->is_bigendian,
+			  u, error_callback, data))
+    {
+      *lines = (struct line *) (uintptr_t) -1;
+      *lines_count = 0;
+      return 0;
+    }
+
+  if (!read_line_info (state, ddata, error_callback, data, u, &lhdr,
+		       lines, lines_count))
+    return 0;
+
+  read_function_info (state, ddata, &lhdr, error_callback, data, u, fvec,
+		      function_addrs, function_addrs_count);
+  free_line_header (state, &lhdr, error_callback, data);
+  return 1;
+}
+
 /* Look for a PC in the DWARF mapping for one module.  On success,
    call CALLBACK and return whatever it returns.  On error, call
    ERROR_CALLBACK and return 0.  Sets *FOUND to 1 if the PC is found,
@@ -4053,7 +4294,10 @@ dwarf_lookup_pc (struct backtrace_state *state, struct dwarf_data *ddata,
      simultaneously.  */
 
   u = entry->u;
-  lines = u->lines;
+  if (state->threaded)
+    lines = (struct line *) backtrace_atomic_load_pointer (&u->lines);
+  else
+    lines = u->lines;
 
   /* Skip units with no useful line number information by walking
      backward.  Useless line number information is marked by setting
@@ -4062,57 +4306,52 @@ dwarf_lookup_pc (struct backtrace_state *state, struct dwarf_data *ddata,
 	 && pc >= (entry - 1)->low
 	 && pc < (entry - 1)->high)
     {
-      if (state->threaded)
-	lines = (struct line *) backtrace_atomic_load_pointer (&u->lines);
-
       if (lines != (struct line *) (uintptr_t) -1)
 	break;
 
       --entry;
 
       u = entry->u;
-      lines = u->lines;
+      if (state->threaded)
+	lines = (struct line *) backtrace_atomic_load_pointer (&u->lines);
+      else
+	lines = u->lines;
     }
 
-  if (state->threaded)
-    lines = backtrace_atomic_load_pointer (&u->lines);
-
   new_data = 0;
+  if (lines == NULL && state->threaded)
+    {
+      /* Only one thread reads the unit, the others wait for it.  A
+	 reader that sees LINES set may then use the other fields
+	 without racing with a second writer.  */
+      while (__sync_lock_test_and_set (&u->lock, 1))
+	sched_yield ();
+      lines = (struct line *) backtrace_atomic_load_pointer (&u->lines);
+      if (lines != NULL)
+	__sync_lock_release (&u->lock);
+    }
   if (lines == NULL)
     {
       struct function_addrs *function_addrs;
       size_t function_addrs_count;
-      struct line_header lhdr;
+      struct function_vector *pfvec;
       size_t count;
 
       /* We have never read the line information for this unit.  Read
-	 it now.  */
-
-      function_addrs = NULL;
-      function_addrs_count = 0;
-      if (read_line_info (state, ddata, error_callback, data, entry->u, &lhdr,
-			  &lines, &count))
-	{
-	  struct function_vector *pfvec;
+	 it now.  If not threaded, reuse DDATA->FVEC for better memory
+	 consumption.  */
 
-	  /* If not threaded, reuse DDATA->FVEC for better memory
-	     consumption.  */
-	  if (state->threaded)
-	    pfvec = NULL;
-	  else
-	    pfvec = &ddata->fvec;
-	  read_function_info (state, ddata, &lhdr, error_callback, data,
-			      entry->u, pfvec, &function_addrs,
-			      &function_addrs_count);
-	  free_line_header (state, &lhdr, error_callback, data);
-	  new_data = 1;
-	}
+      if (state->threaded)
+	pfvec = NULL;
+      else
+	pfvec = &ddata->fvec;
+      new_data = read_unit_info (state, ddata, entry->u, pfvec,
+				 error_callback, data, &lines, &count,
+				 &function_addrs, &function_addrs_count);
 
       /* Atomically store the information we just read into the unit.
-	 If another thread is simultaneously writing, it presumably
-	 read the same information, and we don't care which one we
-	 wind up with; we just leak the other one.  We do have to
-	 write the lines field last, so that the acquire-loads above
+	 When threaded the unit lock is held, so there is no other
+	 writer.  We do have to write the lines field last, so that the acquire-loads above
 	 ensure that the other fields are set.  */
 
       if (!state->threaded)
@@ -4129,6 +4368,7 @@ dwarf_lookup_pc (struct backtrace_state *state, struct dwarf_data *ddata,
 	  backtrace_atomic_store_size_t (&u->function_addrs_count,
 					 function_addrs_count);
 	  backtrace_atomic_store_pointer (&u->lines, lines);
+	  __sync_lock_release (&u->lock);
 	}
     }
 
@@ -4156,7 +4396,13 @@ dwarf_lookup_pc (struct backtrace_state *state, struct dwarf_data *ddata,
 	 This implies that the start of the compilation unit has no
 	 line number information.  */
 
-      if (entry->u->abs_filename == NULL)
+      const char *abs_filename;
+
+      if (state->threaded)
+	abs_filename = (const char *) backtrace_atomic_load_pointer (&entry->u->abs_filename);
+      else
+	abs_filename = entry->u->abs_filename;
+      if (abs_filename == NULL)
 	{
 	  const char *filename;
 
@@ -4186,10 +4432,15 @@ dwarf_lookup_pc (struct backtrace_state *state, struct dwarf_data *ddata,
 	      memcpy (s + dir_len + 1, filename, filename_len + 1);
 	      filename = s;
 	    }
-	  entry->u->abs_filename = filename;
+	  /* Threads racing here compute the same name, one is leaked.  */
+	  if (state->threaded)
+	    backtrace_atomic_store_pointer (&entry->u->abs_filename, filename);
+	  else
+	    entry->u->abs_filename = filename;
+	  abs_filename = filename;
 	}
 
-      return callback (data, pc, 0, entry->u->abs_filename, 0, NULL);
+      return callback (data, pc, 0, abs_filename, 0, NULL);
     }
 
   /* Search for function name within this unit.  */
@@ -4302,20 +4553,35 @@ dwarf_fileline (struct backtrace_state *state, uintptr_t pc,
   else
     {
       struct dwarf_data **pp;
+      int retry;
 
-      pp = (struct dwarf_data **) (void *) &state->fileline_data;
-      while (1)
+      for (retry = 0; retry < 2; ++retry)
 	{
-	  ddata = backtrace_atomic_load_pointer (pp);
-	  if (ddata == NULL)
-	    break;
+	  pp = (struct dwarf_data **) (void *) &state->fileline_data;
+	  while (1)
+	    {
+	      ddata = backtrace_atomic_load_pointer (pp);
+	      if (ddata == NULL)
+		break;
+
+	      ret = dwarf_lookup_pc (state, ddata, pc, callback,
+				     error_callback, data, &found);
+	      if (ret != 0 || found)
+		return ret;
+
+	      pp = &ddata->next;
+	    }
 
-	  ret = dwarf_lookup_pc (state, ddata, pc, callback, error_callback,
-				 data, &found);
-	  if (ret != 0 || found)
-	    return ret;
+	  if (retry != 0 || !state->request_known_address_ranges_refresh_fn)
+	    break;
 
-	  pp = &ddata->next;
+	  /* The known address ranges are shared, so only one thread may
+	     refresh them at a time.  Another thread may have added the
+	     image while we waited, so look again in any case.  */
+	  while (__sync_lock_test_and_set (&state->lock_refresh, 1))
+	    sched_yield ();
+	  state->request_known_address_ranges_refresh_fn (state, pc);
+	  __sync_lock_release (&state->lock_refresh);
 	}
     }
 
@@ -4324,6 +4590,64 @@ dwarf_fileline (struct backtrace_state *state, uintptr_t pc,
   return callback (data, pc, 0, NULL, 0, NULL);
 }
 
+/* Read the line and function information of every INDEX'th out of
+   COUNT units of the modules known to STATE.  Calls for different
+   INDEX values may run in parallel, but not concurrently with lookups
+   unless STATE is threaded.  */
+
+void
+backtrace_dwarf_prebuild (struct backtrace_state *state, int index,
+			  int count, backtrace_error_callback error_callback,
+			  void *data)
+{
+  struct dwarf_data *ddata;
+  size_t n;
+
+  if (state->fileline_fn != dwarf_fileline || index < 0 || index >= count)
+    return;
+
+  n = 0;
+  for (ddata = (struct dwarf_data *) state->fileline_data;
+       ddata != NULL;
+       ddata = ddata->next)
+    {
+      size_t i;
+
+      for (i = 0; i < ddata->units_count; ++i, ++n)
+	{
+	  struct unit *u;
+	  struct line *lines;
+	  size_t lines_count;
+	  struct function_addrs *function_addrs;
+	  size_t function_addrs_count;
+
+	  u = ddata->units[i];
+	  if (n % count != (size_t) index
+	      || backtrace_atomic_load_pointer (&u->lines) != NULL)
+	    continue;
+
+	  while (__sync_lock_test_and_set (&u->lock, 1))
+	    sched_yield ();
+	  if (backtrace_atomic_load_pointer (&u->lines) != NULL)
+	    {
+	      __sync_lock_release (&u->lock);
+	      continue;
+	    }
+
+	  read_unit_info (state, ddata, u, NULL, error_callback, data,
+			  &lines, &lines_count, &function_addrs,
+			  &function_addrs_count);
+
+	  backtrace_atomic_store_size_t (&u->lines_count, lines_count);
+	  backtrace_atomic_store_pointer (&u->function_addrs, function_addrs);
+	  backtrace_atomic_store_size_t (&u->function_addrs_count,
+					 function_addrs_count);
+	  backtrace_atomic_store_pointer (&u->lines, lines);
+	  __sync_lock_release (&u->lock);
+	}
+    }
+}
+
 /* Initialize our data structures from the DWARF debug info for a
    file.  Return NULL on failure.  */
 
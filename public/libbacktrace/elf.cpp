@@ -7549,16 +7549,30 @@ backtrace_initialize (struct backtrace_state *state, const char *filename,
   if (!ret)
     return 0;
 
-  pd.state = state;
-  pd.error_callback = error_callback;
-  pd.data = data;
-  pd.fileline_fn = &elf_fileline_fn;
-  pd.found_sym = &found_sym;
-  pd.found_dwarf = &found_dwarf;
-  pd.exe_filename = filename;
-  pd.exe_descriptor = ret < 0 ? descriptor : -1;
+  if (state->offline)
+    {
+      /* A position independent file was left open by elf_add, add it
+	 at its link-time addresses instead of where the running
+	 executable is loaded.  */
+      if (ret < 0
+	  && !elf_add (state, filename, descriptor, NULL, 0, 0, NULL,
+		       error_callback, data, &elf_fileline_fn, &found_sym,
+		       &found_dwarf, NULL, 0, 0, NULL, 0))
+	return 0;
+    }
+  else
+    {
+      pd.state = state;
+      pd.error_callback = error_callback;
+      pd.data = data;
+      pd.fileline_fn = &elf_fileline_fn;
+      pd.found_sym = &found_sym;
+      pd.found_dwarf = &found_dwarf;
+      pd.exe_filename = filename;
+      pd.exe_descriptor = ret < 0 ? descriptor : -1;
 
-  elf_iterate_phdr_and_add_new_files(&pd);
+      elf_iterate_phdr_and_add_new_files(&pd);
+    }
 
   if (!state->threaded)
     {
@@ -7572,8 +7586,8 @@ backtrace_initialize (struct backtrace_state *state, const char *filename,
       if (found_sym)
 	backtrace_atomic_store_pointer (&state->syminfo_fn, &elf_syminfo);
       else
-	(void) __sync_bool_compare_and_swap (&state->syminfo_fn, NULL,
-					     elf_nosyms);
+	(void) __sync_bool_compare_and_swap (&state->syminfo_fn, (syminfo) NULL,
+					     &elf_nosyms);
     }
 
   if (!state->threaded)
@@ -7586,7 +7600,10 @@ backtrace_initialize (struct backtrace_state *state, const char *filename,
 
   // install an address range refresh callback so we can cope with dynamically loaded elf files
 #ifdef TRACY_LIBBACKTRACE_ELF_DYNLOAD_SUPPORT
-  state->request_known_address_ranges_refresh_fn = elf_refresh_address_ranges_if_needed;
+  if (!state->offline)
+    state->request_known_address_ranges_refresh_fn = elf_refresh_address_ranges_if_needed;
+  else
+    state->request_known_address_ranges_refresh_fn = NULL;
 #else
   state->request_known_address_ranges_refresh_fn = NULL;
 #endif
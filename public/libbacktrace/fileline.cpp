@@ -252,6 +252,9 @@ fileline_initialize (struct backtrace_state *state,
     {
       int does_not_exist;
 
+      if (pass > 0 && state->offline)
+	break;
+
       switch (pass)
 	{
 	case 0:
@@ -382,6 +385,33 @@ backtrace_syminfo (struct backtrace_state *state, uintptr_t pc,
   return 1;
 }
 
+/* Read the debug info of the executable now rather than on the first
+   lookup.  */
+
+int
+backtrace_fileline_initialize (struct backtrace_state *state,
+			       backtrace_error_callback error_callback,
+			       void *data)
+{
+  if (!fileline_initialize (state, error_callback, data))
+    return 0;
+
+  return !state->fileline_initialization_failed;
+}
+
+/* Read the line and function tables of a share of the compilation
+   units.  */
+
+void
+backtrace_prebuild (struct backtrace_state *state, int index, int count,
+		    backtrace_error_callback error_callback, void *data)
+{
+  if (state->fileline_fn == NULL || state->fileline_initialization_failed)
+    return;
+
+  backtrace_dwarf_prebuild (state, index, count, error_callback, data);
+}
+
 /* A backtrace_syminfo_callback that can call into a
    backtrace_full_callback, used when we have a symbol table but no
    debug info.  */
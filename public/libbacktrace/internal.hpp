@@ -146,6 +146,9 @@ struct backtrace_state
   const char *filename;
   /* Non-zero if threaded.  */
   int threaded;
+  /* Non-zero if FILENAME is not loaded into this process and is read
+     at its link-time addresses.  */
+  int offline;
   /* The master lock for fileline_fn, fileline_data, syminfo_fn,
      syminfo_data, fileline_initialization_failed and everything the
      data pointers point to.  */
@@ -166,6 +169,8 @@ struct backtrace_state
   struct backtrace_freelist_struct *freelist;
   /* Trigger an known address range refresh */
   request_known_address_ranges_refresh request_known_address_ranges_refresh_fn;
+  /* The lock for known address range refreshes when threaded.  */
+  int lock_refresh;
 };
 
 /* Open a file for reading.  Returns -1 on error.  If DOES_NOT_EXIST
@@ -344,6 +349,14 @@ extern int backtrace_dwarf_add (struct backtrace_state *state,
 				void *data, fileline *fileline_fn,
 				struct dwarf_data **fileline_entry);
 
+/* Read the DWARF line and function information of a share of the
+   compilation units ahead of lookups.  */
+
+extern void backtrace_dwarf_prebuild (struct backtrace_state *state,
+				      int index, int count,
+				      backtrace_error_callback error_callback,
+				      void *data);
+
 /* A data structure to pass to backtrace_syminfo_to_full.  */
 
 struct backtrace_call_full
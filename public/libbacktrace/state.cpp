@@ -73,4 +73,19 @@ backtrace_create_state (const char *filename, int threaded,
   return state;
 }
 
+/* Create the backtrace state for a file that is not loaded.  */
+
+struct backtrace_state *
+backtrace_create_state_offline (const char *filename, int threaded,
+				backtrace_error_callback error_callback,
+				void *data)
+{
+  struct backtrace_state *state;
+
+  state = backtrace_create_state (filename, threaded, error_callback, data);
+  if (state != NULL)
+    state->offline = 1;
+  return state;
+}
+
 }
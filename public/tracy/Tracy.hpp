@@ -110,6 +110,8 @@ template<class T> T ceil( T x )
 
 #define TracyPlot(x,y)
 #define TracyPlotConfig(x,y,z,w,a)
+#define TracyCounter(x,y)
+#define TracyHistogram(x,y)
 
 #define TracyMessage(x,y)
 #define TracyMessageL(x)
@@ -232,6 +234,8 @@ template<class T> T ceil( T x )
 
 #define TracyPlot( name, val ) tracy::Profiler::PlotData( name, val )
 #define TracyPlotConfig( name, type, step, fill, color ) tracy::Profiler::ConfigurePlot( name, type, step, fill, color )
+#define TracyCounter( name, val ) tracy::Profiler::CounterAdd( name, val )
+#define TracyHistogram( name, val ) tracy::Profiler::HistogramRecord( name, val )
 
 #define TracyAppInfo( txt, size ) tracy::Profiler::MessageAppInfo( txt, size )
 
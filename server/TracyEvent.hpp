@@ -2,13 +2,16 @@
 #define __TRACYEVENT_HPP__
 
 #include <assert.h>
+#include <algorithm>
 #include <array>
+#include <bit>
 #include <limits>
 #include <stdint.h>
 #include <string>
 #include <string.h>
 #include <bitset>
 #include <memory_resource>
+#include <vector>
 
 #include "TracyCharUtil.hpp"
 #include "TracyShortPtr.hpp"
@@ -16,6 +19,7 @@
 #include "TracyVector.hpp"
 #include "tracy_robin_hood.h"
 #include "../public/common/TracyForceInline.hpp"
+#include "../public/common/TracyHistogram.hpp"
 #include "../public/common/TracyQueue.hpp"
 
 namespace tracy
@@ -231,6 +235,39 @@ private:
     uint8_t m_val[3];
 };
 
+// Times are kept in 48 bit signed fields of packed events. Values from -2^46 to 2^47-1 are
+// stored as is. Codes below -2^46 are never valid times, so they are used to hold times past
+// 2^47 ns with reduced precision. Each doubling of time gets 2^43 steps, which gives 16 ns
+// steps up to 2^48 ns, 32 ns steps up to 2^49 ns, and so on. Stored times are rounded down,
+// so the order of events is kept. Packed codes of non-negative times compare in the same
+// order as the times, when taken as unsigned values.
+enum { PackedTimeExtBits = 43 };
+constexpr int64_t PackedTimeExtBegin = -( 1ll << 46 );
+constexpr int64_t PackedTimeExtStart = 1ll << 47;
+constexpr int64_t MaxEventTime = ( 1ll << ( 47 + ( 1 << ( 46 - PackedTimeExtBits ) ) ) ) - 1;
+
+tracy_force_inline int64_t PackTime( int64_t time )
+{
+    if( time < PackedTimeExtStart )
+    {
+        assert( time >= PackedTimeExtBegin );
+        return time;
+    }
+    assert( time <= MaxEventTime );
+    const int exp = std::bit_width( uint64_t( time ) ) - 48;
+    const auto step = ( time - ( PackedTimeExtStart << exp ) ) >> ( 47 - PackedTimeExtBits + exp );
+    return -( 1ll << 47 ) + ( int64_t( exp ) << PackedTimeExtBits ) + step;
+}
+
+tracy_force_inline int64_t UnpackTime( int64_t val )
+{
+    if( val >= PackedTimeExtBegin ) return val;
+    const auto code = val + ( 1ll << 47 );
+    const int exp = int( code >> PackedTimeExtBits );
+    const auto step = code & ( ( 1ll << PackedTimeExtBits ) - 1 );
+    return ( PackedTimeExtStart << exp ) + ( step << ( 47 - PackedTimeExtBits + exp ) );
+}
+
 class Int48
 {
 public:
@@ -247,6 +284,7 @@ public:
 
     tracy_force_inline void SetVal( int64_t val )
     {
+        val = PackTime( val );
         memcpy( m_val, &val, 4 );
         val >>= 32;
         memcpy( m_val+4, &val, 2 );
@@ -258,12 +296,12 @@ public:
         memcpy( &hi, m_val+4, 2 );
         uint32_t lo;
         memcpy( &lo, m_val, 4 );
-        return ( int64_t( uint64_t( hi ) << 32 ) ) | lo;
+        return UnpackTime( ( int64_t( uint64_t( hi ) << 32 ) ) | lo );
     }
 
     tracy_force_inline bool IsNonNegative() const
     {
-        return ( m_val[5] >> 7 ) == 0;
+        return Val() >= 0;
     }
 
 private:
@@ -294,18 +332,18 @@ struct ZoneEvent
 {
     tracy_force_inline ZoneEvent() {};
 
-    tracy_force_inline int64_t Start() const { return int64_t( _start_srcloc ) >> 16; }
-    tracy_force_inline void SetStart( int64_t start ) { assert( start < (int64_t)( 1ull << 47 ) ); memcpy( ((char*)&_start_srcloc)+2, &start, 4 ); memcpy( ((char*)&_start_srcloc)+6, ((char*)&start)+4, 2 ); }
-    tracy_force_inline int64_t End() const { return int64_t( _end_child1 ) >> 16; }
-    tracy_force_inline void SetEnd( int64_t end ) { assert( end < (int64_t)( 1ull << 47 ) ); memcpy( ((char*)&_end_child1)+2, &end, 4 ); memcpy( ((char*)&_end_child1)+6, ((char*)&end)+4, 2 ); }
-    tracy_force_inline bool IsEndValid() const { return ( _end_child1 >> 63 ) == 0; }
+    tracy_force_inline int64_t Start() const { return UnpackTime( int64_t( _start_srcloc ) >> 16 ); }
+    tracy_force_inline void SetStart( int64_t start ) { start = PackTime( start ); memcpy( ((char*)&_start_srcloc)+2, &start, 4 ); memcpy( ((char*)&_start_srcloc)+6, ((char*)&start)+4, 2 ); }
+    tracy_force_inline int64_t End() const { return UnpackTime( int64_t( _end_child1 ) >> 16 ); }
+    tracy_force_inline void SetEnd( int64_t end ) { end = PackTime( end ); memcpy( ((char*)&_end_child1)+2, &end, 4 ); memcpy( ((char*)&_end_child1)+6, ((char*)&end)+4, 2 ); }
+    tracy_force_inline bool IsEndValid() const { return End() >= 0; }
     tracy_force_inline int16_t SrcLoc() const { return int16_t( _start_srcloc & 0xFFFF ); }
     tracy_force_inline void SetSrcLoc( int16_t srcloc ) { memcpy( &_start_srcloc, &srcloc, 2 ); }
     tracy_force_inline int32_t Child() const { int32_t child; memcpy( &child, &_child2, 4 ); return child; }
     tracy_force_inline void SetChild( int32_t child ) { memcpy( &_child2, &child, 4 ); }
     tracy_force_inline bool HasChildren() const { uint8_t tmp; memcpy( &tmp, ((char*)&_end_child1)+1, 1 ); return ( tmp >> 7 ) == 0; }
 
-    tracy_force_inline void SetStartSrcLoc( int64_t start, int16_t srcloc ) { assert( start < (int64_t)( 1ull << 47 ) ); start <<= 16; start |= uint16_t( srcloc ); memcpy( &_start_srcloc, &start, 8 ); }
+    tracy_force_inline void SetStartSrcLoc( int64_t start, int16_t srcloc ) { start = PackTime( start ) << 16; start |= uint16_t( srcloc ); memcpy( &_start_srcloc, &start, 8 ); }
 
     uint64_t _start_srcloc;
     uint16_t _child2;
@@ -414,8 +452,8 @@ struct LockEvent
         ReleaseShared
     };
 
-    tracy_force_inline int64_t Time() const { return int64_t( _time_srcloc ) >> 16; }
-    tracy_force_inline void SetTime( int64_t time ) { assert( time < (int64_t)( 1ull << 47 ) ); memcpy( ((char*)&_time_srcloc)+2, &time, 4 ); memcpy( ((char*)&_time_srcloc)+6, ((char*)&time)+4, 2 ); }
+    tracy_force_inline int64_t Time() const { return UnpackTime( int64_t( _time_srcloc ) >> 16 ); }
+    tracy_force_inline void SetTime( int64_t time ) { time = PackTime( time ); memcpy( ((char*)&_time_srcloc)+2, &time, 4 ); memcpy( ((char*)&_time_srcloc)+6, ((char*)&time)+4, 2 ); }
     tracy_force_inline int16_t SrcLoc() const { return int16_t( _time_srcloc & 0xFFFF ); }
     tracy_force_inline void SetSrcLoc( int16_t srcloc ) { memcpy( &_time_srcloc, &srcloc, 2 ); }
 
@@ -454,6 +492,57 @@ struct LockTimeRange
 };
 
 
+struct LockSrcLocStats
+{
+    uint64_t count = 0;
+    uint64_t contended = 0;
+    int64_t waitTotal = 0;
+    int64_t waitMax = 0;
+    int64_t holdTotal = 0;
+};
+
+struct LockThreadState
+{
+    int64_t waitStart = -1;
+    int64_t holdStart = -1;
+    int64_t wait = 0;
+    uint32_t depth = 0;
+    bool contended = false;
+    short_ptr<LockEvent> obtain;
+};
+
+struct LockStats
+{
+    // Bucket n holds contended (or aggregated) waits in the [2^n, 2^(n+1)) ns range.
+    enum { WaitHistogramSize = 40 };
+
+    // Acquisitions counted on the client in aggregated lock mode, without any
+    // timeline events. Kept separately, as these can't be rebuilt on load.
+    struct Aggregate
+    {
+        uint64_t waitCount;
+        uint64_t holdCount;
+        int64_t waitTotal;
+        int64_t waitMax;
+        int64_t holdTotal;
+        int64_t holdMax;
+        std::array<uint32_t, WaitHistogramSize> waitHistogram;
+        std::array<uint32_t, WaitHistogramSize> holdHistogram;
+    };
+
+    uint64_t obtainCount = 0;
+    uint64_t contendedCount = 0;
+    int64_t waitTotal = 0;
+    int64_t waitMax = 0;
+    int64_t holdTotal = 0;
+    int64_t holdMax = 0;
+    std::array<uint32_t, WaitHistogramSize> waitHistogram = {};
+    std::array<uint32_t, WaitHistogramSize> holdHistogram = {};
+    Aggregate aggregated = {};
+    unordered_flat_map<int16_t, LockSrcLocStats> srcloc;
+    std::vector<LockThreadState> threads;
+};
+
 struct LockMap
 {
     StringIdx customName;
@@ -472,6 +561,7 @@ struct LockMap
     uint64_t lockingThread = 0;
 
     std::array<LockTimeRange, MaxLockThreads> range;
+    LockStats stats;
 };
 
 struct LockHighlight
@@ -486,14 +576,14 @@ struct LockHighlight
 
 struct GpuEvent
 {
-    tracy_force_inline int64_t CpuStart() const { return int64_t( _cpuStart_srcloc ) >> 16; }
-    tracy_force_inline void SetCpuStart( int64_t cpuStart ) { assert( cpuStart < (int64_t)( 1ull << 47 ) ); memcpy( ((char*)&_cpuStart_srcloc)+2, &cpuStart, 4 ); memcpy( ((char*)&_cpuStart_srcloc)+6, ((char*)&cpuStart)+4, 2 ); }
-    tracy_force_inline int64_t CpuEnd() const { return int64_t( _cpuEnd_thread ) >> 16; }
-    tracy_force_inline void SetCpuEnd( int64_t cpuEnd ) { assert( cpuEnd < (int64_t)( 1ull << 47 ) ); memcpy( ((char*)&_cpuEnd_thread)+2, &cpuEnd, 4 ); memcpy( ((char*)&_cpuEnd_thread)+6, ((char*)&cpuEnd)+4, 2 ); }
-    tracy_force_inline int64_t GpuStart() const { return int64_t( _gpuStart_child1 ) >> 16; }
-    tracy_force_inline void SetGpuStart( int64_t gpuStart ) { /*assert( gpuStart < (int64_t)( 1ull << 47 ) );*/ memcpy( ((char*)&_gpuStart_child1)+2, &gpuStart, 4 ); memcpy( ((char*)&_gpuStart_child1)+6, ((char*)&gpuStart)+4, 2 ); }
-    tracy_force_inline int64_t GpuEnd() const { return int64_t( _gpuEnd_child2 ) >> 16; }
-    tracy_force_inline void SetGpuEnd( int64_t gpuEnd ) { assert( gpuEnd < (int64_t)( 1ull << 47 ) ); memcpy( ((char*)&_gpuEnd_child2)+2, &gpuEnd, 4 ); memcpy( ((char*)&_gpuEnd_child2)+6, ((char*)&gpuEnd)+4, 2 ); }
+    tracy_force_inline int64_t CpuStart() const { return UnpackTime( int64_t( _cpuStart_srcloc ) >> 16 ); }
+    tracy_force_inline void SetCpuStart( int64_t cpuStart ) { cpuStart = PackTime( cpuStart ); memcpy( ((char*)&_cpuStart_srcloc)+2, &cpuStart, 4 ); memcpy( ((char*)&_cpuStart_srcloc)+6, ((char*)&cpuStart)+4, 2 ); }
+    tracy_force_inline int64_t CpuEnd() const { return UnpackTime( int64_t( _cpuEnd_thread ) >> 16 ); }
+    tracy_force_inline void SetCpuEnd( int64_t cpuEnd ) { cpuEnd = PackTime( cpuEnd ); memcpy( ((char*)&_cpuEnd_thread)+2, &cpuEnd, 4 ); memcpy( ((char*)&_cpuEnd_thread)+6, ((char*)&cpuEnd)+4, 2 ); }
+    tracy_force_inline int64_t GpuStart() const { return UnpackTime( int64_t( _gpuStart_child1 ) >> 16 ); }
+    tracy_force_inline void SetGpuStart( int64_t gpuStart ) { gpuStart = PackTime( gpuStart ); memcpy( ((char*)&_gpuStart_child1)+2, &gpuStart, 4 ); memcpy( ((char*)&_gpuStart_child1)+6, ((char*)&gpuStart)+4, 2 ); }
+    tracy_force_inline int64_t GpuEnd() const { return UnpackTime( int64_t( _gpuEnd_child2 ) >> 16 ); }
+    tracy_force_inline void SetGpuEnd( int64_t gpuEnd ) { gpuEnd = PackTime( gpuEnd ); memcpy( ((char*)&_gpuEnd_child2)+2, &gpuEnd, 4 ); memcpy( ((char*)&_gpuEnd_child2)+6, ((char*)&gpuEnd)+4, 2 ); }
     tracy_force_inline int16_t SrcLoc() const { return int16_t( _cpuStart_srcloc & 0xFFFF ); }
     tracy_force_inline void SetSrcLoc( int16_t srcloc ) { memcpy( &_cpuStart_srcloc, &srcloc, 2 ); }
     tracy_force_inline uint16_t Thread() const { return uint16_t( _cpuEnd_thread & 0xFFFF ); }
@@ -520,10 +610,10 @@ struct MemEvent
     tracy_force_inline void SetSize( uint64_t size ) { assert( size < ( 1ull << 47 ) ); memcpy( ((char*)&_size_csalloc2)+2, &size, 4 ); memcpy( ((char*)&_size_csalloc2)+6, ((char*)&size)+4, 2 ); }
     tracy_force_inline uint32_t CsAlloc() const { return uint8_t( _ptr_csalloc1 ) | ( uint16_t( _size_csalloc2 ) << 8 ); }
     tracy_force_inline void SetCsAlloc( uint32_t csAlloc ) { memcpy( &_ptr_csalloc1, &csAlloc, 1 ); memcpy( &_size_csalloc2, ((char*)&csAlloc)+1, 2 ); }
-    tracy_force_inline int64_t TimeAlloc() const { return int64_t( _time_thread_alloc ) >> 16; }
-    tracy_force_inline void SetTimeAlloc( int64_t time ) { assert( time < (int64_t)( 1ull << 47 ) ); memcpy( ((char*)&_time_thread_alloc)+2, &time, 4 ); memcpy( ((char*)&_time_thread_alloc)+6, ((char*)&time)+4, 2 ); }
-    tracy_force_inline int64_t TimeFree() const { return int64_t( _time_thread_free ) >> 16; }
-    tracy_force_inline void SetTimeFree( int64_t time ) { assert( time < (int64_t)( 1ull << 47 ) ); memcpy( ((char*)&_time_thread_free)+2, &time, 4 ); memcpy( ((char*)&_time_thread_free)+6, ((char*)&time)+4, 2 ); }
+    tracy_force_inline int64_t TimeAlloc() const { return UnpackTime( int64_t( _time_thread_alloc ) >> 16 ); }
+    tracy_force_inline void SetTimeAlloc( int64_t time ) { time = PackTime( time ); memcpy( ((char*)&_time_thread_alloc)+2, &time, 4 ); memcpy( ((char*)&_time_thread_alloc)+6, ((char*)&time)+4, 2 ); }
+    tracy_force_inline int64_t TimeFree() const { return UnpackTime( int64_t( _time_thread_free ) >> 16 ); }
+    tracy_force_inline void SetTimeFree( int64_t time ) { time = PackTime( time ); memcpy( ((char*)&_time_thread_free)+2, &time, 4 ); memcpy( ((char*)&_time_thread_free)+6, ((char*)&time)+4, 2 ); }
     tracy_force_inline uint16_t ThreadAlloc() const { return uint16_t( _time_thread_alloc ); }
     tracy_force_inline void SetThreadAlloc( uint16_t thread ) { memcpy( &_time_thread_alloc, &thread, 2 ); }
     tracy_force_inline uint16_t ThreadFree() const { return uint16_t( _time_thread_free ); }
@@ -578,6 +668,54 @@ struct SymbolLocation
 enum { SymbolLocationSize = sizeof( SymbolLocation ) };
 
 
+// Copy of sorted keys in the breadth-first order of the implicit search tree. The top levels
+// of all searches share a few cache lines, and the next levels are prefetched ahead.
+struct EytzingerIndex
+{
+    // Builds the index of cnt sorted keys, the i-th key is given by key( i ).
+    template<typename F>
+    void Build( size_t cnt, F&& key )
+    {
+        keys.resize( cnt + 1 );
+        pos.resize( cnt + 1 );
+        size_t i = 0;
+        Fill( 1, i, key );
+    }
+
+    size_t Size() const { return keys.empty() ? 0 : keys.size() - 1; }
+
+    // Returns the position of the first key not less than val, or Size() if there is none.
+    tracy_force_inline size_t LowerBound( uint64_t val ) const
+    {
+        const auto cnt = Size();
+        size_t k = 1;
+        while( k <= cnt )
+        {
+#if defined __GNUC__ || defined __clang__
+            __builtin_prefetch( keys.data() + k * 8 );
+#endif
+            k = 2 * k + ( keys[k] < val );
+        }
+        k >>= std::countr_one( k ) + 1;
+        return k == 0 ? cnt : pos[k];
+    }
+
+private:
+    template<typename F>
+    void Fill( size_t k, size_t& i, F& key )
+    {
+        if( k >= keys.size() ) return;
+        Fill( 2 * k, i, key );
+        keys[k] = key( i );
+        pos[k] = uint32_t( i++ );
+        Fill( 2 * k + 1, i, key );
+    }
+
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> pos;
+};
+
+
 struct CallstackFrameData
 {
     short_ptr<CallstackFrame> data;
@@ -631,11 +769,11 @@ struct ContextSwitchData
     enum : int8_t { NoState = 100 };
     enum : int8_t { Wakeup = -2 };
 
-    tracy_force_inline int64_t Start() const { return int64_t( _start_cpu ) >> 16; }
-    tracy_force_inline void SetStart( int64_t start ) { assert( start < (int64_t)( 1ull << 47 ) ); memcpy( ((char*)&_start_cpu)+2, &start, 4 ); memcpy( ((char*)&_start_cpu)+6, ((char*)&start)+4, 2 ); }
-    tracy_force_inline int64_t End() const { return int64_t( _end_reason_state ) >> 16; }
-    tracy_force_inline void SetEnd( int64_t end ) { assert( end < (int64_t)( 1ull << 47 ) ); memcpy( ((char*)&_end_reason_state)+2, &end, 4 ); memcpy( ((char*)&_end_reason_state)+6, ((char*)&end)+4, 2 ); }
-    tracy_force_inline bool IsEndValid() const { return ( _end_reason_state >> 63 ) == 0; }
+    tracy_force_inline int64_t Start() const { return UnpackTime( int64_t( _start_cpu ) >> 16 ); }
+    tracy_force_inline void SetStart( int64_t start ) { start = PackTime( start ); memcpy( ((char*)&_start_cpu)+2, &start, 4 ); memcpy( ((char*)&_start_cpu)+6, ((char*)&start)+4, 2 ); }
+    tracy_force_inline int64_t End() const { return UnpackTime( int64_t( _end_reason_state ) >> 16 ); }
+    tracy_force_inline void SetEnd( int64_t end ) { end = PackTime( end ); memcpy( ((char*)&_end_reason_state)+2, &end, 4 ); memcpy( ((char*)&_end_reason_state)+6, ((char*)&end)+4, 2 ); }
+    tracy_force_inline bool IsEndValid() const { return End() >= 0; }
     tracy_force_inline uint8_t Cpu() const { return uint8_t( _start_cpu & 0xFF ); }
     tracy_force_inline void SetCpu( uint8_t cpu ) { memcpy( &_start_cpu, &cpu, 1 ); }
     tracy_force_inline int8_t Reason() const { return int8_t( (_end_reason_state >> 8) & 0xFF ); }
@@ -643,14 +781,14 @@ struct ContextSwitchData
     tracy_force_inline int8_t State() const { return int8_t( _end_reason_state & 0xFF ); }
     tracy_force_inline void SetState( int8_t state ) { memcpy( &_end_reason_state, &state, 1 ); }
     tracy_force_inline int64_t WakeupVal() const { return _wakeup.Val(); }
-    tracy_force_inline void SetWakeup( int64_t wakeup ) { assert( wakeup < (int64_t)( 1ull << 47 ) ); _wakeup.SetVal( wakeup ); }
+    tracy_force_inline void SetWakeup( int64_t wakeup ) { _wakeup.SetVal( wakeup ); }
 	tracy_force_inline uint8_t WakeupCpu() const { return _wakeupCpu; }
 	tracy_force_inline void SetWakeupCpu( uint8_t wakeupCpu ) { _wakeupCpu = wakeupCpu; }
     tracy_force_inline uint16_t Thread() const { return _thread; }
     tracy_force_inline void SetThread( uint16_t thread ) { _thread = thread; }
 
-    tracy_force_inline void SetStartCpu( int64_t start, uint8_t cpu ) { assert( start < (int64_t)( 1ull << 47 ) ); _start_cpu = ( uint64_t( start ) << 16 ) | cpu; }
-    tracy_force_inline void SetEndReasonState( int64_t end, int8_t reason, int8_t state ) { assert( end < (int64_t)( 1ull << 47 ) ); _end_reason_state = ( uint64_t( end ) << 16 ) | ( uint64_t( reason ) << 8 ) | uint8_t( state ); }
+    tracy_force_inline void SetStartCpu( int64_t start, uint8_t cpu ) { _start_cpu = ( uint64_t( PackTime( start ) ) << 16 ) | cpu; }
+    tracy_force_inline void SetEndReasonState( int64_t end, int8_t reason, int8_t state ) { _end_reason_state = ( uint64_t( PackTime( end ) ) << 16 ) | ( uint64_t( reason ) << 8 ) | uint8_t( state ); }
 
     uint64_t _start_cpu;
     uint64_t _end_reason_state;
@@ -661,21 +799,28 @@ struct ContextSwitchData
 
 enum { ContextSwitchDataSize = sizeof( ContextSwitchData ) };
 
+// Thread was switched out while still runnable (ETW Ready, Standby, DeferredReady; Linux R).
+static tracy_force_inline bool IsPreemptedState( int8_t state )
+{
+    const auto s = uint8_t( state );
+    return s == 1 || s == 3 || s == 7 || s == 103;
+}
+
 
 struct ContextSwitchCpu
 {
-    tracy_force_inline int64_t Start() const { return int64_t( _start_thread ) >> 16; }
-    tracy_force_inline void SetStart( int64_t start ) { assert( start < (int64_t)( 1ull << 47 ) ); memcpy( ((char*)&_start_thread)+2, &start, 4 ); memcpy( ((char*)&_start_thread)+6, ((char*)&start)+4, 2 ); }
-    tracy_force_inline int64_t End() const { int64_t v; memcpy( &v, ((char*)&_end)-2, 8 ); return v >> 16; }
-    tracy_force_inline void SetEnd( int64_t end ) { assert( end < (int64_t)( 1ull << 47 ) ); _end.SetVal( end ); }
+    tracy_force_inline int64_t Start() const { return UnpackTime( int64_t( _start_thread ) >> 16 ); }
+    tracy_force_inline void SetStart( int64_t start ) { start = PackTime( start ); memcpy( ((char*)&_start_thread)+2, &start, 4 ); memcpy( ((char*)&_start_thread)+6, ((char*)&start)+4, 2 ); }
+    tracy_force_inline int64_t End() const { int64_t v; memcpy( &v, ((char*)&_end)-2, 8 ); return UnpackTime( v >> 16 ); }
+    tracy_force_inline void SetEnd( int64_t end ) { _end.SetVal( end ); }
     tracy_force_inline bool IsEndValid() const { return _end.IsNonNegative(); }
     tracy_force_inline uint16_t Thread() const { return uint16_t( _start_thread ); }
     tracy_force_inline void SetThread( uint16_t thread ) { memcpy( &_start_thread, &thread, 2 ); }
 
-    tracy_force_inline void SetStartThread( int64_t start, uint16_t thread ) { assert( start < (int64_t)( 1ull << 47 ) ); _start_thread = ( uint64_t( start ) << 16 ) | thread; }
+    tracy_force_inline void SetStartThread( int64_t start, uint16_t thread ) { _start_thread = ( uint64_t( PackTime( start ) ) << 16 ) | thread; }
 
 	tracy_force_inline int64_t WakeupVal() const { return _wakeup.Val(); }
-	tracy_force_inline void SetWakeup( int64_t wakeup ) { assert( wakeup < ( int64_t ) ( 1ull << 47 ) ); _wakeup.SetVal( wakeup ); }
+	tracy_force_inline void SetWakeup( int64_t wakeup ) { _wakeup.SetVal( wakeup ); }
 	tracy_force_inline uint8_t WakeupCpu() const { return _wakeupCpu; }
 	tracy_force_inline void SetWakeupCpu( uint8_t wakeupCpu ) { _wakeupCpu = wakeupCpu; }
 
@@ -693,8 +838,8 @@ struct ContextSwitchUsage
     ContextSwitchUsage() {}
     ContextSwitchUsage( int64_t time, uint8_t other, uint8_t own ) { SetTime( time ); SetOther( other ); SetOwn( own ); }
 
-    tracy_force_inline int64_t Time() const { return int64_t( _time_other_own ) >> 16; }
-    tracy_force_inline void SetTime( int64_t time ) { assert( time < (int64_t)( 1ull << 47 ) ); memcpy( ((char*)&_time_other_own)+2, &time, 4 ); memcpy( ((char*)&_time_other_own)+6, ((char*)&time)+4, 2 ); }
+    tracy_force_inline int64_t Time() const { return UnpackTime( int64_t( _time_other_own ) >> 16 ); }
+    tracy_force_inline void SetTime( int64_t time ) { time = PackTime( time ); memcpy( ((char*)&_time_other_own)+2, &time, 4 ); memcpy( ((char*)&_time_other_own)+6, ((char*)&time)+4, 2 ); }
     tracy_force_inline uint8_t Other() const { return uint8_t( _time_other_own ); }
     tracy_force_inline void SetOther( uint8_t other ) { memcpy( &_time_other_own, &other, 1 ); }
     tracy_force_inline uint8_t Own() const { uint8_t v; memcpy( &v, ((char*)&_time_other_own)+1, 1 );return v; }
@@ -770,11 +915,269 @@ enum { ChildSampleSize = sizeof( ChildSample ) };
 #pragma pack( pop )
 
 
+struct ZoneIndexItem
+{
+    short_ptr<ZoneEvent> zone;
+    uint16_t depth;
+};
+
+struct ZoneIndexBlock
+{
+    int64_t end;            // latest end of the closed zones
+    uint32_t open;          // zones not closed yet
+    uint16_t depth;
+};
+
+// Flattened zone tree of a thread in start order. Zones nest, so of the zones
+// starting before a time the ones still open at it are its ancestors, and the
+// last of these is the innermost one. Level 0 blocks cover Base zones, each
+// higher level joins Fanout blocks of the level below and keeps the latest end
+// and the deepest nesting of all zones below it. Zone at time, parent and range
+// depth queries take O(log n) steps regardless of how deep the zones nest.
+struct ZoneIndex
+{
+    enum { Base = 64 };
+    enum { Fanout = 64 };
+    enum { Levels = 4 };
+
+    // Zones are added in start order, open ones must be closed in stack order.
+    void Add( const ZoneEvent* zone, int depth )
+    {
+        const auto idx = uint32_t( items.size() );
+        const auto d = uint16_t( std::min( depth, (int)std::numeric_limits<uint16_t>::max() ) );
+        items.push_back( ZoneIndexItem { zone, d } );
+        const auto isOpen = !zone->IsEndValid();
+        if( isOpen ) openStack.push_back( idx );
+        size_t bsz = Base;
+        for( int l=0; l<Levels; l++, bsz *= Fanout )
+        {
+            auto& lv = level[l];
+            if( idx % bsz == 0 ) lv.push_back( ZoneIndexBlock { -1, 0, 0 } );
+            auto& b = lv.back();
+            if( isOpen ) b.open++;
+            else b.end = std::max( b.end, zone->End() );
+            b.depth = std::max( b.depth, d );
+        }
+    }
+
+    // Picks up the end of the most recently added zone that is still open.
+    void Close()
+    {
+        assert( !openStack.empty() );
+        const auto idx = openStack.back_and_pop();
+        const auto end = items[idx].zone->End();
+        size_t bsz = Base;
+        for( int l=0; l<Levels; l++, bsz *= Fanout )
+        {
+            auto& b = level[l][idx / bsz];
+            assert( b.open != 0 );
+            b.open--;
+            b.end = std::max( b.end, end );
+        }
+    }
+
+    // Innermost zone open at the given time.
+    const ZoneEvent* ZoneAt( int64_t time ) const
+    {
+        const auto idx = Innermost( LastStartingAt( time ), time );
+        return idx < 0 ? nullptr : (const ZoneEvent*)items[idx].zone;
+    }
+
+    // Enclosing zone, nullptr for top level zones and zones of other threads.
+    const ZoneEvent* Parent( const ZoneEvent& zone ) const
+    {
+        const auto start = zone.Start();
+        auto idx = LastStartingAt( start );
+        while( idx >= 0 && items[idx].zone != &zone && items[idx].zone->Start() == start ) idx--;
+        if( idx < 0 || items[idx].zone != &zone ) return nullptr;
+        const auto depth = items[idx].depth;
+        if( depth == 0 ) return nullptr;
+        // Preceding zones which end exactly where this one starts are skipped.
+        for(;;)
+        {
+            idx = Innermost( idx - 1, start );
+            if( idx < 0 ) return nullptr;
+            if( items[idx].depth < depth ) return items[idx].zone;
+        }
+    }
+
+    // Nesting levels of zones ending at or after rangeStart and starting before rangeEnd.
+    int DepthInRange( int64_t rangeStart, int64_t rangeEnd ) const
+    {
+        assert( rangeStart <= rangeEnd );
+        int depth = -1;
+        // Zones starting before the range and reaching into it all overlap just
+        // before rangeStart, so they nest and the last of them is the deepest.
+        const auto idx = Innermost( LastStartingAt( rangeStart - 1 ), rangeStart );
+        if( idx >= 0 ) depth = items[idx].depth;
+        const auto first = LastStartingAt( rangeStart - 1 ) + 1;
+        const auto last = LastStartingAt( rangeEnd - 1 ) + 1;
+        if( first < last ) depth = std::max( depth, MaxDepth( first, last ) );
+        return depth + 1;
+    }
+
+    int64_t LastStartingAt( int64_t time ) const
+    {
+        auto it = std::upper_bound( items.begin(), items.end(), time, [] ( const auto& l, const auto& r ) { return l < r.zone->Start(); } );
+        return int64_t( it - items.begin() ) - 1;
+    }
+
+    // Last zone at or before idx which ends at or after time. Zones before it
+    // which do are its ancestors, or zones ending exactly at time.
+    int64_t Innermost( int64_t idx, int64_t time ) const
+    {
+        if( idx < 0 ) return -1;
+        for( auto i=idx; i>=idx/Base*Base; i-- ) if( End( i ) >= time ) return i;
+        size_t bsz = Base;
+        for( int l=0; l<Levels; l++, bsz *= Fanout )
+        {
+            const auto blk = int64_t( idx / bsz );
+            const auto stop = l+1 < Levels ? blk / Fanout * Fanout : 0;
+            for( auto b=blk-1; b>=stop; b-- )
+            {
+                if( End( level[l][b] ) >= time ) return Descend( l, b, time );
+            }
+        }
+        return -1;
+    }
+
+    Vector<ZoneIndexItem> items;
+    Vector<ZoneIndexBlock> level[Levels];
+    Vector<uint32_t> openStack;
+
+private:
+    int64_t Descend( int l, int64_t blk, int64_t time ) const
+    {
+        while( l > 0 )
+        {
+            l--;
+            const auto first = blk * Fanout;
+            blk = std::min<int64_t>( first + Fanout, level[l].size() ) - 1;
+            while( blk > first && End( level[l][blk] ) < time ) blk--;
+        }
+        const auto first = blk * Base;
+        auto i = std::min<int64_t>( first + Base, items.size() ) - 1;
+        while( i > first && End( i ) < time ) i--;
+        return i;
+    }
+
+    int MaxDepth( int64_t first, int64_t last ) const
+    {
+        int depth = -1;
+        auto i = first;
+        while( i < last )
+        {
+            int l = -1;
+            int64_t bsz = Base;
+            while( l+1 < Levels && i % bsz == 0 && i + bsz <= last )
+            {
+                l++;
+                bsz *= Fanout;
+            }
+            if( l < 0 )
+            {
+                depth = std::max<int>( depth, items[i].depth );
+                i++;
+            }
+            else
+            {
+                bsz /= Fanout;
+                depth = std::max<int>( depth, level[l][i / bsz].depth );
+                i += bsz;
+            }
+        }
+        return depth;
+    }
+
+    tracy_force_inline int64_t End( int64_t idx ) const
+    {
+        const auto& zone = *items[idx].zone;
+        return zone.IsEndValid() ? zone.End() : std::numeric_limits<int64_t>::max();
+    }
+
+    static tracy_force_inline int64_t End( const ZoneIndexBlock& b )
+    {
+        return b.open != 0 ? std::numeric_limits<int64_t>::max() : b.end;
+    }
+};
+
+
+// Bit width of the distance between the ends of consecutive zones of a level,
+// with a max pyramid over blocks of Base zones and Fanout blocks above them.
+// Folding zones smaller than some size can only stop where this distance
+// reaches the size, and these positions are found without visiting the zones
+// in between. Only kept for levels with at least MinZones zones.
+struct ZoneLod
+{
+    enum { Base = 64 };
+    enum { Fanout = 64 };
+    enum { Levels = 4 };
+    enum { MinZones = 1024 };
+
+    // The first zone of a level has no predecessor and is passed a negative distance.
+    void Add( int64_t dist )
+    {
+        const auto idx = gap.size();
+        const auto g = dist < 0 ? std::numeric_limits<uint8_t>::max() : uint8_t( std::bit_width( uint64_t( dist ) ) );
+        gap.push_back( g );
+        size_t bsz = Base;
+        for( int l=0; l<Levels; l++, bsz *= Fanout )
+        {
+            auto& lv = level[l];
+            if( idx % bsz == 0 ) lv.push_back( g );
+            else lv.back() = std::max( lv.back(), g );
+        }
+    }
+
+    size_t size() const { return gap.size(); }
+
+    // First zone at or after idx whose end is at least 2^(bits-1) past the end of the previous zone, or size().
+    size_t Next( size_t idx, uint8_t bits ) const
+    {
+        const auto sz = gap.size();
+        if( idx >= sz ) return sz;
+        const auto blockEnd = std::min<size_t>( ( idx / Base + 1 ) * Base, sz );
+        for( auto i=idx; i<blockEnd; i++ ) if( gap[i] >= bits ) return i;
+        size_t bsz = Base;
+        for( int l=0; l<Levels; l++, bsz *= Fanout )
+        {
+            const auto& lv = level[l];
+            const auto blk = idx / bsz;
+            const auto stop = l+1 < Levels ? std::min<size_t>( ( blk / Fanout + 1 ) * Fanout, lv.size() ) : lv.size();
+            for( auto b=blk+1; b<stop; b++ )
+            {
+                if( lv[b] >= bits ) return Descend( l, b, bits );
+            }
+        }
+        return sz;
+    }
+
+    Vector<uint8_t> gap;
+    Vector<uint8_t> level[Levels];
+
+private:
+    size_t Descend( int l, size_t blk, uint8_t bits ) const
+    {
+        while( l > 0 )
+        {
+            l--;
+            blk *= Fanout;
+            const auto last = std::min<size_t>( blk + Fanout, level[l].size() ) - 1;
+            while( blk < last && level[l][blk] < bits ) blk++;
+        }
+        auto i = blk * Base;
+        const auto last = std::min<size_t>( i + Base, gap.size() ) - 1;
+        while( i < last && gap[i] < bits ) i++;
+        return i;
+    }
+};
+
 struct ThreadData
 {
     uint64_t id;
     uint64_t count;
     Vector<short_ptr<ZoneEvent>> timeline;
+    ZoneLod timelineLod;
     Vector<short_ptr<ZoneEvent>> stack;
     Vector<short_ptr<MessageData>> messages;
     uint32_t nextZoneId;
@@ -783,6 +1186,7 @@ struct ThreadData
     Vector<int64_t> childTimeStack;
     Vector<GhostZone> ghostZones;
     uint64_t ghostIdx;
+    ZoneIndex zoneIndex;
     SortedVector<SampleData, SampleDataSort> postponedSamples;
 #endif
     Vector<SampleData> samples;
@@ -837,7 +1241,8 @@ enum class PlotType : uint8_t
     Memory,
     SysTime,
     Power,
-    Zone
+    Zone,
+    Histogram
 };
 
 // Keep this in sync with enum in TracyC.h
@@ -875,10 +1280,134 @@ struct ZonePlotDef
     bool aggregatePerFrame;
 };
 
+struct PlotLodBlock
+{
+    uint32_t min;
+    uint32_t max;
+};
+
+// Pyramid of min/max value indices over blocks of sorted plot points. Level 0
+// blocks hold Base points, each higher level joins Fanout blocks of the level
+// below, so the extremes of any point range are found in O(log n) steps.
+struct PlotLod
+{
+    enum { Base = 64 };
+    enum { Fanout = 8 };
+    enum { Levels = 8 };
+
+    // Extends the pyramid with all complete blocks within the first cnt points.
+    void Update( const PlotItem* data, size_t cnt )
+    {
+        size_t bsz = Base;
+        for( int l=0; l<Levels; l++, bsz *= Fanout )
+        {
+            auto& lv = level[l];
+            while( ( lv.size() + 1 ) * bsz <= cnt ) lv.push_back( Build( data, l, lv.size() ) );
+        }
+    }
+
+    // Recomputes the blocks holding point idx after its value has changed.
+    void Refresh( const PlotItem* data, size_t idx )
+    {
+        size_t bsz = Base;
+        for( int l=0; l<Levels; l++, bsz *= Fanout )
+        {
+            const auto b = idx / bsz;
+            if( b >= level[l].size() ) return;
+            level[l][b] = Build( data, l, b );
+        }
+    }
+
+    // Drops blocks that reach past the first cnt points.
+    void Truncate( size_t cnt )
+    {
+        size_t bsz = Base;
+        for( int l=0; l<Levels; l++, bsz *= Fanout )
+        {
+            auto& lv = level[l];
+            const auto keep = cnt / bsz;
+            if( lv.size() > keep ) lv.erase( lv.begin() + keep, lv.end() );
+        }
+    }
+
+    // Finds the smallest and largest value in points [first, last), which may extend past the pyramid.
+    void MinMax( const PlotItem* data, uint32_t first, uint32_t last, uint32_t& imin, uint32_t& imax ) const
+    {
+        assert( first < last );
+        PlotLodBlock b = { first, first };
+        auto i = first;
+        while( i < last )
+        {
+            int l = -1;
+            size_t bsz = Base;
+            while( l+1 < Levels && i % bsz == 0 && i + bsz <= last && i / bsz < level[l+1].size() )
+            {
+                l++;
+                bsz *= Fanout;
+            }
+            if( l < 0 )
+            {
+                Merge( data, b, i, i );
+                i++;
+            }
+            else
+            {
+                bsz /= Fanout;
+                const auto& lb = level[l][i / bsz];
+                Merge( data, b, lb.min, lb.max );
+                i += uint32_t( bsz );
+            }
+        }
+        imin = b.min;
+        imax = b.max;
+    }
+
+    PlotLodBlock Build( const PlotItem* data, int l, size_t idx ) const
+    {
+        PlotLodBlock b;
+        if( l == 0 )
+        {
+            const auto first = uint32_t( idx * Base );
+            b = { first, first };
+            for( uint32_t i=first+1; i<first+Base; i++ ) Merge( data, b, i, i );
+        }
+        else
+        {
+            auto src = level[l-1].data() + idx * Fanout;
+            b = src[0];
+            for( int i=1; i<Fanout; i++ ) Merge( data, b, src[i].min, src[i].max );
+        }
+        return b;
+    }
+
+    static tracy_force_inline void Merge( const PlotItem* data, PlotLodBlock& b, uint32_t imin, uint32_t imax )
+    {
+        if( data[imin].val < data[b.min].val ) b.min = imin;
+        if( data[imax].val > data[b.max].val ) b.max = imax;
+    }
+
+    Vector<PlotLodBlock> level[Levels];
+};
+
 struct PlotData
 {
     struct PlotItemSort { bool operator()( const PlotItem& lhs, const PlotItem& rhs ) { return lhs.time.Val() < rhs.time.Val(); }; };
 
+    // Extends the pyramid over points appended in order.
+    void UpdateLod() { lod.Update( data.data(), data.size() ); }
+
+    // Sorts out of order points and rebuilds the part of the pyramid they land in.
+    void EnsureSorted()
+    {
+        if( data.is_sorted() ) return;
+        auto minTime = data.unsorted_begin()->time.Val();
+        for( auto it = data.unsorted_begin() + 1; it != data.end(); ++it ) minTime = std::min( minTime, it->time.Val() );
+        data.sort();
+        const auto it = std::lower_bound( data.begin(), data.end(), minTime, [] ( const auto& l, const auto& r ) { return l.time.Val() < r; } );
+        lod.Truncate( it - data.begin() );
+        UpdateLod();
+    }
+
     StringRef name;
     double min;
     double max;
@@ -891,14 +1420,294 @@ struct PlotData
     uint32_t color;
 
     double rMin, rMax, num;
+    PlotLod lod;
     PlotData *nextPlot = nullptr; // Linked list of plots to draw on same chart
     ZonePlotDef *zonePlotDef = nullptr;
 };
 
+// Packed, so that bins are written to the trace file without padding.
+#pragma pack( push, 1 )
+struct HistogramBin
+{
+    uint16_t idx;
+    uint32_t count;
+};
+#pragma pack( pop )
+
+// Values recorded by all threads in one client flush window.
+struct HistogramSnapshot
+{
+    int64_t time;
+    int64_t min;
+    int64_t max;
+    double sum;
+    uint64_t count;
+    uint32_t binStart;
+    uint16_t binCount;
+};
+
+struct HistogramData
+{
+    // p50, p90, p99 and max plots, chained through nextPlot.
+    enum { NumPlots = 4 };
+
+    uint64_t name;
+    Vector<HistogramSnapshot> snapshots;
+    Vector<HistogramBin> bins;
+    PlotData* plot;
+
+    // Window still receiving data from other threads, kept dense until closed.
+    bool open;
+    HistogramSnapshot pending;
+    uint32_t pendingBins[HistogramBuckets];
+};
+
+// Log-linear histogram of durations, for percentiles within about 3% of the
+// exact value without sorting. Only the bucket range seen so far is stored.
+struct DurationSketch
+{
+    enum { SubBits = 5 };
+    enum { NumPercentiles = 4 };
+    static constexpr double PercentileLevels[NumPercentiles] = { 0.5, 0.9, 0.99, 0.999 };
+
+    void Add( int64_t val )
+    {
+        const auto b = HistogramBucket<SubBits>( uint64_t( std::max<int64_t>( val, 0 ) ) );
+        if( counts.empty() )
+        {
+            first = uint16_t( b );
+            counts.push_back( 0 );
+        }
+        else if( b < first )
+        {
+            const auto n = first - b;
+            const auto sz = counts.size();
+            for( int i=0; i<n; i++ ) counts.push_back( 0 );
+            memmove( counts.data() + n, counts.data(), sz * sizeof( uint32_t ) );
+            memset( counts.data(), 0, n * sizeof( uint32_t ) );
+            first = uint16_t( b );
+        }
+        else
+        {
+            while( counts.size() <= size_t( b - first ) ) counts.push_back( 0 );
+        }
+        counts[b - first]++;
+        total++;
+    }
+
+    // Fills out[i] with the q[i] quantile, q must be ascending. Values are bucket midpoints.
+    void Quantiles( const double* q, int64_t* out, int num ) const
+    {
+        assert( total != 0 );
+        uint64_t acc = 0;
+        int i = 0;
+        for( size_t b=0; b<counts.size() && i<num; b++ )
+        {
+            acc += counts[b];
+            while( i < num && acc > uint64_t( q[i] * ( total - 1 ) ) )
+            {
+                const auto lo = HistogramBucketValue<SubBits>( int( first + b ) );
+                const auto hi = HistogramBucketValue<SubBits>( int( first + b + 1 ) );
+                out[i++] = int64_t( lo + ( hi - lo ) / 2 );
+            }
+        }
+    }
+
+    // Quantiles at PercentileLevels, only recomputed when durations were added since the last call.
+    const int64_t* Percentiles()
+    {
+        assert( total != 0 );
+        if( percentilesTotal != total )
+        {
+            Quantiles( PercentileLevels, percentiles, NumPercentiles );
+            percentilesTotal = total;
+        }
+        return percentiles;
+    }
+
+    uint64_t total = 0;
+    uint16_t first = 0;
+    Vector<uint32_t> counts;
+    int64_t percentiles[NumPercentiles] = {};
+    uint64_t percentilesTotal = 0;
+};
+
+// Pyramid of the latest free time over blocks of allocations, with live
+// allocations counting as never freed. Allocations made in a range and still
+// live at its end are found by descending only into blocks which reach past
+// the end. A free only marks its blocks as stale, they are recomputed when a
+// query gets to them.
+struct MemFreeIndex
+{
+    enum { Base = 64 };
+    enum { Fanout = 8 };
+    enum { Levels = 8 };
+
+    struct Block
+    {
+        int64_t maxFree;
+        bool stale;
+    };
+
+    static tracy_force_inline int64_t FreeTime( const MemEvent& ev )
+    {
+        const auto tf = ev.TimeFree();
+        return tf < 0 ? std::numeric_limits<int64_t>::max() : tf;
+    }
+
+    // Extends the pyramid with all complete blocks within the first cnt allocations.
+    void Update( const MemEvent* data, size_t cnt )
+    {
+        size_t bsz = Base;
+        for( int l=0; l<Levels; l++, bsz *= Fanout )
+        {
+            auto& lv = level[l];
+            const auto sz = lv.size();
+            while( ( lv.size() + 1 ) * bsz <= cnt )
+            {
+                Block b = { std::numeric_limits<int64_t>::min(), false };
+                if( l == 0 )
+                {
+                    auto ev = data + lv.size() * Base;
+                    for( int i=0; i<Base; i++ ) b.maxFree = std::max( b.maxFree, FreeTime( ev[i] ) );
+                }
+                else
+                {
+                    auto src = level[l-1].data() + lv.size() * Fanout;
+                    for( int i=0; i<Fanout; i++ )
+                    {
+                        b.maxFree = std::max( b.maxFree, src[i].maxFree );
+                        b.stale |= src[i].stale;
+                    }
+                }
+                lv.push_back( b );
+            }
+            // Higher levels can only grow when this one did.
+            if( lv.size() == sz ) break;
+        }
+    }
+
+    void Freed( size_t idx )
+    {
+        for( int l=0; l<Levels; l++ )
+        {
+            idx /= l == 0 ? size_t( Base ) : size_t( Fanout );
+            if( idx >= level[l].size() || level[l][idx].stale ) break;
+            level[l][idx].stale = true;
+        }
+    }
+
+    // Calls fn for each allocation in [first, last) which is live at the given time.
+    template<class T>
+    void Live( const MemEvent* data, size_t first, size_t last, int64_t time, T fn ) const
+    {
+        auto i = first;
+        while( i < last )
+        {
+            int l = -1;
+            size_t bsz = Base;
+            while( l+1 < Levels && i % bsz == 0 && i + bsz <= last && i / bsz < level[l+1].size() )
+            {
+                l++;
+                bsz *= Fanout;
+            }
+            if( l < 0 )
+            {
+                if( FreeTime( data[i] ) >= time ) fn( data[i] );
+                i++;
+            }
+            else
+            {
+                bsz /= Fanout;
+                Visit( data, l, i / bsz, time, fn );
+                i += bsz;
+            }
+        }
+    }
+
+private:
+    template<class T>
+    void Visit( const MemEvent* data, int l, size_t idx, int64_t time, T& fn ) const
+    {
+        if( level[l][idx].maxFree < time ) return;
+        Refresh( data, l, idx );
+        if( level[l][idx].maxFree < time ) return;
+        if( l == 0 )
+        {
+            auto ev = data + idx * Base;
+            for( int i=0; i<Base; i++ ) if( FreeTime( ev[i] ) >= time ) fn( ev[i] );
+        }
+        else
+        {
+            for( int i=0; i<Fanout; i++ ) Visit( data, l-1, idx * Fanout + i, time, fn );
+        }
+    }
+
+    void Refresh( const MemEvent* data, int l, size_t idx ) const
+    {
+        auto& b = level[l][idx];
+        if( !b.stale ) return;
+        b.maxFree = std::numeric_limits<int64_t>::min();
+        if( l == 0 )
+        {
+            auto ev = data + idx * Base;
+            for( int i=0; i<Base; i++ ) b.maxFree = std::max( b.maxFree, FreeTime( ev[i] ) );
+        }
+        else
+        {
+            for( int i=0; i<Fanout; i++ )
+            {
+                Refresh( data, l-1, idx * Fanout + i );
+                b.maxFree = std::max( b.maxFree, level[l-1][idx * Fanout + i].maxFree );
+            }
+        }
+        b.stale = false;
+    }
+
+    // Stale blocks are fixed up by const queries.
+    mutable Vector<Block> level[Levels];
+};
+
+struct MemCallstackStats
+{
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t bytes;
+    uint64_t liveBytes;
+};
+
 struct MemData
 {
+    // Running totals per allocation callstack, for the memory call trees of the whole capture.
+    void CountAlloc( const MemEvent& ev )
+    {
+        if( ev.CsAlloc() == 0 ) return;
+        auto& cs = callstacks.emplace( ev.CsAlloc(), MemCallstackStats {} ).first->second;
+        cs.allocs++;
+        cs.bytes += ev.Size();
+        if( ev.TimeFree() < 0 )
+        {
+            cs.liveBytes += ev.Size();
+        }
+        else
+        {
+            cs.frees++;
+        }
+    }
+
+    void CountFree( const MemEvent& ev )
+    {
+        if( ev.CsAlloc() == 0 ) return;
+        auto it = callstacks.find( ev.CsAlloc() );
+        assert( it != callstacks.end() );
+        it->second.frees++;
+        it->second.liveBytes -= ev.Size();
+    }
+
     Vector<MemEvent> data;
     Vector<uint32_t> frees;
+    MemFreeIndex freeIndex;
+    unordered_flat_map<uint32_t, MemCallstackStats> callstacks;
     unordered_flat_map<uint64_t, size_t> active;
     uint64_t high = std::numeric_limits<uint64_t>::min();
     uint64_t low = std::numeric_limits<uint64_t>::max();
@@ -1,8 +1,157 @@
+#include <stdlib.h>
+
 #include "TracyMemory.hpp"
 
+#if defined TRACY_LARGE_RESERVE || defined TRACY_HUGE_PAGES
+#  ifdef _WIN32
+#    include <windows.h>
+#  else
+#    include <sys/mman.h>
+#  endif
+#  include <mutex>
+#  include <unordered_map>
+#endif
+
 namespace tracy
 {
 
 std::atomic<int64_t> memUsage( 0 );
 
+#if defined TRACY_LARGE_RESERVE || defined TRACY_HUGE_PAGES
+// Sizes of the mappings handed out below. The registries are function local, so that slabs and
+// vectors constructed during static initialization find them ready.
+struct BlockRegistry
+{
+    std::mutex lock;
+    std::unordered_map<const void*, size_t> size;
+};
+#endif
+
+#ifdef TRACY_HUGE_PAGES
+enum { HugePageSize = 2 * 1024 * 1024 };
+
+static BlockRegistry& GetHugeBlocks()
+{
+    static BlockRegistry registry;
+    return registry;
+}
+
+static void* AllocHuge( size_t size )
+{
+    auto ptr = mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+    if( ptr != MAP_FAILED ) return ptr;
+
+    // There is no pool of explicit huge pages. Transparent huge pages need 2 MB aligned memory,
+    // so a larger range is mapped and trimmed to the aligned block.
+    auto raw = (char*)mmap( nullptr, size + HugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if( raw == MAP_FAILED ) return nullptr;
+    auto aligned = (char*)( ( uintptr_t( raw ) + HugePageSize - 1 ) & ~uintptr_t( HugePageSize - 1 ) );
+    if( aligned != raw ) munmap( raw, aligned - raw );
+    if( aligned != raw + HugePageSize ) munmap( aligned + size, raw + HugePageSize - aligned );
+    madvise( aligned, size, MADV_HUGEPAGE );
+    return aligned;
+}
+#endif
+
+void* AllocLarge( size_t size )
+{
+#ifdef TRACY_HUGE_PAGES
+    if( size >= HugePageSize )
+    {
+        size = ( size + HugePageSize - 1 ) & ~size_t( HugePageSize - 1 );
+        if( auto ptr = AllocHuge( size ) )
+        {
+            auto& blocks = GetHugeBlocks();
+            std::lock_guard<std::mutex> lock( blocks.lock );
+            blocks.size.emplace( ptr, size );
+            return ptr;
+        }
+    }
+#endif
+    return malloc( size );
+}
+
+void FreeLarge( void* ptr )
+{
+#ifdef TRACY_HUGE_PAGES
+    size_t size = 0;
+    {
+        auto& blocks = GetHugeBlocks();
+        std::lock_guard<std::mutex> lock( blocks.lock );
+        auto it = blocks.size.find( ptr );
+        if( it != blocks.size.end() )
+        {
+            size = it->second;
+            blocks.size.erase( it );
+        }
+    }
+    if( size != 0 )
+    {
+        munmap( ptr, size );
+        return;
+    }
+#endif
+    free( ptr );
+}
+
+#ifdef TRACY_LARGE_RESERVE
+static BlockRegistry& GetLargeBlocks()
+{
+    static BlockRegistry registry;
+    return registry;
+}
+
+void* ReserveLarge( size_t size )
+{
+#ifdef _WIN32
+    auto ptr = VirtualAlloc( nullptr, size, MEM_RESERVE, PAGE_NOACCESS );
+    if( !ptr ) return nullptr;
+#else
+    auto ptr = mmap( nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+    if( ptr == MAP_FAILED ) return nullptr;
+#  ifdef TRACY_HUGE_PAGES
+    madvise( ptr, size, MADV_HUGEPAGE );
+#  endif
+#endif
+    auto& blocks = GetLargeBlocks();
+    std::lock_guard<std::mutex> lock( blocks.lock );
+    blocks.size.emplace( ptr, size );
+    return ptr;
+}
+
+bool CommitLarge( void* ptr, size_t size )
+{
+#ifdef _WIN32
+    return VirtualAlloc( ptr, size, MEM_COMMIT, PAGE_READWRITE ) != nullptr;
+#else
+    return mprotect( ptr, size, PROT_READ | PROT_WRITE ) == 0;
+#endif
+}
+
+void ReleaseLarge( void* ptr )
+{
+    size_t size;
+    {
+        auto& blocks = GetLargeBlocks();
+        std::lock_guard<std::mutex> lock( blocks.lock );
+        auto it = blocks.size.find( ptr );
+        size = it->second;
+        blocks.size.erase( it );
+    }
+#ifdef _WIN32
+    VirtualFree( ptr, 0, MEM_RELEASE );
+#else
+    munmap( ptr, size );
+#endif
+}
+
+size_t GetLargeSize( const void* ptr )
+{
+    auto& blocks = GetLargeBlocks();
+    std::lock_guard<std::mutex> lock( blocks.lock );
+    auto it = blocks.size.find( ptr );
+    return it == blocks.size.end() ? 0 : it->second;
+}
+#endif
+
 }
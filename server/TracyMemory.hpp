@@ -2,13 +2,40 @@
 #define __TRACYMEMORY_HPP__
 
 #include <atomic>
+#include <stddef.h>
 #include <stdint.h>
 
+#if !defined __EMSCRIPTEN__ && UINTPTR_MAX > 0xFFFFFFFF
+#  define TRACY_LARGE_RESERVE
+#endif
+
+#if defined TRACY_HUGE_PAGES && !defined __linux__
+#  undef TRACY_HUGE_PAGES
+#endif
+
 namespace tracy
 {
 
 extern std::atomic<int64_t> memUsage;
 
+// Large, long-lived blocks, such as slab blocks. With TRACY_HUGE_PAGES, blocks of 2 MB and more
+// are backed by explicit huge pages if the system has a pool of them, and by transparent huge
+// pages otherwise, which reduces TLB misses when walking huge timelines. Reserved vector ranges
+// are then advised to use transparent huge pages as well.
+void* AllocLarge( size_t size );
+void FreeLarge( void* ptr );
+
+#ifdef TRACY_LARGE_RESERVE
+// Address space reservations for vectors that are too large to be reallocated. Pages of the
+// range are committed in place as the vector grows, so its contents don't have to move until
+// the range is full. ReserveLarge() returns nullptr and CommitLarge() returns false on failure.
+// GetLargeSize() returns the size of the reservation starting at ptr, or 0 for other memory.
+void* ReserveLarge( size_t size );
+bool CommitLarge( void* ptr, size_t size );
+void ReleaseLarge( void* ptr );
+size_t GetLargeSize( const void* ptr );
+#endif
+
 }
 
 #endif
@@ -16,7 +16,7 @@ class Slab
 {
 public:
     Slab()
-        : m_ptr( new char[BlockSize] )
+        : m_ptr( (char*)AllocLarge( BlockSize ) )
         , m_offset( 0 )
         , m_buffer( { m_ptr } )
         , m_usage( BlockSize )
@@ -29,7 +29,7 @@ public:
         memUsage.fetch_sub( m_usage, std::memory_order_relaxed );
         for( auto& v : m_buffer )
         {
-            delete[] v;
+            FreeLarge( v );
         }
     }
 
@@ -107,7 +107,7 @@ public:
         {
             memUsage.fetch_add( size, std::memory_order_relaxed );
             m_usage += size;
-            auto ret = new char[size];
+            auto ret = (char*)AllocLarge( size );
             m_buffer.emplace_back( ret );
             return ret;
         }
@@ -121,7 +121,7 @@ public:
             m_usage = BlockSize;
             for( int i=1; i<m_buffer.size(); i++ )
             {
-                delete[] m_buffer[i];
+                FreeLarge( m_buffer[i] );
             }
             m_ptr = m_buffer[0];
             m_buffer.clear();
@@ -139,7 +139,7 @@ public:
 private:
     void* DoAlloc( uint32_t willUseBytes )
     {
-        auto ptr = new char[BlockSize];
+        auto ptr = (char*)AllocLarge( BlockSize );
         m_ptr = ptr;
         m_offset = willUseBytes;
         m_buffer.emplace_back( m_ptr );
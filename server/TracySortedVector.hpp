@@ -49,6 +49,7 @@ public:
     tracy_force_inline bool empty() const { return v.empty(); }
     tracy_force_inline size_t size() const { return v.size(); }
     tracy_force_inline bool is_sorted() const { return sortedEnd == 0; }
+    tracy_force_inline const T* unsorted_begin() const { return is_sorted() ? v.end() : v.begin() + sortedEnd; }
 
     tracy_force_inline T* data() { return v.data(); }
     tracy_force_inline const T* data() const { return v.data(); };
@@ -85,6 +86,12 @@ public:
 
     tracy_force_inline void clear() { v.clear(); sortedEnd = 0; }
 
+    tracy_force_inline T* insert( T* it, const T& val )
+    {
+        assert( is_sorted() );
+        return v.insert( it, val );
+    }
+
     tracy_force_inline T* erase( T* begin, T* end )
     {
         assert( is_sorted() );
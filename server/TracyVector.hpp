@@ -3,6 +3,7 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <bit>
 #include <limits>
 #include <stdint.h>
 #include <stdlib.h>
@@ -25,6 +26,15 @@ class Vector
 {
     constexpr uint8_t MaxCapacity() { return 0x7F; }
 
+#ifdef TRACY_LARGE_RESERVE
+    // Trivially copyable vectors of 16 MB and more are moved to an address range reserved for
+    // 2^ArenaGrowth times their capacity. Further growth commits the next power of two chunk of
+    // the range in place, which keeps the contents where they are. Only a full range moves them.
+    static constexpr uint8_t ArenaCapacity() { return std::is_trivially_copyable<T>() ? 25 - std::bit_width( sizeof( T ) ) : 0x7F; }
+    static constexpr uint8_t ArenaGrowth = 4;
+    static constexpr size_t ArenaMaxSize = sizeof( T ) << 31;
+#endif
+
 public:
     using iterator = T*;
     using const_iterator = const T*;
@@ -56,7 +66,7 @@ public:
         if( m_capacity != MaxCapacity() && m_ptr )
         {
             memUsage.fetch_sub( Capacity() * sizeof( T ), std::memory_order_relaxed );
-            free( m_ptr );
+            Free();
         }
     }
 
@@ -66,7 +76,7 @@ public:
         if( m_capacity != MaxCapacity() && m_ptr )
         {
             memUsage.fetch_sub( Capacity() * sizeof( T ), std::memory_order_relaxed );
-            free( m_ptr );
+            Free();
         }
         memcpy( (char*)this, &src, sizeof( Vector<T> ) );
         memset( (char*)&src, 0, sizeof( Vector<T> ) );
@@ -255,8 +265,9 @@ public:
         cap |= cap >> 16;
         cap = TracyCountBits( cap );
         memUsage.fetch_add( ( ( 1 << cap ) - Capacity() ) * sizeof( T ), std::memory_order_relaxed );
+        const auto prevCapacity = m_capacity;
         m_capacity = cap;
-        Realloc();
+        Realloc( prevCapacity );
     }
 
     tracy_force_inline void reserve_and_use( size_t sz )
@@ -299,29 +310,87 @@ private:
         {
             memUsage.fetch_add( Capacity() * sizeof( T ), std::memory_order_relaxed );
             m_capacity++;
-            Realloc();
+            Realloc( m_capacity - 1 );
         }
     }
 
-    void Realloc()
+    void Realloc( uint8_t prevCapacity )
     {
+        if constexpr( std::is_trivially_copyable<T>() )
+        {
+            const auto size = sizeof( T ) * CapacityNoNullptrCheck();
+#ifdef TRACY_LARGE_RESERVE
+            if( m_capacity >= ArenaCapacity() && ReallocLarge( prevCapacity, size ) ) return;
+#endif
+
+            // Large blocks can be grown in place or by remapping their pages,
+            // which avoids copying giant timelines and the doubled peak memory use.
+            m_ptr = (T*)realloc( m_ptr, size );
+            return;
+        }
+
         T* ptr = (T*)malloc( sizeof( T ) * CapacityNoNullptrCheck() );
         if( m_size != 0 )
         {
-            if( std::is_trivially_copyable<T>() )
+            for( uint32_t i=0; i<m_size; i++ )
             {
-                memcpy( (char*)ptr, m_ptr, m_size * sizeof( T ) );
+                new(ptr+i) T( std::move( m_ptr[i] ) );
             }
-            else
+            free( m_ptr );
+        }
+        m_ptr = ptr;
+    }
+
+#ifdef TRACY_LARGE_RESERVE
+    // Returns false if the vector is left in heap memory and should be grown with realloc. When
+    // address space or memory runs out, a vector in a reserved range is moved back to the heap.
+    bool ReallocLarge( uint8_t prevCapacity, size_t size )
+    {
+        const auto reserved = m_ptr && prevCapacity >= ArenaCapacity() ? GetLargeSize( m_ptr ) : 0;
+        if( reserved >= size )
+        {
+            const auto prevSize = sizeof( T ) << prevCapacity;
+            if( CommitLarge( (char*)(T*)m_ptr + prevSize, size - prevSize ) ) return true;
+        }
+        else
+        {
+            auto ptr = (T*)ReserveLarge( std::min( size << ArenaGrowth, ArenaMaxSize ) );
+            if( ptr )
             {
-                for( uint32_t i=0; i<m_size; i++ )
+                if( CommitLarge( ptr, size ) )
                 {
-                    new(ptr+i) T( std::move( m_ptr[i] ) );
+                    if( m_ptr )
+                    {
+                        memcpy( (char*)ptr, m_ptr, m_size * sizeof( T ) );
+                        if( reserved != 0 ) ReleaseLarge( m_ptr );
+                        else free( m_ptr );
+                    }
+                    m_ptr = ptr;
+                    return true;
                 }
+                ReleaseLarge( ptr );
             }
-            free( m_ptr );
         }
+        if( reserved == 0 ) return false;
+
+        auto ptr = (T*)malloc( size );
+        memcpy( (char*)ptr, m_ptr, m_size * sizeof( T ) );
+        ReleaseLarge( m_ptr );
         m_ptr = ptr;
+        return true;
+    }
+#endif
+
+    void Free()
+    {
+#ifdef TRACY_LARGE_RESERVE
+        if( m_capacity >= ArenaCapacity() && GetLargeSize( m_ptr ) != 0 )
+        {
+            ReleaseLarge( m_ptr );
+            return;
+        }
+#endif
+        free( m_ptr );
     }
 
     tracy_force_inline uint32_t Capacity() const
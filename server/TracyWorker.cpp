@@ -34,6 +34,7 @@
 #include "../public/common/TracyVersion.hpp"
 #include "TracyFileRead.hpp"
 #include "TracyFileWrite.hpp"
+#include "TracyPopcnt.hpp"
 #include "TracyPrint.hpp"
 #include "TracySort.hpp"
 #include "TracyTaskDispatch.hpp"
@@ -229,6 +230,109 @@ static inline void UpdateLockCount( LockMap& lockmap, size_t pos )
     lockmap.isMultiThread = ( lockmap.threadList.size() > 1 );
 }
 
+static tracy_force_inline int GetLockHistogramBucket( int64_t time )
+{
+    const auto bucket = time <= 1 ? 0 : 63 - TracyLzcnt( (uint64_t)time );
+    return std::min<int>( bucket, LockStats::WaitHistogramSize - 1 );
+}
+
+static void UpdateLockStats( LockMap& lockmap, size_t pos )
+{
+    auto& stats = lockmap.stats;
+    auto& tl = lockmap.timeline[pos];
+    const auto tbit = tl.ptr->thread;
+    const auto time = tl.ptr->Time();
+    if( stats.threads.size() <= tbit ) stats.threads.resize( tbit + 1 );
+    auto& ts = stats.threads[tbit];
+
+    switch( (LockEvent::Type)tl.ptr->type )
+    {
+    case LockEvent::Type::Wait:
+    case LockEvent::Type::WaitShared:
+        ts.waitStart = time;
+        ts.contended = false;
+        if( pos != 0 )
+        {
+            // Contended if someone else held the lock when the wait started.
+            const auto& prev = lockmap.timeline[pos-1];
+            if( prev.lockCount != 0 && prev.lockingThread != tbit )
+            {
+                ts.contended = true;
+            }
+            else if( lockmap.type == LockType::SharedLockable && tl.ptr->type == LockEvent::Type::Wait )
+            {
+                auto sharedList = ((const LockEventShared*)prev.ptr.get())->sharedList;
+                sharedList.Reset( tbit );
+                ts.contended = sharedList.Any();
+            }
+        }
+        break;
+    case LockEvent::Type::Obtain:
+    case LockEvent::Type::ObtainShared:
+    {
+        stats.obtainCount++;
+        const auto wait = ts.waitStart >= 0 ? time - ts.waitStart : 0;
+        ts.waitStart = -1;
+        if( ts.contended )
+        {
+            stats.contendedCount++;
+            stats.waitTotal += wait;
+            if( stats.waitMax < wait ) stats.waitMax = wait;
+            stats.waitHistogram[GetLockHistogramBucket( wait )]++;
+        }
+        if( ts.depth++ == 0 )
+        {
+            ts.holdStart = time;
+            ts.wait = ts.contended ? wait : 0;
+            ts.obtain = tl.ptr;
+        }
+        else if( ts.contended )
+        {
+            ts.wait += wait;
+        }
+        ts.contended = false;
+        break;
+    }
+    case LockEvent::Type::Release:
+    case LockEvent::Type::ReleaseShared:
+        if( ts.depth != 0 && --ts.depth == 0 )
+        {
+            const auto hold = time - ts.holdStart;
+            stats.holdTotal += hold;
+            if( stats.holdMax < hold ) stats.holdMax = hold;
+            stats.holdHistogram[GetLockHistogramBucket( hold )]++;
+
+            // Lock marks are applied after the obtain event is inserted, so the
+            // call site is only known once the lock is released.
+            auto& sl = stats.srcloc[ts.obtain->SrcLoc()];
+            sl.count++;
+            if( ts.wait != 0 ) sl.contended++;
+            sl.waitTotal += ts.wait;
+            if( sl.waitMax < ts.wait ) sl.waitMax = ts.wait;
+            sl.holdTotal += hold;
+            ts.holdStart = -1;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void ApplyLockAggregate( LockStats& stats )
+{
+    const auto& agg = stats.aggregated;
+    stats.obtainCount += agg.waitCount;
+    stats.waitTotal += agg.waitTotal;
+    if( stats.waitMax < agg.waitMax ) stats.waitMax = agg.waitMax;
+    stats.holdTotal += agg.holdTotal;
+    if( stats.holdMax < agg.holdMax ) stats.holdMax = agg.holdMax;
+    for( int i=0; i<LockStats::WaitHistogramSize; i++ )
+    {
+        stats.waitHistogram[i] += agg.waitHistogram[i];
+        stats.holdHistogram[i] += agg.holdHistogram[i];
+    }
+}
+
 static tracy_force_inline void WriteTimeOffset( FileWrite& f, int64_t& refTime, int64_t time )
 {
     int64_t timeOffset = time - refTime;
@@ -273,6 +377,26 @@ static bool IsQueryPrio( ServerQuery type )
     return type < ServerQuery::ServerQueryDisconnect;
 }
 
+// Queries which only need the ptr field.
+static bool IsQueryBatchable( ServerQuery type )
+{
+    switch( type )
+    {
+    case ServerQueryString:
+    case ServerQueryThreadString:
+    case ServerQuerySourceLocation:
+    case ServerQueryPlotName:
+    case ServerQueryFrameName:
+    case ServerQueryFiberName:
+    case ServerQueryExternalName:
+    case ServerQueryCallstackFrame:
+    case ServerQuerySymbol:
+        return true;
+    default:
+        return false;
+    }
+}
+
 
 LoadProgress Worker::s_loadProgress;
 
@@ -282,7 +406,7 @@ Worker::Worker( const char* addr, uint16_t port, int64_t memoryLimit,bool keepSi
     , m_keepSingleThreadLocks(keepSingleThreadLocks)
     , m_hasData( false )
     , m_stream( LZ4_createStreamDecode() )
-    , m_buffer( new char[TargetFrameSize*3 + 1] )
+    , m_buffer( new char[TargetFrameSize*( NetBufferDepth + 1 ) + 1] )
     , m_bufferOffset( 0 )
     , m_inconsistentSamples( false )
     , m_pendingStrings( 0 )
@@ -316,6 +440,10 @@ Worker::Worker( const char* addr, uint16_t port, int64_t memoryLimit,bool keepSi
     m_data.ghostZonesReady = true;
     m_data.ctxUsageReady = true;
     m_data.symbolSamplesReady = true;
+
+    // Exec and the network thread are busy during a capture, and Exec also applies shards while it waits.
+    const auto statsWorkers = std::clamp<int>( std::thread::hardware_concurrency() - 3, 0, ZoneStatsShards - 1 );
+    m_zoneStatsDispatch = std::make_unique<TaskDispatch>( statsWorkers, "Zone stats" );
 #endif
 
     m_thread = std::thread( [this] { SetThreadName( "Tracy Worker" ); Exec(); } );
@@ -429,11 +557,14 @@ Worker::Worker( const char* name, const char* program, const std::vector<ImportE
             auto zone = stack.back_and_pop();
             td->DecStackCount( zone->SrcLoc() );
             zone->SetEnd( v.timestamp );
+            UpdateZoneLod( td, stack );
 
 #ifndef TRACY_NO_STATISTICS
+            td->zoneIndex.Close();
             ZoneThreadData ztd;
             ztd.SetZone( zone );
             ztd.SetThread( CompressThread( v.tid ) );
+            ztd.SetParentSrcLoc( stack.empty() ? 0 : stack.back()->SrcLoc() );
             auto slz = GetSourceLocationZones( zone->SrcLoc() );
             slz->zones.push_back( ztd );
 #else
@@ -519,6 +650,7 @@ Worker::Worker( const char* name, const char* program, const std::vector<ImportE
         plot->min = min;
         plot->max = max;
         plot->sum = sum;
+        plot->UpdateLod();
 
         m_data.plots.Data().push_back( plot );
     }
@@ -969,6 +1101,12 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
                 }
             }
             UpdateLockCount( lockmap, 0 );
+            for( uint64_t i=0; i<tsz; i++ ) UpdateLockStats( lockmap, i );
+            if( fileVer >= FileVersion( 0, 11, 3 ) )
+            {
+                f.Read( lockmap.stats.aggregated );
+                ApplyLockAggregate( lockmap.stats );
+            }
             m_data.lockMap.emplace( id, lockmapPtr );
         }
     }
@@ -985,6 +1123,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
             f.Skip( tsz * sizeof( uint64_t ) );
             f.Read( tsz );
             f.Skip( tsz * ( sizeof( int64_t ) + sizeof( int16_t ) + sizeof( LockEvent::thread ) + sizeof( LockEvent::type ) ) );
+            if( fileVer >= FileVersion( 0, 11, 3 ) ) f.Skip( sizeof( LockStats::Aggregate ) );
         }
     }
 
@@ -1024,6 +1163,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
     f.Read( sz );
     m_data.zoneChildren.reserve_exact( sz, m_slab );
     memset( (char*)m_data.zoneChildren.data(), 0, sizeof( Vector<short_ptr<ZoneEvent>> ) * sz );
+    m_data.zoneChildrenDepth.reserve_exact( sz, m_slab );
     int32_t childIdx = 0;
     f.Read( sz );
     m_data.threads.reserve( sz );
@@ -1049,6 +1189,10 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
         if( tsz != 0 )
         {
             ReadTimeline( f, td->timeline, tsz, 0, childIdx, td->maxDepth );
+            if( tsz >= ZoneLod::MinZones ) ExtendZoneLod( td->timelineLod, td->timeline );
+#ifndef TRACY_NO_STATISTICS
+            BuildZoneIndex( td->zoneIndex, td->timeline, 0 );
+#endif
         }
         uint64_t msz;
         f.Read( msz );
@@ -1176,6 +1320,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
                 ptr->time = refTime;
                 ptr++;
             }
+            pd->UpdateLod();
             m_data.plots.Data().push_back_no_space_check( pd );
         }
     }
@@ -1190,6 +1335,49 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
         }
     }
 
+    if( fileVer >= FileVersion( 0, 11, 4 ) )
+    {
+        f.Read( sz );
+        for( uint64_t i=0; i<sz; i++ )
+        {
+            uint64_t name, ssz;
+            f.Read2( name, ssz );
+            HistogramData* hd = ( eventMask & EventType::Plots ) ? CreateHistogram( name ) : nullptr;
+            int64_t refTime = 0;
+            for( uint64_t j=0; j<ssz; j++ )
+            {
+                int64_t t;
+                HistogramSnapshot snapshot;
+                f.Read6( t, snapshot.min, snapshot.max, snapshot.sum, snapshot.count, snapshot.binCount );
+                refTime += t;
+                snapshot.time = refTime;
+                if( snapshot.binCount > HistogramBuckets )
+                {
+                    s_loadProgress.total.store( 0, std::memory_order_relaxed );
+                    throw LoadFailure( "Invalid histogram data" );
+                }
+                if( hd )
+                {
+                    HistogramBin bins[HistogramBuckets];
+                    f.Read( bins, sizeof( HistogramBin ) * snapshot.binCount );
+                    for( uint16_t k=0; k<snapshot.binCount; k++ )
+                    {
+                        if( bins[k].idx >= HistogramBuckets || ( k != 0 && bins[k].idx <= bins[k-1].idx ) )
+                        {
+                            s_loadProgress.total.store( 0, std::memory_order_relaxed );
+                            throw LoadFailure( "Invalid histogram data" );
+                        }
+                    }
+                    StoreHistogramSnapshot( *hd, snapshot, bins );
+                }
+                else
+                {
+                    f.Skip( sizeof( HistogramBin ) * snapshot.binCount );
+                }
+            }
+        }
+    }
+
     s_loadProgress.subTotal.store( 0, std::memory_order_relaxed );
     s_loadProgress.progress.store( LoadProgress::Memory, std::memory_order_relaxed );
 
@@ -1241,8 +1429,10 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
                     mem->SetTimeThreadFree( timeFree, threadFree );
                     active.emplace( ptr, i );
                 }
+                memdata.CountAlloc( *mem );
                 mem++;
             }
+            memdata.freeIndex.Update( memdata.data.data(), sz );
             memload += sz;
             f.Read4( memdata.high, memdata.low, memdata.usage, memdata.name );
 
@@ -1700,19 +1890,19 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
                 if( mem.second->reconstruct ) jobs.emplace_back( std::thread( [this, mem = mem.second] { ReconstructMemAllocPlot( *mem ); } ) );
             }
 
-            std::function<void(uint8_t*, Vector<short_ptr<ZoneEvent>>&, uint16_t)> ProcessTimeline;
-            ProcessTimeline = [this, &ProcessTimeline] ( uint8_t* countMap, Vector<short_ptr<ZoneEvent>>& _vec, uint16_t thread )
+            std::function<void(uint8_t*, Vector<short_ptr<ZoneEvent>>&, uint16_t, int16_t)> ProcessTimeline;
+            ProcessTimeline = [this, &ProcessTimeline] ( uint8_t* countMap, Vector<short_ptr<ZoneEvent>>& _vec, uint16_t thread, int16_t parentSrcLoc )
             {
                 if( m_shutdown.load( std::memory_order_relaxed ) ) return;
                 assert( _vec.is_magic() );
                 auto& vec = *(Vector<ZoneEvent>*)( &_vec );
                 for( auto& zone : vec )
                 {
-                    if( zone.IsEndValid() ) ReconstructZoneStatistics( countMap, zone, thread );
+                    if( zone.IsEndValid() ) ReconstructZoneStatistics( countMap, zone, thread, parentSrcLoc );
                     if( zone.HasChildren() )
                     {
                         countMap[uint16_t(zone.SrcLoc())]++;
-                        ProcessTimeline( countMap, GetZoneChildrenMutable( zone.Child() ), thread );
+                        ProcessTimeline( countMap, GetZoneChildrenMutable( zone.Child() ), thread, zone.SrcLoc() );
                         countMap[uint16_t(zone.SrcLoc())]--;
                     }
                 }
@@ -1726,11 +1916,14 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
                     {
                         uint8_t countMap[64*1024];
                         // Don't touch thread compression cache in a thread.
-                        ProcessTimeline( countMap, t->timeline, m_data.localThreadCompress.DecompressMustRaw( t->id ) );
+                        ProcessTimeline( countMap, t->timeline, m_data.localThreadCompress.DecompressMustRaw( t->id ), 0 );
                     }
                 }
-                std::lock_guard<std::mutex> lock( m_data.lock );
-                m_data.sourceLocationZonesReady = true;
+                {
+                    std::lock_guard<std::mutex> lock( m_data.lock );
+                    m_data.sourceLocationZonesReady = true;
+                }
+                if( !m_data.ctxSwitch.empty() ) ReconstructZoneOffCpuTime();
             } ) );
 
             std::function<void(Vector<short_ptr<GpuEvent>>&, uint16_t)> ProcessTimelineGpu;
@@ -1767,149 +1960,361 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
 
             if( eventMask & EventType::Samples )
             {
-                jobs.emplace_back( std::thread( [this] {
-                    unordered_flat_map<uint32_t, uint32_t> counts;
-                    uint32_t total = 0;
-                    for( auto& t : m_data.threads ) total += t->samples.size();
-                    if( total != 0 )
+                // Samples are processed in chunks taken from all threads, by a pool of workers with
+                // private accumulators. The accumulators are merged when all chunks are done.
+                auto chunks = std::make_shared<std::vector<SampleChunk>>();
+                uint64_t total = 0;
+                for( auto& t : m_data.threads )
+                {
+                    const auto sz = t->samples.size();
+                    if( sz == 0 ) continue;
+                    const auto tid = CompressThread( t->id );
+                    for( size_t i=0; i<sz; i+=SampleChunkSize ) chunks->emplace_back( SampleChunk { t, tid, i, std::min<size_t>( i + SampleChunkSize, sz ) } );
+                    total += sz;
+                }
+                m_sampleProgress.subProgress.store( 0, std::memory_order_relaxed );
+                m_sampleProgress.subTotal.store( total * 2, std::memory_order_relaxed );
+                // The sample statistics, ghost zones and sample symbols jobs below run at the same
+                // time, each with its own pool, so the hardware threads are split between them.
+                const auto workers = std::max<int>( std::thread::hardware_concurrency() / 3, 1 );
+
+                jobs.emplace_back( std::thread( [this, chunks, workers] {
+                    struct Accumulator
                     {
-                        for( auto& t : m_data.threads )
+                        unordered_flat_map<uint32_t, uint32_t> counts;
+                        unordered_flat_map<uint64_t, unordered_flat_map<CallstackFrameId, uint32_t, CallstackFrameIdHash, CallstackFrameIdCompare>> ipMap;
+                    };
+                    std::vector<Accumulator> acc( workers );
+                    std::atomic<size_t> next = 0;
+                    {
+                        TaskDispatch td( workers - 1, "Sample stats" );
+                        for( int w=0; w<workers; w++ )
                         {
-                            if( m_shutdown.load( std::memory_order_relaxed ) ) return;
-                            auto cit = t->ctxSwitchSamples.begin();
-                            for( auto& sd : t->samples )
-                            {
-                                bool isCtxSwitch = false;
-                                if( cit != t->ctxSwitchSamples.end() )
-                                {
-                                    const auto sdt = sd.time.Val();
-                                    cit = std::lower_bound( cit, t->ctxSwitchSamples.end(), sdt, []( const auto& l, const auto& r ) { return (uint64_t)l.time.Val() < (uint64_t)r; } );
-                                    isCtxSwitch = cit != t->ctxSwitchSamples.end() && cit->time.Val() == sdt;
-                                }
-                                if( !isCtxSwitch )
+                            td.Queue( [this, &chunks, &next, &acc = acc[w]] {
+                                for(;;)
                                 {
-                                    const auto cs = sd.callstack.Val();
-                                    auto it = counts.find( cs );
-                                    if( it == counts.end() )
+                                    if( m_shutdown.load( std::memory_order_relaxed ) ) return;
+                                    const auto idx = next.fetch_add( 1, std::memory_order_relaxed );
+                                    if( idx >= chunks->size() ) return;
+                                    const auto& chunk = (*chunks)[idx];
+                                    const auto& t = *chunk.thread;
+                                    auto cit = t.ctxSwitchSamples.begin();
+                                    if( chunk.begin != 0 && cit != t.ctxSwitchSamples.end() )
                                     {
-                                        counts.emplace( cs, 1 );
+                                        const auto st = t.samples[chunk.begin].time.Val();
+                                        cit = std::lower_bound( cit, t.ctxSwitchSamples.end(), st, []( const auto& l, const auto& r ) { return (uint64_t)l.time.Val() < (uint64_t)r; } );
                                     }
-                                    else
-                                    {
-                                        it->second++;
-                                    }
-
-                                    const auto& callstack = GetCallstack( cs );
-                                    auto& ip = callstack[0];
-                                    auto frame = GetCallstackFrame( ip );
-                                    if( frame )
+                                    for( size_t i=chunk.begin; i<chunk.end; i++ )
                                     {
-                                        const auto symAddr = frame->data[0].symAddr;
-                                        auto it = m_data.instructionPointersMap.find( symAddr );
-                                        if( it == m_data.instructionPointersMap.end() )
+                                        const auto& sd = t.samples[i];
+                                        bool isCtxSwitch = false;
+                                        if( cit != t.ctxSwitchSamples.end() )
                                         {
-                                            m_data.instructionPointersMap.emplace( symAddr, unordered_flat_map<CallstackFrameId, uint32_t, CallstackFrameIdHash, CallstackFrameIdCompare> { { ip, 1 } } );
+                                            const auto sdt = sd.time.Val();
+                                            cit = std::lower_bound( cit, t.ctxSwitchSamples.end(), sdt, []( const auto& l, const auto& r ) { return (uint64_t)l.time.Val() < (uint64_t)r; } );
+                                            isCtxSwitch = cit != t.ctxSwitchSamples.end() && cit->time.Val() == sdt;
                                         }
-                                        else
+                                        if( !isCtxSwitch )
                                         {
-                                            auto fit = it->second.find( ip );
-                                            if( fit == it->second.end() )
+                                            const auto cs = sd.callstack.Val();
+                                            auto it = acc.counts.find( cs );
+                                            if( it == acc.counts.end() )
                                             {
-                                                it->second.emplace( ip, 1 );
+                                                acc.counts.emplace( cs, 1 );
                                             }
                                             else
                                             {
-                                                fit->second++;
+                                                it->second++;
+                                            }
+
+                                            const auto& callstack = GetCallstack( cs );
+                                            auto& ip = callstack[0];
+                                            auto frame = GetCallstackFrame( ip );
+                                            if( frame )
+                                            {
+                                                auto& ipm = acc.ipMap[frame->data[0].symAddr];
+                                                auto fit = ipm.find( ip );
+                                                if( fit == ipm.end() )
+                                                {
+                                                    ipm.emplace( ip, 1 );
+                                                }
+                                                else
+                                                {
+                                                    fit->second++;
+                                                }
                                             }
                                         }
                                     }
+                                    m_sampleProgress.subProgress.fetch_add( chunk.end - chunk.begin, std::memory_order_relaxed );
                                 }
-                            }
+                            } );
                         }
-                        for( auto& v : counts ) UpdateSampleStatistics( v.first, v.second, false );
+                        td.Sync();
                     }
-                    std::lock_guard<std::mutex> lock( m_data.lock );
-                    m_data.callstackSamplesReady = true;
-                } ) );
+                    if( m_shutdown.load( std::memory_order_relaxed ) ) return;
 
-                jobs.emplace_back( std::thread( [this] {
-                    uint32_t gcnt = 0;
-                    for( auto& t : m_data.threads )
+                    auto& counts = acc[0].counts;
+                    m_data.instructionPointersMap = std::move( acc[0].ipMap );
+                    for( int w=1; w<workers; w++ )
                     {
-                        if( m_shutdown.load( std::memory_order_relaxed ) ) return;
-                        if( !t->samples.empty() )
+                        for( auto& v : acc[w].counts ) counts[v.first] += v.second;
+                        for( auto& v : acc[w].ipMap )
                         {
-                            if( t->samples[0].time.Val() != 0 )
+                            auto it = m_data.instructionPointersMap.find( v.first );
+                            if( it == m_data.instructionPointersMap.end() )
                             {
-                                for( auto& sd : t->samples )
-                                {
-                                    gcnt += AddGhostZone( GetCallstack( sd.callstack.Val() ), &t->ghostZones, sd.time.Val() );
-                                }
+                                m_data.instructionPointersMap.emplace( v.first, std::move( v.second ) );
                             }
                             else
                             {
-                                for( auto& sd : t->samples )
-                                {
-                                    const auto st = sd.time.Val();
-                                    if( st != 0 ) gcnt += AddGhostZone( GetCallstack( sd.callstack.Val() ), &t->ghostZones, st );
-                                }
+                                for( auto& ip : v.second ) it->second[ip.first] += ip.second;
                             }
                         }
+                        acc[w] = Accumulator();
                     }
+                    // Parent call stacks are created here, which is kept serial. It only runs once per unique call stack.
+                    for( auto& v : counts ) UpdateSampleStatistics( v.first, v.second, false );
                     std::lock_guard<std::mutex> lock( m_data.lock );
-                    m_data.ghostZonesReady = true;
-                    m_data.ghostCnt = gcnt;
+                    m_data.callstackSamplesReady = true;
                 } ) );
 
-                jobs.emplace_back( std::thread( [this] {
-                    for( auto& t : m_data.threads )
+                jobs.emplace_back( std::thread( [this, workers] {
+                    // Every thread is built into its own children and frame dictionary, these are
+                    // merged into the shared ones once all threads are done.
+                    struct GhostThread
                     {
-                        uint16_t tid = CompressThread( t->id );
-                        for( auto& v : t->samples )
-                        {
-                            const auto& time = v.time;
-                            const auto cs = v.callstack.Val();
-                            const auto& callstack = GetCallstack( cs );
-                            auto& ip = callstack[0];
-                            auto frame = GetCallstackFrame( ip );
-                            if( frame )
+                        ThreadData* thread;
+                        uint32_t cnt;
+                        int32_t childOffset;
+                        Vector<InlineStackData> inlineStack;
+                        Vector<Vector<GhostZone>> children;
+                        Vector<GhostKey> frames;
+                        unordered_flat_map<GhostKey, uint32_t, GhostKeyHasher, GhostKeyComparator> framesMap;
+                        std::vector<uint32_t> frameRemap;
+                    };
+
+                    std::vector<ThreadData*> threads;
+                    for( auto& t : m_data.threads ) if( !t->samples.empty() ) threads.emplace_back( t );
+                    std::sort( threads.begin(), threads.end(), []( const auto& l, const auto& r ) { return l->samples.size() > r->samples.size(); } );
+                    std::vector<GhostThread> gt( threads.size() );
+                    for( size_t i=0; i<threads.size(); i++ ) gt[i].thread = threads[i];
+
+                    // Threads are taken in order through a shared index, so that the largest ones are
+                    // started first and don't end up as the tail of the job.
+                    const auto ghostWorkers = std::max( std::min<int>( workers, gt.size() ), 1 );
+                    std::atomic<size_t> next = 0;
+                    TaskDispatch td( ghostWorkers - 1, "Ghost zones" );
+                    for( int w=0; w<ghostWorkers; w++ )
+                    {
+                        td.Queue( [this, &gt, &next] {
+                            for(;;)
                             {
-                                const auto symAddr = frame->data[0].symAddr;
-                                auto it = m_data.symbolSamples.find( symAddr );
-                                if( it == m_data.symbolSamples.end() )
+                                if( m_shutdown.load( std::memory_order_relaxed ) ) return;
+                                const auto idx = next.fetch_add( 1, std::memory_order_relaxed );
+                                if( idx >= gt.size() ) return;
+                                auto& g = gt[idx];
+                                GhostContext ctx { g.inlineStack, g.children, g.frames, g.framesMap };
+                                auto t = g.thread;
+                                uint32_t gcnt = 0;
+                                if( t->samples[0].time.Val() != 0 )
                                 {
-                                    m_data.symbolSamples.emplace( symAddr, Vector<SampleDataRange>( SampleDataRange { time, tid, ip } ) );
+                                    for( auto& sd : t->samples )
+                                    {
+                                        gcnt += AddGhostZone( ctx, GetCallstack( sd.callstack.Val() ), &t->ghostZones, sd.time.Val() );
+                                    }
                                 }
                                 else
                                 {
-                                    it->second.push_back_non_empty( SampleDataRange { time, tid, ip } );
+                                    for( auto& sd : t->samples )
+                                    {
+                                        const auto st = sd.time.Val();
+                                        if( st != 0 ) gcnt += AddGhostZone( ctx, GetCallstack( sd.callstack.Val() ), &t->ghostZones, st );
+                                    }
                                 }
+                                g.cnt = gcnt;
+                            }
+                        } );
+                    }
+                    td.Sync();
+                    if( m_shutdown.load( std::memory_order_relaxed ) ) return;
+
+                    uint32_t gcnt = 0;
+                    size_t childCount = 0;
+                    for( auto& g : gt ) childCount += g.children.size();
+                    m_data.ghostChildren.reserve( childCount );
+                    for( auto& g : gt )
+                    {
+                        gcnt += g.cnt;
+                        g.frameRemap.resize( g.frames.size() );
+                        for( size_t i=0; i<g.frames.size(); i++ )
+                        {
+                            const auto& key = g.frames[i];
+                            auto it = m_data.ghostFramesMap.find( key );
+                            if( it == m_data.ghostFramesMap.end() )
+                            {
+                                const auto fid = uint32_t( m_data.ghostFrames.size() );
+                                m_data.ghostFrames.push_back( key );
+                                m_data.ghostFramesMap.emplace( key, fid );
+                                g.frameRemap[i] = fid;
                             }
-                            auto childAddr = GetCanonicalPointer( callstack[0] );
-                            for( uint16_t i=1; i<callstack.size(); i++ )
+                            else
                             {
-                                auto addr = GetCanonicalPointer( callstack[i] );
-                                auto it = m_data.childSamples.find( addr );
-                                if( it == m_data.childSamples.end() )
+                                g.frameRemap[i] = it->second;
+                            }
+                        }
+                        g.childOffset = int32_t( m_data.ghostChildren.size() );
+                        for( auto& c : g.children ) m_data.ghostChildren.push_back( std::move( c ) );
+                    }
+                    for( auto& g : gt )
+                    {
+                        td.Queue( [this, &g] {
+                            auto remap = [&g] ( Vector<GhostZone>& vec ) {
+                                for( auto& zone : vec )
                                 {
-                                    m_data.childSamples.emplace( addr, Vector<ChildSample>( ChildSample { time, childAddr } ) );
+                                    zone.frame.SetVal( g.frameRemap[zone.frame.Val()] );
+                                    if( zone.child >= 0 ) zone.child += g.childOffset;
                                 }
-                                else
+                            };
+                            remap( g.thread->ghostZones );
+                            const auto end = g.childOffset + g.children.size();
+                            for( size_t i=g.childOffset; i<end; i++ ) remap( m_data.ghostChildren[i] );
+                        } );
+                    }
+                    td.Sync();
+
+                    std::lock_guard<std::mutex> lock( m_data.lock );
+                    m_data.ghostZonesReady = true;
+                    m_data.ghostCnt = gcnt;
+                } ) );
+
+                jobs.emplace_back( std::thread( [this, chunks, workers] {
+                    struct Accumulator
+                    {
+                        unordered_flat_map<uint64_t, Vector<SampleDataRange>> symbolSamples;
+                        unordered_flat_map<uint64_t, Vector<ChildSample>> childSamples;
+                    };
+                    std::vector<Accumulator> acc( workers );
+                    std::atomic<size_t> next = 0;
+                    TaskDispatch td( workers - 1, "Sample symbols" );
+                    for( int w=0; w<workers; w++ )
+                    {
+                        td.Queue( [this, &chunks, &next, &acc = acc[w]] {
+                            for(;;)
+                            {
+                                if( m_shutdown.load( std::memory_order_relaxed ) ) return;
+                                const auto idx = next.fetch_add( 1, std::memory_order_relaxed );
+                                if( idx >= chunks->size() ) return;
+                                const auto& chunk = (*chunks)[idx];
+                                const auto& t = *chunk.thread;
+                                for( size_t j=chunk.begin; j<chunk.end; j++ )
                                 {
-                                    it->second.push_back_non_empty( ChildSample { time, childAddr } );
+                                    const auto& v = t.samples[j];
+                                    const auto& time = v.time;
+                                    const auto cs = v.callstack.Val();
+                                    const auto& callstack = GetCallstack( cs );
+                                    auto& ip = callstack[0];
+                                    auto frame = GetCallstackFrame( ip );
+                                    if( frame )
+                                    {
+                                        const auto symAddr = frame->data[0].symAddr;
+                                        auto it = acc.symbolSamples.find( symAddr );
+                                        if( it == acc.symbolSamples.end() )
+                                        {
+                                            acc.symbolSamples.emplace( symAddr, Vector<SampleDataRange>( SampleDataRange { time, chunk.tid, ip } ) );
+                                        }
+                                        else
+                                        {
+                                            it->second.push_back_non_empty( SampleDataRange { time, chunk.tid, ip } );
+                                        }
+                                    }
+                                    auto childAddr = GetCanonicalPointer( callstack[0] );
+                                    for( uint16_t i=1; i<callstack.size(); i++ )
+                                    {
+                                        auto addr = GetCanonicalPointer( callstack[i] );
+                                        auto it = acc.childSamples.find( addr );
+                                        if( it == acc.childSamples.end() )
+                                        {
+                                            acc.childSamples.emplace( addr, Vector<ChildSample>( ChildSample { time, childAddr } ) );
+                                        }
+                                        else
+                                        {
+                                            it->second.push_back_non_empty( ChildSample { time, childAddr } );
+                                        }
+                                        childAddr = addr;
+                                    }
                                 }
-                                childAddr = addr;
+                                m_sampleProgress.subProgress.fetch_add( chunk.end - chunk.begin, std::memory_order_relaxed );
                             }
-                        }
+                        } );
                     }
-                    for( auto& v : m_data.symbolSamples )
+                    td.Sync();
+                    if( m_shutdown.load( std::memory_order_relaxed ) ) return;
+
+                    m_data.symbolSamples = std::move( acc[0].symbolSamples );
+                    m_data.childSamples = std::move( acc[0].childSamples );
+                    for( int w=1; w<workers; w++ )
                     {
-                        pdqsort_branchless( v.second.begin(), v.second.end(), []( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs.time.Val(); } );
+                        for( auto& v : acc[w].symbolSamples )
+                        {
+                            auto it = m_data.symbolSamples.find( v.first );
+                            if( it == m_data.symbolSamples.end() )
+                            {
+                                m_data.symbolSamples.emplace( v.first, std::move( v.second ) );
+                            }
+                            else
+                            {
+                                it->second.insert( it->second.end(), v.second.begin(), v.second.end() );
+                            }
+                        }
+                        for( auto& v : acc[w].childSamples )
+                        {
+                            auto it = m_data.childSamples.find( v.first );
+                            if( it == m_data.childSamples.end() )
+                            {
+                                m_data.childSamples.emplace( v.first, std::move( v.second ) );
+                            }
+                            else
+                            {
+                                it->second.insert( it->second.end(), v.second.begin(), v.second.end() );
+                            }
+                        }
+                        acc[w] = Accumulator();
                     }
-                    for( auto& v : m_data.childSamples )
+
+                    std::vector<Vector<SampleDataRange>*> symVec;
+                    std::vector<Vector<ChildSample>*> childVec;
+                    symVec.reserve( m_data.symbolSamples.size() );
+                    childVec.reserve( m_data.childSamples.size() );
+                    for( auto& v : m_data.symbolSamples ) symVec.emplace_back( &v.second );
+                    for( auto& v : m_data.childSamples ) childVec.emplace_back( &v.second );
+                    next.store( 0, std::memory_order_relaxed );
+                    for( int w=0; w<workers; w++ )
                     {
-                        pdqsort_branchless( v.second.begin(), v.second.end(), []( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs.time.Val(); } );
+                        td.Queue( [&symVec, &childVec, &next] {
+                            enum { Block = 256 };
+                            const auto sz = symVec.size() + childVec.size();
+                            for(;;)
+                            {
+                                const auto first = next.fetch_add( Block, std::memory_order_relaxed );
+                                if( first >= sz ) return;
+                                const auto last = std::min<size_t>( first + Block, sz );
+                                for( size_t i=first; i<last; i++ )
+                                {
+                                    if( i < symVec.size() )
+                                    {
+                                        auto& v = *symVec[i];
+                                        pdqsort_branchless( v.begin(), v.end(), []( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs.time.Val(); } );
+                                    }
+                                    else
+                                    {
+                                        auto& v = *childVec[i - symVec.size()];
+                                        pdqsort_branchless( v.begin(), v.end(), []( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs.time.Val(); } );
+                                    }
+                                }
+                            }
+                        } );
                     }
+                    td.Sync();
                     std::lock_guard<std::mutex> lock( m_data.lock );
                     m_data.symbolSamplesReady = true;
                 } ) );
@@ -1941,6 +2346,7 @@ Worker::~Worker()
     for( auto& v : m_data.threads )
     {
         v->timeline.~Vector();
+        v->timelineLod.~ZoneLod();
         v->stack.~Vector();
         v->messages.~Vector();
         v->zoneIdStack.~Vector();
@@ -1948,6 +2354,7 @@ Worker::~Worker()
 #ifndef TRACY_NO_STATISTICS
         v->childTimeStack.~Vector();
         v->ghostZones.~Vector();
+        v->zoneIndex.~ZoneIndex();
 #endif
     }
     for( auto& v : m_data.gpuData )
@@ -1958,6 +2365,11 @@ Worker::~Worker()
             vt.second.stack.~Vector();
         }
     }
+    for( auto& v : m_data.histograms )
+    {
+        for( auto plot = v->plot->nextPlot; plot; plot = plot->nextPlot ) plot->~PlotData();
+        v->~HistogramData();
+    }
     for( auto& v : m_data.plots.Data() )
     {
         v->~PlotData();
@@ -2303,19 +2715,34 @@ const char* Worker::GetSymbolCode( uint64_t sym, uint32_t& len ) const
     return it->second.data;
 }
 
-uint64_t Worker::GetSymbolForAddress( uint64_t address )
+const SymbolLocation* Worker::FindSymbolLocation( uint64_t address )
 {
     DoPostponedSymbols();
-    auto it = std::lower_bound( m_data.symbolLoc.begin(), m_data.symbolLoc.end(), address, [] ( const auto& l, const auto& r ) { return l.addr + l.len < r; } );
-    if( it == m_data.symbolLoc.end() || address < it->addr ) return 0;
+    const auto& loc = m_data.symbolLoc;
+
+    // Lookups tend to come in runs for the same symbol.
+    auto idx = m_data.symbolLocLastHit;
+    if( idx >= loc.size() || address < loc[idx].addr || loc[idx].addr + loc[idx].len < address ||
+        ( idx != 0 && address <= loc[idx-1].addr + loc[idx-1].len ) )
+    {
+        idx = m_data.symbolLocIndex.LowerBound( address );
+        if( idx == loc.size() || address < loc[idx].addr ) return nullptr;
+        m_data.symbolLocLastHit = idx;
+    }
+    return loc.data() + idx;
+}
+
+uint64_t Worker::GetSymbolForAddress( uint64_t address )
+{
+    auto it = FindSymbolLocation( address );
+    if( !it ) return 0;
     return it->addr;
 }
 
 uint64_t Worker::GetSymbolForAddress( uint64_t address, uint32_t& offset )
 {
-    DoPostponedSymbols();
-    auto it = std::lower_bound( m_data.symbolLoc.begin(), m_data.symbolLoc.end(), address, [] ( const auto& l, const auto& r ) { return l.addr + l.len < r; } );
-    if( it == m_data.symbolLoc.end() || address < it->addr ) return 0;
+    auto it = FindSymbolLocation( address );
+    if( !it ) return 0;
     offset = address - it->addr;
     return it->addr;
 }
@@ -2346,7 +2773,7 @@ StringIdx Worker::GetLocationForAddress( uint64_t address, uint32_t& line ) cons
 const uint64_t* Worker::GetInlineSymbolList( uint64_t sym, uint32_t len )
 {
     DoPostponedInlineSymbols();
-    auto it = std::lower_bound( m_data.symbolLocInline.begin(), m_data.symbolLocInline.end(), sym );
+    auto it = m_data.symbolLocInline.begin() + m_data.symbolLocInlineIndex.LowerBound( sym );
     if( it == m_data.symbolLocInline.end() ) return nullptr;
     if( *it >= sym + len ) return nullptr;
     return it;
@@ -2668,40 +3095,6 @@ std::vector<int16_t> Worker::GetMatchingSourceLocation( const char* query, bool
 }
 
 #ifndef TRACY_NO_STATISTICS
-// TODO: Copy of View::GetZoneParent(TracyView_Utility.cpp) - consider moving code to a common place
-static const ZoneEvent *PlotHelper_GetZoneParent( const Worker &worker, const ZoneEvent &zone, uint64_t tid )
-{
-	const auto thread = worker.GetThreadData( tid );
-	const ZoneEvent *parent = nullptr;
-	const Vector<short_ptr<ZoneEvent>> *timeline = &thread->timeline;
-	if ( timeline->empty() ) return nullptr;
-	for ( ;;)
-	{
-		if ( timeline->is_magic() )
-		{
-			auto vec = ( Vector<ZoneEvent>* )timeline;
-			auto it = std::upper_bound( vec->begin(), vec->end(), zone.Start(), [] ( const auto &l, const auto &r ) { return l < r.Start(); } );
-			if ( it != vec->begin() ) --it;
-			if ( zone.IsEndValid() && it->Start() > zone.End() ) break;
-			if ( it == &zone ) return parent;
-			if ( !it->HasChildren() ) break;
-			parent = it;
-			timeline = &worker.GetZoneChildren( parent->Child() );
-		}
-		else
-		{
-			auto it = std::upper_bound( timeline->begin(), timeline->end(), zone.Start(), [] ( const auto &l, const auto &r ) { return l < r->Start(); } );
-			if ( it != timeline->begin() ) --it;
-			if ( zone.IsEndValid() && ( *it )->Start() > zone.End() ) break;
-			if ( *it == &zone ) return parent;
-			if ( !( *it )->HasChildren() ) break;
-			parent = *it;
-			timeline = &worker.GetZoneChildren( parent->Child() );
-		}
-	}
-	return nullptr;
-}
-
 static uint64_t PlotHelper_GetFilterId( const Worker &worker, const Worker::ZoneThreadData &ev, PlotFilterType filterType )
 {
 	switch ( filterType )
@@ -2725,10 +3118,7 @@ static uint64_t PlotHelper_GetFilterId( const Worker &worker, const Worker::Zone
 		case PlotFilterType::Callstack:
 			return worker.GetZoneExtra( *ev.Zone() ).callstack.Val();
 		case PlotFilterType::Parent:
-		{
-			const auto parent = PlotHelper_GetZoneParent( worker, *ev.Zone(), worker.DecompressThread( ev.Thread() ) );
-			return parent ? uint64_t( parent->SrcLoc() ) : 0;
-		}
+			return uint64_t( ev.ParentSrcLoc() );
 		case PlotFilterType::NoFilter:
 			return 0;
 		default:
@@ -3007,7 +3397,7 @@ void Worker::Network()
         }
 
         m_bufferOffset += sz;
-        if( m_bufferOffset > TargetFrameSize * 2 ) m_bufferOffset = 0;
+        if( m_bufferOffset > TargetFrameSize * NetBufferDepth ) m_bufferOffset = 0;
     }
 
 close:
@@ -3125,14 +3515,18 @@ void Worker::Exec()
         }
     }
 
-    m_serverQuerySpaceBase = m_serverQuerySpaceLeft = std::min( ( m_sock.GetSendBufSize() / ServerQueryPacketSize ), 8*1024 ) - 4;   // leave space for terminate request
+    // Unanswered queries must fit in the socket buffer, and unanswered frame and symbol queries must
+    // fit in the client symbol queue. The window starts at the smaller of the two and is then sized
+    // from the measured round-trip time, see UpdateQueryWindow().
+    m_serverQuerySpaceMax = m_sock.GetSendBufSize() / ServerQueryPacketSize - 4;   // leave space for terminate request
+    m_serverQuerySymbolMax = m_serverQuerySpaceBase = m_serverQuerySpaceLeft = std::min<int64_t>( m_serverQuerySpaceMax, SymbolQueueSize - 4 );
     m_hasData.store( true, std::memory_order_release );
 
     LZ4_setStreamDecode( (LZ4_streamDecode_t*)m_stream, nullptr, 0 );
     m_connected.store( true, std::memory_order_relaxed );
     {
         std::lock_guard<std::mutex> lock( m_netWriteLock );
-        m_netWriteCnt = 2;
+        m_netWriteCnt = NetBufferDepth;
         m_netWriteCv.notify_one();
     }
 
@@ -3165,11 +3559,17 @@ void Worker::Exec()
                 auto ev = (const QueueItem*)ptr;
                 if( !DispatchProcess( *ev, ptr ) )
                 {
+#ifndef TRACY_NO_STATISTICS
+                    FlushZoneStatistics();
+#endif
                     if( m_failure != Failure::None ) HandleFailure( ptr, end );
                     QueryTerminate();
                     goto close;
                 }
             }
+#ifndef TRACY_NO_STATISTICS
+            FlushZoneStatistics();
+#endif
 
             {
                 std::lock_guard<std::mutex> lock( m_netWriteLock );
@@ -3177,34 +3577,7 @@ void Worker::Exec()
                 m_netWriteCv.notify_one();
             }
 
-            if( m_serverQuerySpaceLeft > 0 && !m_serverQueryQueuePrio.empty() )
-            {
-                const auto toSend = std::min( m_serverQuerySpaceLeft, m_serverQueryQueuePrio.size() );
-                m_sock.Send( m_serverQueryQueuePrio.data(), toSend * ServerQueryPacketSize );
-                m_serverQuerySpaceLeft -= toSend;
-                if( toSend == m_serverQueryQueuePrio.size() )
-                {
-                    m_serverQueryQueuePrio.clear();
-                }
-                else
-                {
-                    m_serverQueryQueuePrio.erase( m_serverQueryQueuePrio.begin(), m_serverQueryQueuePrio.begin() + toSend );
-                }
-            }
-            if( m_serverQuerySpaceLeft > 0 && !m_serverQueryQueue.empty() )
-            {
-                const auto toSend = std::min( m_serverQuerySpaceLeft, m_serverQueryQueue.size() );
-                m_sock.Send( m_serverQueryQueue.data(), toSend * ServerQueryPacketSize );
-                m_serverQuerySpaceLeft -= toSend;
-                if( toSend == m_serverQueryQueue.size() )
-                {
-                    m_serverQueryQueue.clear();
-                }
-                else
-                {
-                    m_serverQueryQueue.erase( m_serverQueryQueue.begin(), m_serverQueryQueue.begin() + toSend );
-                }
-            }
+            SendServerQueries();
         }
 
         auto t1 = std::chrono::high_resolution_clock::now();
@@ -3212,6 +3585,7 @@ void Worker::Exec()
         enum { MbpsUpdateTime = 200 };
         if( td > MbpsUpdateTime )
         {
+            UpdateQueryWindow( td );
             UpdateMbps( td );
             t0 = t1;
         }
@@ -3266,6 +3640,8 @@ void Worker::UpdateMbps( int64_t td )
     m_mbpsData.compRatio = decBytes == 0 ? 1 : float( bytes ) / decBytes;
     m_mbpsData.queue = m_serverQueryQueue.size() + m_serverQueryQueuePrio.size();
     m_mbpsData.transferred += bytes;
+    m_mbpsData.queryWindow = m_serverQuerySpaceBase;
+    m_mbpsData.queryRtt = m_serverQueryRtt;
 }
 
 bool Worker::IsFailureThreadStringRetrieved()
@@ -3319,34 +3695,7 @@ void Worker::HandleFailure( const char* ptr, const char* end )
             m_netWriteCv.notify_one();
         }
 
-        if( m_serverQuerySpaceLeft > 0 && !m_serverQueryQueuePrio.empty() )
-        {
-            const auto toSend = std::min( m_serverQuerySpaceLeft, m_serverQueryQueuePrio.size() );
-            m_sock.Send( m_serverQueryQueuePrio.data(), toSend * ServerQueryPacketSize );
-            m_serverQuerySpaceLeft -= toSend;
-            if( toSend == m_serverQueryQueuePrio.size() )
-            {
-                m_serverQueryQueuePrio.clear();
-            }
-            else
-            {
-                m_serverQueryQueuePrio.erase( m_serverQueryQueuePrio.begin(), m_serverQueryQueuePrio.begin() + toSend );
-            }
-        }
-        if( m_serverQuerySpaceLeft > 0 && !m_serverQueryQueue.empty() )
-        {
-            const auto toSend = std::min( m_serverQuerySpaceLeft, m_serverQueryQueue.size() );
-            m_sock.Send( m_serverQueryQueue.data(), toSend * ServerQueryPacketSize );
-            m_serverQuerySpaceLeft -= toSend;
-            if( toSend == m_serverQueryQueue.size() )
-            {
-                m_serverQueryQueue.clear();
-            }
-            else
-            {
-                m_serverQueryQueue.erase( m_serverQueryQueue.begin(), m_serverQueryQueue.begin() + toSend );
-            }
-        }
+        SendServerQueries();
 
         if( m_shutdown.load( std::memory_order_relaxed ) ) return;
 
@@ -3461,9 +3810,10 @@ void Worker::DispatchFailure( const QueueItem& ev, const char*& ptr )
 void Worker::Query( ServerQuery type, uint64_t data, uint32_t extra )
 {
     ServerQueryPacket query { type, data, extra };
-    if( m_serverQuerySpaceLeft > 0 && m_serverQueryQueuePrio.empty() && m_serverQueryQueue.empty() )
+    if( GetQuerySpace( type ) > 0 && m_serverQueryQueuePrio.empty() && m_serverQueryQueue.empty() )
     {
         m_serverQuerySpaceLeft--;
+        m_serverQuerySent++;
         m_sock.Send( &query, ServerQueryPacketSize );
     }
     else if( IsQueryPrio( type ) )
@@ -3476,26 +3826,138 @@ void Worker::Query( ServerQuery type, uint64_t data, uint32_t extra )
     }
 }
 
-void Worker::QueryTerminate()
+// Frames and symbols are resolved by the client symbol worker, which may take a while. Their
+// queries wait in the client symbol queue, and a full queue would stall the client profiler thread.
+// They may only use the part of the window below the queue capacity, which keeps the growth past
+// it for the other queries, so that strings don't have to wait for them.
+int64_t Worker::GetQuerySpace( ServerQuery type ) const
 {
-    ServerQueryPacket query { ServerQueryTerminate, 0, 0 };
-    m_sock.Send( &query, ServerQueryPacketSize );
+    if( IsQueryPrio( type ) ) return m_serverQuerySpaceLeft;
+    const auto inFlight = m_serverQuerySpaceBase - m_serverQuerySpaceLeft;
+    return std::min( m_serverQuerySpaceLeft, m_serverQuerySymbolMax - inFlight );
 }
 
-void Worker::QuerySourceFile( const char* fn, const char* image )
+void Worker::SendServerQueries()
 {
-    if( image ) QueryDataTransfer( image, strlen( image ) + 1 );
-    QueryDataTransfer( fn, strlen( fn ) + 1 );
-    m_sourceCodeQuery.emplace( m_nextSourceCodeQuery, fn );
-    Query( ServerQuerySourceCode, m_nextSourceCodeQuery );
-    m_nextSourceCodeQuery++;
+    if( m_serverQuerySpaceLeft > 0 && !m_serverQueryQueuePrio.empty() )
+    {
+        SendServerQueries( m_serverQueryQueuePrio, m_serverQuerySpaceLeft );
+    }
+    const auto space = GetQuerySpace( ServerQueryDisconnect );
+    if( space > 0 && !m_serverQueryQueue.empty() )
+    {
+        SendServerQueries( m_serverQueryQueue, space );
+    }
 }
 
-void Worker::QueryDataTransfer( const void* ptr, size_t size )
+void Worker::SendServerQueries( Vector<ServerQueryPacket>& queue, int64_t space )
 {
-    Query( ServerQueryDataTransfer, size );
-    auto data = (const char*)ptr;
-    while( size > 0 )
+    const auto toSend = std::min<size_t>( space, queue.size() );
+    const auto now = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+
+    // Runs of the same query type are sent as a batch, which only carries the query ids.
+    m_serverQueryBuffer.clear();
+    size_t idx = 0;
+    while( idx < toSend )
+    {
+        const auto type = queue[idx].type;
+        auto end = idx + 1;
+        if( IsQueryBatchable( type ) )
+        {
+            const auto last = std::min<size_t>( toSend, idx + ServerQueryBatchMaxItems );
+            while( end < last && queue[end].type == type ) end++;
+        }
+        if( end - idx == 1 )
+        {
+            const auto pos = m_serverQueryBuffer.size();
+            m_serverQueryBuffer.resize( pos + ServerQueryPacketSize );
+            memcpy( m_serverQueryBuffer.data() + pos, &queue[idx], ServerQueryPacketSize );
+        }
+        else
+        {
+            const auto seq = m_serverQueryBatchSeq++;
+            m_serverQueryBatchTime[seq % 64] = { seq, now };
+
+            ServerQueryPacket batch { ServerQueryBatch, uint64_t( type ) | ( uint64_t( seq ) << 8 ), uint32_t( end - idx ) };
+            auto pos = m_serverQueryBuffer.size();
+            m_serverQueryBuffer.resize( pos + ServerQueryPacketSize + ( end - idx ) * sizeof( uint64_t ) );
+            auto dst = m_serverQueryBuffer.data() + pos;
+            memcpy( dst, &batch, ServerQueryPacketSize );
+            dst += ServerQueryPacketSize;
+            for( size_t i=idx; i<end; i++ )
+            {
+                memcpy( dst, &queue[i].ptr, sizeof( uint64_t ) );
+                dst += sizeof( uint64_t );
+            }
+        }
+        idx = end;
+    }
+    m_sock.Send( m_serverQueryBuffer.data(), m_serverQueryBuffer.size() );
+    m_serverQuerySpaceLeft -= toSend;
+    m_serverQuerySent += toSend;
+
+    if( toSend == queue.size() )
+    {
+        queue.clear();
+    }
+    else
+    {
+        queue.erase( queue.begin(), queue.begin() + toSend );
+    }
+}
+
+// The window is kept at twice the number of queries answered during one round-trip. It grows
+// while queries are waiting and answers arrive as fast as the window allows, and shrinks when
+// the client cannot keep up. Without a backlog nothing is learned and the window is left as is.
+// Queries waiting in the client inflate the smoothed round-trip time along with the window, so
+// growth past the initial size is bounded by the answer rate times the minimum round-trip time,
+// and by the socket buffer.
+void Worker::UpdateQueryWindow( int64_t td )
+{
+    const auto inFlight = m_serverQuerySpaceBase - m_serverQuerySpaceLeft;
+    const auto done = m_serverQuerySent - inFlight - m_serverQueryDone;
+    m_serverQueryDone += done;
+
+    if( m_serverQueryRtt == 0 || ( m_serverQueryQueue.empty() && m_serverQueryQueuePrio.empty() ) ) return;
+
+    enum { MinWindow = 1024 };
+    const auto bdp = int64_t( done * m_serverQueryRtt / ( td * 1000 ) );
+    const auto bdpMin = int64_t( done * m_serverQueryRttMin / ( td * 1000 ) );
+    const auto limit = std::clamp( bdpMin * 2, m_serverQuerySymbolMax, m_serverQuerySpaceMax );
+    auto window = m_serverQuerySpaceBase;
+    if( bdp * 2 >= window )
+    {
+        window *= 2;
+    }
+    else if( bdp * 4 < window )
+    {
+        window = std::max( bdp * 2, window / 2 );
+    }
+    window = std::clamp<int64_t>( window, std::min<int64_t>( MinWindow, m_serverQuerySymbolMax ), limit );
+    m_serverQuerySpaceLeft += window - m_serverQuerySpaceBase;
+    m_serverQuerySpaceBase = window;
+}
+
+void Worker::QueryTerminate()
+{
+    ServerQueryPacket query { ServerQueryTerminate, 0, 0 };
+    m_sock.Send( &query, ServerQueryPacketSize );
+}
+
+void Worker::QuerySourceFile( const char* fn, const char* image )
+{
+    if( image ) QueryDataTransfer( image, strlen( image ) + 1 );
+    QueryDataTransfer( fn, strlen( fn ) + 1 );
+    m_sourceCodeQuery.emplace( m_nextSourceCodeQuery, fn );
+    Query( ServerQuerySourceCode, m_nextSourceCodeQuery );
+    m_nextSourceCodeQuery++;
+}
+
+void Worker::QueryDataTransfer( const void* ptr, size_t size )
+{
+    Query( ServerQueryDataTransfer, size );
+    auto data = (const char*)ptr;
+    while( size > 0 )
     {
         uint64_t d8;
         uint32_t d4;
@@ -3591,6 +4053,9 @@ bool Worker::DispatchProcess( const QueueItem& ev, const char*& ptr )
             case QueueType::CallstackAllocPayload:
                 AddCallstackAllocPayload( ptr );
                 break;
+            case QueueType::HistogramPayload:
+                AddHistogramPayload( ptr, sz );
+                break;
             case QueueType::ExternalName:
                 AddExternalName( ev.stringTransfer.ptr, ptr, sz );
                 m_serverQuerySpaceLeft++;
@@ -3891,6 +4356,7 @@ void Worker::NewZone( ZoneEvent* zone )
         if( !back->HasChildren() )
         {
             back->SetChild( int32_t( m_data.zoneChildren.size() ) );
+            m_data.zoneChildrenDepth.push_back( 0 );
             if( m_data.zoneVectorCache.empty() )
             {
                 m_data.zoneChildren.push_back( Vector<short_ptr<ZoneEvent>>( zone ) );
@@ -3918,6 +4384,7 @@ void Worker::NewZone( ZoneEvent* zone )
 
 #ifndef TRACY_NO_STATISTICS
     td->childTimeStack.push_back( 0 );
+    td->zoneIndex.Add( zone, ssz );
 #endif
 }
 
@@ -3939,17 +4406,27 @@ void Worker::InsertLockEvent( LockMap& lockmap, LockEvent* lev, uint64_t thread,
     m_data.threadToLockIdMap[ thread ].emplace( lockid );
 
     auto& timeline = lockmap.timeline;
+    size_t pos;
     if( timeline.empty() )
     {
         timeline.push_back( { lev } );
-        UpdateLockCount( lockmap, timeline.size() - 1 );
+        pos = 0;
     }
-    else
+    else if( timeline.back().ptr->Time() <= time )
     {
-        assert( timeline.back().ptr->Time() <= time );
         timeline.push_back_non_empty( { lev } );
-        UpdateLockCount( lockmap, timeline.size() - 1 );
+        pos = timeline.size() - 1;
+    }
+    else
+    {
+        // In aggregated lock mode the wait of a slow acquisition is only sent
+        // when the lock is obtained, after events of other threads.
+        auto it = std::upper_bound( timeline.begin(), timeline.end(), time, [] ( const auto& l, const auto& r ) { return l < r.ptr->Time(); } );
+        pos = std::distance( timeline.begin(), it );
+        timeline.insert( it, { lev } );
     }
+    UpdateLockCount( lockmap, pos );
+    UpdateLockStats( lockmap, pos );
 
     auto& range = lockmap.range[it->second];
     if( range.start > time ) range.start = time;
@@ -4508,8 +4985,31 @@ void Worker::InsertPlot( PlotData* plot, int64_t time, double val )
         if( plot->min > val ) plot->min = val;
         else if( plot->max < val ) plot->max = val;
         plot->sum += val;
-        plot->data.push_back( { Int48( time ), val } );
+        if( plot->data.back().time.Val() <= time )
+        {
+            plot->data.push_back( { Int48( time ), val }, [] ( const auto& l, const auto& r ) { return l.time.Val() <= r.time.Val(); } );
+        }
+        else
+        {
+            // Points sent by different threads may arrive late. They are put in place, so
+            // the pyramid only has to be rebuilt from where they land.
+            plot->EnsureSorted();
+            auto it = std::upper_bound( plot->data.begin(), plot->data.end(), time, [] ( const auto& l, const auto& r ) { return l < r.time.Val(); } );
+            plot->lod.Truncate( it - plot->data.begin() );
+            plot->data.insert( it, { Int48( time ), val } );
+        }
     }
+    plot->UpdateLod();
+}
+
+void Worker::UpdatePlot( PlotData* plot, size_t idx, double val )
+{
+    auto& item = plot->data[idx];
+    plot->sum += val - item.val;
+    item.val = val;
+    if( plot->min > val ) plot->min = val;
+    else if( plot->max < val ) plot->max = val;
+    plot->lod.Refresh( plot->data.data(), idx );
 }
 
 void Worker::HandlePlotName( uint64_t name, const char* str, size_t sz )
@@ -4546,6 +5046,12 @@ void Worker::DoPostponedSymbols()
         std::inplace_merge( ms, m_data.symbolLoc.begin() + m_data.newSymbolsIndex, m_data.symbolLoc.end(), [] ( const auto& l, const auto& r ) { return l.addr < r.addr; } );
         m_data.newSymbolsIndex = -1;
     }
+    // Symbols are only ever added, a size mismatch means the index is out of date.
+    if( m_data.symbolLocIndex.Size() != m_data.symbolLoc.size() )
+    {
+        const auto& loc = m_data.symbolLoc;
+        m_data.symbolLocIndex.Build( loc.size(), [&loc] ( size_t i ) { return loc[i].addr + loc[i].len; } );
+    }
 }
 
 void Worker::DoPostponedInlineSymbols()
@@ -4561,6 +5067,11 @@ void Worker::DoPostponedInlineSymbols()
         std::inplace_merge( ms, m_data.symbolLocInline.begin() + m_data.newInlineSymbolsIndex, m_data.symbolLocInline.end() );
         m_data.newInlineSymbolsIndex = -1;
     }
+    if( m_data.symbolLocInlineIndex.Size() != m_data.symbolLocInline.size() )
+    {
+        const auto& loc = m_data.symbolLocInline;
+        m_data.symbolLocInlineIndex.Build( loc.size(), [&loc] ( size_t i ) { return loc[i]; } );
+    }
 }
 
 void Worker::DoPostponedWorkAll()
@@ -4571,7 +5082,7 @@ void Worker::DoPostponedWorkAll()
 
     for( auto& plot : m_data.plots.Data() )
     {
-        if( !plot->data.is_sorted() ) plot->data.sort();
+        plot->EnsureSorted();
     }
 }
 
@@ -4692,7 +5203,14 @@ void Worker::GetStackWithInlines( Vector<InlineStackData>& ret, const VarArray<C
 
 int Worker::AddGhostZone( const VarArray<CallstackFrameId>& cs, Vector<GhostZone>* vec, uint64_t t )
 {
-    GetStackWithInlines( m_inlineStack, cs );
+    GhostContext ctx { m_inlineStack, m_data.ghostChildren, m_data.ghostFrames, m_data.ghostFramesMap };
+    return AddGhostZone( ctx, cs, vec, t );
+}
+
+int Worker::AddGhostZone( GhostContext& ctx, const VarArray<CallstackFrameId>& cs, Vector<GhostZone>* vec, uint64_t t )
+{
+    auto& inlineStack = ctx.inlineStack;
+    GetStackWithInlines( inlineStack, cs );
 
     if( !vec->empty() && vec->back().end.Val() > (int64_t)t )
     {
@@ -4704,44 +5222,44 @@ int Worker::AddGhostZone( const VarArray<CallstackFrameId>& cs, Vector<GhostZone
             if( back.end.Val() != refBackTime ) break;
             back.end.SetVal( t );
             if( back.child < 0 ) break;
-            tmp = &m_data.ghostChildren[back.child];
+            tmp = &ctx.children[back.child];
         }
     }
     const int64_t refBackTime = vec->empty() ? 0 : vec->back().end.Val();
     int gcnt = 0;
     size_t idx = 0;
-    while( !vec->empty() && idx < m_inlineStack.size() )
+    while( !vec->empty() && idx < inlineStack.size() )
     {
         auto& back = vec->back();
-        const auto& backKey = m_data.ghostFrames[back.frame.Val()];
+        const auto& backKey = ctx.frames[back.frame.Val()];
         const auto backFrame = GetCallstackFrame( backKey.frame );
         if( !backFrame ) break;
         const auto& inlineFrame = backFrame->data[backKey.inlineFrame];
-        if( inlineFrame.symAddr != m_inlineStack[idx].symAddr ) break;
+        if( inlineFrame.symAddr != inlineStack[idx].symAddr ) break;
         if( back.end.Val() != refBackTime ) break;
         back.end.SetVal( t + m_samplingPeriod );
-        if( ++idx == m_inlineStack.size() ) break;
+        if( ++idx == inlineStack.size() ) break;
         if( back.child < 0 )
         {
-            back.child = m_data.ghostChildren.size();
-            vec = &m_data.ghostChildren.push_next();
+            back.child = ctx.children.size();
+            vec = &ctx.children.push_next();
         }
         else
         {
-            vec = &m_data.ghostChildren[back.child];
+            vec = &ctx.children[back.child];
         }
     }
-    while( idx < m_inlineStack.size() )
+    while( idx < inlineStack.size() )
     {
         gcnt++;
         uint32_t fid;
-        GhostKey key { m_inlineStack[idx].frame, m_inlineStack[idx].inlineFrame };
-        auto it = m_data.ghostFramesMap.find( key );
-        if( it == m_data.ghostFramesMap.end() )
+        GhostKey key { inlineStack[idx].frame, inlineStack[idx].inlineFrame };
+        auto it = ctx.framesMap.find( key );
+        if( it == ctx.framesMap.end() )
         {
-            fid = uint32_t( m_data.ghostFrames.size() );
-            m_data.ghostFrames.push_back( key );
-            m_data.ghostFramesMap.emplace( key, fid );
+            fid = uint32_t( ctx.frames.size() );
+            ctx.frames.push_back( key );
+            ctx.framesMap.emplace( key, fid );
         }
         else
         {
@@ -4751,14 +5269,14 @@ int Worker::AddGhostZone( const VarArray<CallstackFrameId>& cs, Vector<GhostZone
         zone.start.SetVal( t );
         zone.end.SetVal( t + m_samplingPeriod );
         zone.frame.SetVal( fid );
-        if( ++idx == m_inlineStack.size() )
+        if( ++idx == inlineStack.size() )
         {
             zone.child = -1;
         }
         else
         {
-            zone.child = m_data.ghostChildren.size();
-            vec = &m_data.ghostChildren.push_next();
+            zone.child = ctx.children.size();
+            vec = &ctx.children.push_next();
         }
     }
     return gcnt;
@@ -4927,6 +5445,15 @@ bool Worker::Process( const QueueItem& ev )
     case QueueType::LockMarkFileLine:
         ProcessLockMarkFileLine( ev.lockMarkFileLine );
         break;
+    case QueueType::LockAggregateWait:
+        ProcessLockAggregateWait( ev.lockAggregate );
+        break;
+    case QueueType::LockAggregateHold:
+        ProcessLockAggregateHold( ev.lockAggregate );
+        break;
+    case QueueType::LockAggregateHistogram:
+        ProcessLockAggregateHistogram( ev.lockAggregateHistogram );
+        break;
     case QueueType::LockName:
         ProcessLockName( ev.lockName );
         break;
@@ -4942,6 +5469,12 @@ bool Worker::Process( const QueueItem& ev )
     case QueueType::PlotConfig:
         ProcessPlotConfig( ev.plotConfig );
         break;
+    case QueueType::CounterData:
+        ProcessCounterData( ev.counterData );
+        break;
+    case QueueType::HistogramData:
+        ProcessHistogramData( ev.histogramData );
+        break;
     case QueueType::Message:
         ProcessMessage( ev.message );
         break;
@@ -5064,6 +5597,8 @@ bool Worker::Process( const QueueItem& ev )
         break;
     case QueueType::Terminate:
         m_terminate = true;
+        // Windows still open will not receive more data.
+        for( auto& hd : m_data.histograms ) if( hd->open ) CloseHistogramWindow( *hd );
         break;
     case QueueType::KeepAlive:
         break;
@@ -5120,6 +5655,9 @@ bool Worker::Process( const QueueItem& ev )
         m_pendingSymbolCode--;
         m_serverQuerySpaceLeft++;
         break;
+    case QueueType::AckServerQueryBatch:
+        ProcessServerQueryBatchAck( ev.serverQueryBatchAck );
+        break;
     case QueueType::CpuTopology:
         ProcessCpuTopology( ev.cpuTopology );
         break;
@@ -5276,6 +5814,10 @@ void Worker::ProcessZoneEnd( const QueueZoneEnd& ev )
     const auto timeEnd = TscTime( RefTime( m_refTimeThread, ev.time ) );
     zone->SetEnd( timeEnd );
     assert( timeEnd >= zone->Start() );
+    UpdateZoneLod( td, stack );
+#ifndef TRACY_NO_STATISTICS
+    td->zoneIndex.Close();
+#endif
 
     if( m_data.lastTime < timeEnd ) m_data.lastTime = timeEnd;
 
@@ -5304,6 +5846,8 @@ void Worker::ProcessZoneEnd( const QueueZoneEnd& ev )
             fitVec.swap( childVec );
             m_data.zoneVectorCache.push_back( std::move( fitVec ) );
         }
+
+        m_data.zoneChildrenDepth[zone->Child()] = CalcZoneChildrenDepth( childVec );
     }
 
 #ifndef TRACY_NO_STATISTICS
@@ -5311,43 +5855,21 @@ void Worker::ProcessZoneEnd( const QueueZoneEnd& ev )
     const auto timeSpan = timeEnd - zone->Start();
     if( timeSpan > 0 )
     {
-        const auto ctid = CompressThread( td->id );
-        ZoneThreadData ztd;
-        ztd.SetZone( zone );
-        ztd.SetThread( ctid );
-
-        auto slz = GetSourceLocationZones( zone->SrcLoc() );
-        slz->zones.push_back( ztd );
-        if( slz->min > timeSpan ) slz->min = timeSpan;
-        if( slz->max < timeSpan ) slz->max = timeSpan;
-        slz->total += timeSpan;
-        slz->sumSq += double( timeSpan ) * timeSpan;
-        const auto selfSpan = timeSpan - td->childTimeStack.back_and_pop();
-        if( slz->selfMin > selfSpan ) slz->selfMin = selfSpan;
-        if( slz->selfMax < selfSpan ) slz->selfMax = selfSpan;
-        slz->selfTotal += selfSpan;
-
-        if( !isReentry )
-        {
-            slz->nonReentrantCount++;
-            if( slz->nonReentrantMin > timeSpan ) slz->nonReentrantMin = timeSpan;
-            if( slz->nonReentrantMax < timeSpan ) slz->nonReentrantMax = timeSpan;
-            slz->nonReentrantTotal += timeSpan;
-        }
+        const auto srcloc = zone->SrcLoc();
+        ZoneStatsItem item;
+        item.ztd.SetZone( zone );
+        item.ztd.SetThread( CompressThread( td->id ) );
+        item.ztd.SetParentSrcLoc( stack.empty() ? 0 : stack.back()->SrcLoc() );
+        item.srcloc = srcloc;
+        item.isReentry = isReentry;
+        item.timeSpan = timeSpan;
+        item.selfSpan = timeSpan - td->childTimeStack.back_and_pop();
+        m_zoneStats[uint16_t( srcloc ) % ZoneStatsShards].push_back( item );
+
         if( !td->childTimeStack.empty() )
         {
             td->childTimeStack.back() += timeSpan;
         }
-
-        auto it = slz->threadCnt.find( ctid );
-        if( it == slz->threadCnt.end() )
-        {
-            slz->threadCnt.emplace( ctid, 1 );
-        }
-        else
-        {
-            it->second++;
-        }
     }
     else
     {
@@ -5358,6 +5880,64 @@ void Worker::ProcessZoneEnd( const QueueZoneEnd& ev )
 #endif
 }
 
+#ifndef TRACY_NO_STATISTICS
+void Worker::FlushZoneStatistics()
+{
+    for( auto& shard : m_zoneStats )
+    {
+        if( shard.empty() ) continue;
+        m_zoneStatsDispatch->Queue( [this, &shard] {
+            // The source location map is not modified while shards are applied, so the lookup
+            // is done here, and not through the cache used by GetSourceLocationZones().
+            int16_t lastSrcloc = 0;
+            SourceLocationZones* slz = nullptr;
+            for( auto& v : shard )
+            {
+                if( !slz || lastSrcloc != v.srcloc )
+                {
+                    auto it = m_data.sourceLocationZones.find( v.srcloc );
+                    assert( it != m_data.sourceLocationZones.end() );
+                    slz = &it->second;
+                    lastSrcloc = v.srcloc;
+                }
+                const auto timeSpan = v.timeSpan;
+                const auto selfSpan = v.selfSpan;
+                slz->zones.push_back( v.ztd );
+                if( slz->min > timeSpan ) slz->min = timeSpan;
+                if( slz->max < timeSpan ) slz->max = timeSpan;
+                slz->total += timeSpan;
+                slz->sumSq += double( timeSpan ) * timeSpan;
+                slz->durations.Add( timeSpan );
+                if( slz->selfMin > selfSpan ) slz->selfMin = selfSpan;
+                if( slz->selfMax < selfSpan ) slz->selfMax = selfSpan;
+                slz->selfTotal += selfSpan;
+
+                if( !v.isReentry )
+                {
+                    slz->nonReentrantCount++;
+                    if( slz->nonReentrantMin > timeSpan ) slz->nonReentrantMin = timeSpan;
+                    if( slz->nonReentrantMax < timeSpan ) slz->nonReentrantMax = timeSpan;
+                    slz->nonReentrantTotal += timeSpan;
+                }
+
+                const auto ctid = v.ztd.Thread();
+                auto it = slz->threadCnt.find( ctid );
+                if( it == slz->threadCnt.end() )
+                {
+                    slz->threadCnt.emplace( ctid, 1 );
+                }
+                else
+                {
+                    it->second++;
+                }
+            }
+            shard.clear();
+        } );
+    }
+    m_zoneStatsDispatch->Sync();
+}
+#endif
+
 void Worker::ZoneStackFailure( uint64_t thread, const ZoneEvent* ev )
 {
     m_failure = Failure::ZoneStack;
@@ -5447,6 +6027,11 @@ void Worker::SourceLocationOverflowFailure()
     m_failure = Failure::SourceLocationOverflow;
 }
 
+void Worker::TimeRangeFailure()
+{
+    m_failure = Failure::TimeRange;
+}
+
 void Worker::ProcessZoneValidation( const QueueZoneValidation& ev )
 {
     auto td = GetCurrentThreadData();
@@ -6019,6 +6604,59 @@ void Worker::ProcessLockSharedRelease( const QueueLockReleaseShared& ev )
     InsertLockEvent( lock, lev, ev.thread, ev.id, time );
 }
 
+void Worker::ProcessLockAggregateWait( const QueueLockAggregate& ev )
+{
+    auto it = m_data.activeLockMap.find( ev.id );
+    if( it == m_data.activeLockMap.end() ) return;
+    auto& stats = it->second->stats;
+    const auto total = TscPeriod( ev.total );
+    const auto max = TscPeriod( ev.max );
+
+    auto& agg = stats.aggregated;
+    agg.waitCount += ev.count;
+    agg.waitTotal += total;
+    if( agg.waitMax < max ) agg.waitMax = max;
+    stats.obtainCount += ev.count;
+    stats.waitTotal += total;
+    if( stats.waitMax < max ) stats.waitMax = max;
+}
+
+void Worker::ProcessLockAggregateHold( const QueueLockAggregate& ev )
+{
+    auto it = m_data.activeLockMap.find( ev.id );
+    if( it == m_data.activeLockMap.end() ) return;
+    auto& stats = it->second->stats;
+    const auto total = TscPeriod( ev.total );
+    const auto max = TscPeriod( ev.max );
+
+    auto& agg = stats.aggregated;
+    agg.holdCount += ev.count;
+    agg.holdTotal += total;
+    if( agg.holdMax < max ) agg.holdMax = max;
+    stats.holdTotal += total;
+    if( stats.holdMax < max ) stats.holdMax = max;
+}
+
+void Worker::ProcessLockAggregateHistogram( const QueueLockAggregateHistogram& ev )
+{
+    auto it = m_data.activeLockMap.find( ev.id );
+    if( it == m_data.activeLockMap.end() ) return;
+    auto& stats = it->second->stats;
+
+    // Client buckets are in timer ticks.
+    const auto bucket = GetLockHistogramBucket( TscPeriod( uint64_t( 1 ) << ev.bucket ) );
+    if( ev.hold )
+    {
+        stats.aggregated.holdHistogram[bucket] += ev.count;
+        stats.holdHistogram[bucket] += ev.count;
+    }
+    else
+    {
+        stats.aggregated.waitHistogram[bucket] += ev.count;
+        stats.waitHistogram[bucket] += ev.count;
+    }
+}
+
 void Worker::ProcessLockMark( const QueueLockMark& ev )
 {
     CheckSourceLocation( ev.srcloc );
@@ -6177,6 +6815,271 @@ void Worker::ProcessPlotConfig( const QueuePlotConfig& ev )
     plot->color = ev.color & 0xFFFFFF;
 }
 
+void Worker::ProcessCounterData( const QueueCounterData& ev )
+{
+    PlotData* plot = m_data.plots.Retrieve( ev.name, [this] ( uint64_t name ) {
+        auto plot = m_slab.AllocInit<PlotData>();
+        plot->name = StringRef( StringRef::Ptr, name );
+        plot->type = PlotType::User;
+        plot->format = PlotValueFormatting::Number;
+        plot->drawType = PlotDrawType::Step;
+        plot->fill = true;
+        plot->color = 0;
+        return plot;
+    }, [this]( uint64_t name ) {
+        Query( ServerQueryPlotName, name );
+    } );
+
+    const auto time = TscTime( RefTime( m_refTimeThread, ev.time ) );
+    if( m_data.lastTime < time ) m_data.lastTime = time;
+
+    // Each thread sends its own partial sum at the end of the same flush window,
+    // possibly after windows of other threads were already added.
+    plot->EnsureSorted();
+    auto& data = plot->data;
+    auto it = std::lower_bound( data.begin(), data.end(), time, [] ( const auto& l, const auto& r ) { return l.time.Val() < r; } );
+    if( it != data.end() && it->time.Val() == time )
+    {
+        UpdatePlot( plot, it - data.begin(), it->val + ev.val );
+    }
+    else
+    {
+        InsertPlot( plot, time, (double)ev.val );
+    }
+}
+
+void Worker::AddHistogramPayload( const char* data, size_t sz )
+{
+    assert( sz >= 24 && ( sz - 24 ) % 6 == 0 );
+    memcpy( &m_pendingHistogram.min, data, 8 );
+    memcpy( &m_pendingHistogram.max, data + 8, 8 );
+    memcpy( &m_pendingHistogram.sum, data + 16, 8 );
+    data += 24;
+
+    const auto num = ( sz - 24 ) / 6;
+    m_pendingHistogram.count = 0;
+    m_pendingHistogram.binCount = uint16_t( num );
+    m_pendingHistogramBins.clear();
+    for( size_t i=0; i<num; i++ )
+    {
+        auto& bin = m_pendingHistogramBins.push_next();
+        memcpy( &bin.idx, data, 2 );
+        memcpy( &bin.count, data + 2, 4 );
+        data += 6;
+        assert( bin.idx < HistogramBuckets );
+        m_pendingHistogram.count += bin.count;
+    }
+}
+
+void Worker::ProcessHistogramData( const QueueHistogramData& ev )
+{
+    CheckString( ev.name );
+
+    HistogramData* hd;
+    auto it = m_data.histogramMap.find( ev.name );
+    if( it == m_data.histogramMap.end() )
+    {
+        hd = CreateHistogram( ev.name );
+    }
+    else
+    {
+        hd = it->second;
+    }
+
+    const auto time = TscTime( RefTime( m_refTimeThread, ev.time ) );
+    if( m_data.lastTime < time ) m_data.lastTime = time;
+    m_pendingHistogram.time = time;
+
+    if( hd->open && hd->pending.time == time )
+    {
+        auto& pending = hd->pending;
+        pending.min = std::min( pending.min, m_pendingHistogram.min );
+        pending.max = std::max( pending.max, m_pendingHistogram.max );
+        pending.sum += m_pendingHistogram.sum;
+        pending.count += m_pendingHistogram.count;
+        for( auto& v : m_pendingHistogramBins ) hd->pendingBins[v.idx] += v.count;
+    }
+    else if( !hd->open || hd->pending.time < time )
+    {
+        if( hd->open ) CloseHistogramWindow( *hd );
+        hd->open = true;
+        hd->pending = m_pendingHistogram;
+        memset( hd->pendingBins, 0, sizeof( hd->pendingBins ) );
+        for( auto& v : m_pendingHistogramBins ) hd->pendingBins[v.idx] += v.count;
+    }
+    else
+    {
+        // Thread that was late to flush an already closed window.
+        auto it = std::lower_bound( hd->snapshots.begin(), hd->snapshots.end(), time, [] ( const auto& l, const auto& r ) { return l.time < r; } );
+        if( it != hd->snapshots.end() && it->time == time )
+        {
+            MergeHistogramSnapshot( *hd, *it, m_pendingHistogram, m_pendingHistogramBins.data() );
+        }
+        else
+        {
+            StoreHistogramSnapshot( *hd, m_pendingHistogram, m_pendingHistogramBins.data() );
+        }
+    }
+}
+
+HistogramData* Worker::CreateHistogram( uint64_t name )
+{
+    static const uint32_t colors[HistogramData::NumPlots] = { 0x44BB44, 0xDDBB22, 0xDD6622, 0xCC2222 };
+
+    auto hd = m_slab.AllocInit<HistogramData>();
+    hd->name = name;
+    hd->open = false;
+
+    PlotData* prev = nullptr;
+    for( int i=0; i<HistogramData::NumPlots; i++ )
+    {
+        auto plot = m_slab.AllocInit<PlotData>();
+        plot->name = StringRef( StringRef::Ptr, name );
+        plot->type = PlotType::Histogram;
+        plot->format = PlotValueFormatting::Number;
+        plot->drawType = PlotDrawType::Line;
+        plot->fill = false;
+        plot->color = colors[i];
+        if( prev ) prev->nextPlot = plot;
+        else hd->plot = plot;
+        prev = plot;
+    }
+
+    m_data.histogramMap.emplace( name, hd );
+    m_data.histograms.push_back( hd );
+    m_data.plots.AddExternal( hd->plot );
+    return hd;
+}
+
+void Worker::CloseHistogramWindow( HistogramData& hd )
+{
+    assert( hd.open );
+    hd.open = false;
+
+    HistogramBin bins[HistogramBuckets];
+    hd.pending.binCount = CompactHistogramBins( hd.pendingBins, bins );
+    StoreHistogramSnapshot( hd, hd.pending, bins );
+}
+
+void Worker::StoreHistogramSnapshot( HistogramData& hd, HistogramSnapshot snapshot, const HistogramBin* bins )
+{
+    snapshot.binStart = hd.bins.size();
+    for( uint16_t i=0; i<snapshot.binCount; i++ ) hd.bins.push_back( bins[i] );
+
+    if( hd.snapshots.empty() || hd.snapshots.back().time <= snapshot.time )
+    {
+        hd.snapshots.push_back( snapshot );
+    }
+    else
+    {
+        auto it = std::upper_bound( hd.snapshots.begin(), hd.snapshots.end(), snapshot.time, [] ( const auto& l, const auto& r ) { return l < r.time; } );
+        hd.snapshots.insert( it, snapshot );
+    }
+
+    if( snapshot.count == 0 ) return;
+
+    double vals[HistogramData::NumPlots];
+    GetHistogramPlotValues( snapshot, bins, vals );
+    auto plot = hd.plot;
+    for( auto v : vals )
+    {
+        InsertPlot( plot, snapshot.time, v );
+        plot = plot->nextPlot;
+    }
+}
+
+void Worker::MergeHistogramSnapshot( HistogramData& hd, HistogramSnapshot& dst, const HistogramSnapshot& src, const HistogramBin* bins )
+{
+    // Both bin lists are sorted by bucket.
+    HistogramBin merged[HistogramBuckets];
+    uint16_t num = 0;
+    auto a = hd.bins.data() + dst.binStart;
+    const auto ae = a + dst.binCount;
+    auto b = bins;
+    const auto be = bins + src.binCount;
+    while( a != ae || b != be )
+    {
+        if( b == be || ( a != ae && a->idx < b->idx ) )
+        {
+            merged[num++] = *a++;
+        }
+        else if( a == ae || b->idx < a->idx )
+        {
+            merged[num++] = *b++;
+        }
+        else
+        {
+            merged[num++] = { a->idx, a->count + b->count };
+            a++;
+            b++;
+        }
+    }
+
+    // Bins of a window are kept together, a window that gained bins is moved to the end.
+    if( num != dst.binCount )
+    {
+        dst.binStart = hd.bins.size();
+        for( uint16_t i=0; i<num; i++ ) hd.bins.push_back( merged[i] );
+    }
+    else
+    {
+        memcpy( hd.bins.data() + dst.binStart, merged, sizeof( HistogramBin ) * num );
+    }
+    dst.binCount = num;
+    dst.min = std::min( dst.min, src.min );
+    dst.max = std::max( dst.max, src.max );
+    dst.sum += src.sum;
+    dst.count += src.count;
+
+    double vals[HistogramData::NumPlots];
+    GetHistogramPlotValues( dst, merged, vals );
+    auto plot = hd.plot;
+    for( auto v : vals )
+    {
+        plot->EnsureSorted();
+        auto& data = plot->data;
+        auto it = std::lower_bound( data.begin(), data.end(), dst.time, [] ( const auto& l, const auto& r ) { return l.time.Val() < r; } );
+        if( it != data.end() && it->time.Val() == dst.time )
+        {
+            UpdatePlot( plot, it - data.begin(), v );
+        }
+        else
+        {
+            InsertPlot( plot, dst.time, v );
+        }
+        plot = plot->nextPlot;
+    }
+}
+
+uint16_t Worker::CompactHistogramBins( const uint32_t* dense, HistogramBin* bins )
+{
+    uint16_t num = 0;
+    for( uint16_t i=0; i<HistogramBuckets; i++ )
+    {
+        if( dense[i] != 0 ) bins[num++] = { i, dense[i] };
+    }
+    return num;
+}
+
+// p50, p90 and p99 are bin midpoints clamped to the exact extremes seen in the window, followed by max.
+void Worker::GetHistogramPlotValues( const HistogramSnapshot& snapshot, const HistogramBin* bins, double* vals )
+{
+    assert( snapshot.count != 0 );
+    static const double quantiles[HistogramData::NumPlots-1] = { 0.5, 0.9, 0.99 };
+    uint64_t acc = 0;
+    uint16_t bin = 0;
+    for( auto q : quantiles )
+    {
+        const auto target = std::max<uint64_t>( 1, uint64_t( ceil( q * snapshot.count ) ) );
+        while( bin < snapshot.binCount - 1 && acc + bins[bin].count < target ) acc += bins[bin++].count;
+        const auto idx = bins[bin].idx;
+        const auto lo = (double)HistogramBucketValue( idx );
+        const auto hi = idx + 1 < HistogramBuckets ? (double)HistogramBucketValue( idx + 1 ) : lo;
+        *vals++ = std::clamp( ( lo + hi ) * 0.5, (double)snapshot.min, (double)snapshot.max );
+    }
+    *vals = (double)snapshot.max;
+}
+
 void Worker::ProcessMessage( const QueueMessage& ev )
 {
     auto td = GetCurrentThreadData();
@@ -6640,6 +7543,7 @@ MemEvent* Worker::ProcessMemAllocImpl( MemData& memdata, const QueueMemAlloc& ev
     mem.SetTimeThreadFree( -1, 0 );
     mem.SetCsAlloc( 0 );
     mem.csFree.SetVal( 0 );
+    memdata.freeIndex.Update( memdata.data.data(), memdata.data.size() );
 
     const auto low = memdata.low;
     const auto high = memdata.high;
@@ -6677,6 +7581,8 @@ MemEvent* Worker::ProcessMemFreeImpl( MemData& memdata, const QueueMemFree& ev )
     memdata.frees.push_back( it->second );
     auto& mem = memdata.data[it->second];
     mem.SetTimeThreadFree( time, CompressThread( ev.thread ) );
+    memdata.freeIndex.Freed( it->second );
+    memdata.CountFree( mem );
     memdata.usage -= mem.Size();
     memdata.active.erase( it );
 
@@ -6730,7 +7636,11 @@ void Worker::ProcessMemAllocCallstack( const QueueMemAlloc& ev )
 {
     auto mem = ProcessMemAlloc( ev );
     assert( m_serialNextCallstack != 0 );
-    if( mem ) mem->SetCsAlloc( m_serialNextCallstack );
+    if( mem )
+    {
+        mem->SetCsAlloc( m_serialNextCallstack );
+        m_data.memory->CountAlloc( *mem );
+    }
     m_serialNextCallstack = 0;
 }
 
@@ -6748,7 +7658,11 @@ void Worker::ProcessMemAllocCallstackNamed( const QueueMemAlloc& ev )
     }
     auto mem = ProcessMemAllocImpl( *it->second, ev );
     assert( m_serialNextCallstack != 0 );
-    if( mem ) mem->SetCsAlloc( m_serialNextCallstack );
+    if( mem )
+    {
+        mem->SetCsAlloc( m_serialNextCallstack );
+        it->second->CountAlloc( *mem );
+    }
     m_serialNextCallstack = 0;
 }
 
@@ -7269,6 +8183,7 @@ void Worker::ProcessSysTime( const QueueSysTime& ev )
         m_sysTimePlot->max = val;
         m_sysTimePlot->sum = val;
         m_sysTimePlot->data.push_back( { time, val } );
+        m_sysTimePlot->UpdateLod();
         m_data.plots.Data().push_back( m_sysTimePlot );
     }
     else
@@ -7279,6 +8194,7 @@ void Worker::ProcessSysTime( const QueueSysTime& ev )
         else if( m_sysTimePlot->max < val ) m_sysTimePlot->max = val;
         m_sysTimePlot->sum += val;
         m_sysTimePlot->data.push_back( { time, val } );
+        m_sysTimePlot->UpdateLod();
     }
 }
 
@@ -7511,6 +8427,16 @@ void Worker::ProcessSourceCodeNotAvailable( const QueueSourceCodeNotAvailable& e
     m_sourceCodeQuery.erase( it );
 }
 
+void Worker::ProcessServerQueryBatchAck( const QueueServerQueryBatchAck& ev )
+{
+    auto& sent = m_serverQueryBatchTime[ev.seq % 64];
+    if( sent.seq != ev.seq ) return;
+    const auto now = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    const auto rtt = std::max<int64_t>( now - sent.time, 1 );
+    m_serverQueryRtt = m_serverQueryRtt == 0 ? rtt : ( m_serverQueryRtt * 7 + rtt ) / 8;
+    m_serverQueryRttMin = m_serverQueryRttMin == 0 ? rtt : std::min( m_serverQueryRttMin, rtt );
+}
+
 void Worker::ProcessCpuTopology( const QueueCpuTopology& ev )
 {
     auto package = m_data.cpuTopology.find( ev.package );
@@ -7618,6 +8544,7 @@ void Worker::MemAllocChanged( MemData& memdata, int64_t time )
         memdata.plot->max = val;
         memdata.plot->sum = val;
         memdata.plot->data.push_back( { time, val } );
+        memdata.plot->UpdateLod();
     }
     else
     {
@@ -7627,6 +8554,7 @@ void Worker::MemAllocChanged( MemData& memdata, int64_t time )
         else if( memdata.plot->max < val ) memdata.plot->max = val;
         memdata.plot->sum += val;
         memdata.plot->data.push_back( { time, val } );
+        memdata.plot->UpdateLod();
     }
 }
 
@@ -7748,6 +8676,7 @@ void Worker::ReconstructMemAllocPlot( MemData& mem )
     plot->min = 0;
     plot->max = max;
     plot->sum = sum;
+    plot->UpdateLod();
 
     std::lock_guard<std::mutex> lock( m_data.lock );
     m_data.plots.Data().insert( m_data.plots.Data().begin(), plot );
@@ -7850,6 +8779,156 @@ void Worker::ReconstructContextSwitchUsage()
     m_data.ctxUsageReady = true;
 }
 
+static int64_t GetLockWaitOverlap( const std::vector<std::pair<int64_t, int64_t>>* waits, int64_t start, int64_t end )
+{
+    if( !waits ) return 0;
+    int64_t ret = 0;
+    auto it = std::lower_bound( waits->begin(), waits->end(), start, [] ( const auto& l, const auto& r ) { return l.second < r; } );
+    while( it != waits->end() && it->first < end )
+    {
+        const auto s = std::max( it->first, start );
+        const auto e = std::min( it->second, end );
+        if( e > s ) ret += e - s;
+        ++it;
+    }
+    return std::min( ret, end - start );
+}
+
+void Worker::ReconstructZoneOffCpuTime()
+{
+    struct OffCpuTime
+    {
+        int64_t onCpu;
+        int64_t preempted;
+        int64_t lockWait;
+        int64_t otherWait;
+    };
+
+    unordered_flat_map<uint64_t, std::vector<std::pair<int64_t, int64_t>>> lockWaits;
+    for( auto& lm : m_data.lockMap )
+    {
+        auto& l = *lm.second;
+        if( !l.valid ) continue;
+        int64_t waitStart[MaxLockThreads];
+        std::fill( waitStart, waitStart + MaxLockThreads, -1 );
+        for( auto& v : l.timeline )
+        {
+            const auto& ev = *v.ptr;
+            switch( ev.type )
+            {
+            case LockEvent::Type::Wait:
+            case LockEvent::Type::WaitShared:
+                waitStart[ev.thread] = ev.Time();
+                break;
+            case LockEvent::Type::Obtain:
+            case LockEvent::Type::ObtainShared:
+                if( waitStart[ev.thread] >= 0 )
+                {
+                    lockWaits[l.threadList[ev.thread]].emplace_back( waitStart[ev.thread], ev.Time() );
+                    waitStart[ev.thread] = -1;
+                }
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    for( auto& v : lockWaits ) pdqsort_branchless( v.second.begin(), v.second.end() );
+
+    unordered_flat_map<int16_t, OffCpuTime> srclocTime;
+    for( auto& t : m_data.threads )
+    {
+        if( m_shutdown.load( std::memory_order_relaxed ) ) return;
+        if( t->timeline.empty() ) continue;
+        auto cit = m_data.ctxSwitch.find( t->id );
+        if( cit == m_data.ctxSwitch.end() ) continue;
+        const auto& ctx = cit->second->v;
+        if( ctx.empty() ) continue;
+        auto lit = lockWaits.find( t->id );
+        const auto waits = lit != lockWaits.end() ? &lit->second : nullptr;
+
+        auto AddBlocked = [waits] ( OffCpuTime& time, int64_t start, int64_t end ) {
+            if( end <= start ) return;
+            const auto lock = GetLockWaitOverlap( waits, start, end );
+            time.lockWait += lock;
+            time.otherWait += end - start - lock;
+        };
+
+        std::function<void(const Vector<short_ptr<ZoneEvent>>&)> ProcessTimeline;
+        ProcessTimeline = [&] ( const Vector<short_ptr<ZoneEvent>>& _vec )
+        {
+            if( m_shutdown.load( std::memory_order_relaxed ) ) return;
+            assert( _vec.is_magic() );
+            auto& vec = *(const Vector<ZoneEvent>*)( &_vec );
+            for( auto& zone : vec )
+            {
+                if( zone.IsEndValid() )
+                {
+                    const auto zs = zone.Start();
+                    const auto ze = zone.End();
+                    auto& time = srclocTime.emplace( zone.SrcLoc(), OffCpuTime {} ).first->second;
+
+                    auto it = std::lower_bound( ctx.begin(), ctx.end(), zs, [] ( const auto& l, const auto& r ) { return (uint64_t)l.End() < (uint64_t)r; } );
+                    auto pos = zs;
+                    while( it != ctx.end() && it->Start() < ze && it->Reason() != ContextSwitchData::Wakeup )
+                    {
+                        const auto rs = std::max( it->Start(), zs );
+                        if( rs > pos )
+                        {
+                            // Off-CPU gap before this slice. The part between wakeup and being
+                            // scheduled is spent waiting for a CPU.
+                            const auto wake = it->WakeupVal();
+                            if( wake < it->Start() )
+                            {
+                                const auto ws = std::min( std::max( wake, pos ), rs );
+                                AddBlocked( time, pos, ws );
+                                time.preempted += rs - ws;
+                            }
+                            else if( it != ctx.begin() && IsPreemptedState( (it-1)->State() ) )
+                            {
+                                time.preempted += rs - pos;
+                            }
+                            else
+                            {
+                                AddBlocked( time, pos, rs );
+                            }
+                        }
+                        const auto re = it->IsEndValid() ? std::min( it->End(), ze ) : ze;
+                        if( re > rs ) time.onCpu += re - rs;
+                        pos = std::max( pos, re );
+                        ++it;
+                    }
+                    if( pos < ze )
+                    {
+                        if( it != ctx.begin() && IsPreemptedState( (it-1)->State() ) )
+                        {
+                            time.preempted += ze - pos;
+                        }
+                        else
+                        {
+                            AddBlocked( time, pos, ze );
+                        }
+                    }
+                }
+                if( zone.HasChildren() ) ProcessTimeline( GetZoneChildren( zone.Child() ) );
+            }
+        };
+        ProcessTimeline( t->timeline );
+    }
+
+    std::lock_guard<std::mutex> lock( m_data.lock );
+    for( auto& v : srclocTime )
+    {
+        auto it = m_data.sourceLocationZones.find( v.first );
+        if( it == m_data.sourceLocationZones.end() ) continue;
+        it->second.onCpuTotal = v.second.onCpu;
+        it->second.preemptedTotal = v.second.preempted;
+        it->second.lockWaitTotal = v.second.lockWait;
+        it->second.otherWaitTotal = v.second.otherWait;
+    }
+    m_data.zoneOffCpuReady = true;
+}
+
 bool Worker::UpdateSampleStatistics( uint32_t callstack, uint32_t count, bool canPostpone )
 {
     const auto& cs = GetCallstack( callstack );
@@ -8091,10 +9170,92 @@ int64_t Worker::ReadTimelineHaveSize( FileRead& f, ZoneEvent* zone, int64_t refT
         const auto idx = childIdx;
         childIdx++;
         zone->SetChild( idx );
-        return ReadTimeline( f, m_data.zoneChildren[idx], sz, refTime, childIdx, maxd, level + 1 );
+        const auto ret = ReadTimeline( f, m_data.zoneChildren[idx], sz, refTime, childIdx, maxd, level + 1 );
+        m_data.zoneChildrenDepth[idx] = CalcZoneChildrenDepth( m_data.zoneChildren[idx] );
+        if( sz >= ZoneLod::MinZones ) ExtendZoneLod( m_data.zoneChildrenLod[idx], m_data.zoneChildren[idx] );
+        return ret;
     }
 }
 
+#ifndef TRACY_NO_STATISTICS
+void Worker::BuildZoneIndex( ZoneIndex& index, const Vector<short_ptr<ZoneEvent>>& vec, int depth )
+{
+    if( vec.is_magic() )
+    {
+        for( auto& v : *(const Vector<ZoneEvent>*)( &vec ) )
+        {
+            index.Add( &v, depth );
+            if( v.HasChildren() ) BuildZoneIndex( index, m_data.zoneChildren[v.Child()], depth + 1 );
+        }
+    }
+    else
+    {
+        for( auto& v : vec )
+        {
+            index.Add( v, depth );
+            if( v->HasChildren() ) BuildZoneIndex( index, m_data.zoneChildren[v->Child()], depth + 1 );
+        }
+    }
+}
+#endif
+
+const ZoneLod* Worker::GetZoneChildrenLod( int32_t idx ) const
+{
+    if( m_data.zoneChildren[idx].size() < ZoneLod::MinZones ) return nullptr;
+    auto it = m_data.zoneChildrenLod.find( idx );
+    return it == m_data.zoneChildrenLod.end() ? nullptr : &it->second;
+}
+
+// The zone which has just ended is already popped from the stack and is the last one of its level.
+void Worker::UpdateZoneLod( ThreadData* td, const Vector<short_ptr<ZoneEvent>>& stack )
+{
+    if( stack.empty() )
+    {
+        if( td->timeline.size() >= ZoneLod::MinZones ) ExtendZoneLod( td->timelineLod, td->timeline );
+    }
+    else
+    {
+        const auto child = stack.back()->Child();
+        const auto& vec = m_data.zoneChildren[child];
+        if( vec.size() >= ZoneLod::MinZones ) ExtendZoneLod( m_data.zoneChildrenLod[child], vec );
+    }
+}
+
+void Worker::ExtendZoneLod( ZoneLod& lod, const Vector<short_ptr<ZoneEvent>>& vec )
+{
+    auto idx = lod.size();
+    if( vec.is_magic() )
+    {
+        const auto& v = *(const Vector<ZoneEvent>*)( &vec );
+        for( ; idx<v.size() && v[idx].IsEndValid(); idx++ ) lod.Add( idx == 0 ? -1 : v[idx].End() - v[idx-1].End() );
+    }
+    else
+    {
+        for( ; idx<vec.size() && vec[idx]->IsEndValid(); idx++ ) lod.Add( idx == 0 ? -1 : vec[idx]->End() - vec[idx-1]->End() );
+    }
+}
+
+uint16_t Worker::CalcZoneChildrenDepth( const Vector<short_ptr<ZoneEvent>>& vec ) const
+{
+    int depth = 0;
+    if( vec.is_magic() )
+    {
+        for( auto& v : *(const Vector<ZoneEvent>*)( &vec ) )
+        {
+            if( v.HasChildren() ) depth = std::max<int>( depth, m_data.zoneChildrenDepth[v.Child()] );
+        }
+    }
+    else
+    {
+        for( auto& v : vec )
+        {
+            if( v->HasChildren() ) depth = std::max<int>( depth, m_data.zoneChildrenDepth[v->Child()] );
+        }
+    }
+    // Saturates, callers treat the largest value as a lower bound and walk the zones instead.
+    return uint16_t( std::min( depth + 1, (int)std::numeric_limits<uint16_t>::max() ) );
+}
+
 void Worker::ReadTimeline( FileRead& f, GpuEvent* zone, int64_t& refTime, int64_t& refGpuTime, int32_t& childIdx, int32_t& maxd, int32_t level )
 {
     uint64_t sz;
@@ -8118,7 +9279,7 @@ void Worker::ReadTimelineHaveSize( FileRead& f, GpuEvent* zone, int64_t& refTime
 }
 
 #ifndef TRACY_NO_STATISTICS
-void Worker::ReconstructZoneStatistics( uint8_t* countMap, ZoneEvent& zone, uint16_t thread )
+void Worker::ReconstructZoneStatistics( uint8_t* countMap, ZoneEvent& zone, uint16_t thread, int16_t parentSrcLoc )
 {
     assert( zone.IsEndValid() );
     auto timeSpan = zone.End() - zone.Start();
@@ -8130,6 +9291,7 @@ void Worker::ReconstructZoneStatistics( uint8_t* countMap, ZoneEvent& zone, uint
         ZoneThreadData ztd;
         ztd.SetZone( &zone );
         ztd.SetThread( thread );
+        ztd.SetParentSrcLoc( parentSrcLoc );
 
         auto& slz = it->second;
         slz.zones.push_back( ztd );
@@ -8137,6 +9299,7 @@ void Worker::ReconstructZoneStatistics( uint8_t* countMap, ZoneEvent& zone, uint
         if( slz.max < timeSpan ) slz.max = timeSpan;
         slz.total += timeSpan;
         slz.sumSq += double( timeSpan ) * timeSpan;
+        slz.durations.Add( timeSpan );
 
         if( countMap[uint16_t(zone.SrcLoc())] == 0 )
         {
@@ -8544,6 +9707,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
             f.Write( &lev.ptr->thread, sizeof( lev.ptr->thread ) );
             f.Write( &lev.ptr->type, sizeof( lev.ptr->type ) );
         }
+        f.Write( &v.second->stats.aggregated, sizeof( v.second->stats.aggregated ) );
     }
 
     {
@@ -8644,11 +9808,11 @@ void Worker::Write( FileWrite& f, bool fiDict )
     }
 
     sz = m_data.plots.Data().size();
-    for( auto& plot : m_data.plots.Data() ) { if( ( plot->type == PlotType::Memory || plot->type == PlotType::Zone ) ) sz--; }
+    for( auto& plot : m_data.plots.Data() ) { if( ( plot->type == PlotType::Memory || plot->type == PlotType::Zone || plot->type == PlotType::Histogram ) ) sz--; }
     f.Write( &sz, sizeof( sz ) );
     for( auto& plot : m_data.plots.Data() )
     {
-        if( ( plot->type == PlotType::Memory || plot->type == PlotType::Zone ) ) continue;
+        if( ( plot->type == PlotType::Memory || plot->type == PlotType::Zone || plot->type == PlotType::Histogram ) ) continue;
         f.Write( &plot->type, sizeof( plot->type ) );
         f.Write( &plot->format, sizeof( plot->format ) );
         f.Write( &plot->drawType, sizeof( plot->drawType ) );
@@ -8668,6 +9832,35 @@ void Worker::Write( FileWrite& f, bool fiDict )
         }
     }
 
+    // Percentile plots are rebuilt from the snapshots on load. A window that is still
+    // open is newer than all closed ones, and is written as the last snapshot.
+    sz = m_data.histograms.size();
+    f.Write( &sz, sizeof( sz ) );
+    for( auto& hd : m_data.histograms )
+    {
+        f.Write( &hd->name, sizeof( hd->name ) );
+        sz = hd->snapshots.size() + ( hd->open ? 1 : 0 );
+        f.Write( &sz, sizeof( sz ) );
+        int64_t refTime = 0;
+        auto WriteSnapshot = [&f, &refTime] ( const HistogramSnapshot& v, const HistogramBin* bins ) {
+            WriteTimeOffset( f, refTime, v.time );
+            f.Write( &v.min, sizeof( v.min ) );
+            f.Write( &v.max, sizeof( v.max ) );
+            f.Write( &v.sum, sizeof( v.sum ) );
+            f.Write( &v.count, sizeof( v.count ) );
+            f.Write( &v.binCount, sizeof( v.binCount ) );
+            f.Write( bins, sizeof( HistogramBin ) * v.binCount );
+        };
+        for( auto& v : hd->snapshots ) WriteSnapshot( v, hd->bins.data() + v.binStart );
+        if( hd->open )
+        {
+            HistogramBin bins[HistogramBuckets];
+            auto pending = hd->pending;
+            pending.binCount = CompactHistogramBins( hd->pendingBins, bins );
+            WriteSnapshot( pending, bins );
+        }
+    }
+
     sz = m_data.memNameMap.size();
     f.Write( &sz, sizeof( sz ) );
     sz = 0;
@@ -9038,6 +10231,7 @@ static const char* s_failureReasons[] = {
     "Multiple frame images were sent for a single frame.",
     "Fiber execution stopped on a thread which is not executing a fiber.",
     "Too many source locations. You cannot have more than 32K static or dynamic source locations.",
+    "Profiling session is too long. It cannot be longer than 2^55 ns (417 days).",
 };
 
 static_assert( sizeof( s_failureReasons ) / sizeof( *s_failureReasons ) == (int)Worker::Failure::NUM_FAILURES, "Missing failure reason description." );
@@ -9250,8 +10444,10 @@ void Worker::CreateZonesFromGpuDataImpl( const V &vec, uint64_t gpuThreadId )
         auto zone = stack.back_and_pop();
         const auto isReentry = m_threadCtxData->DecStackCount( zone->SrcLoc() );
         zone->SetEnd( gpuEvent.GpuEnd() );
+        UpdateZoneLod( m_threadCtxData, stack );
 
 #ifndef TRACY_NO_STATISTICS
+        m_threadCtxData->zoneIndex.Close();
         assert( !m_threadCtxData->childTimeStack.empty() );
         const auto timeSpan = gpuEvent.GpuEnd() - gpuEvent.GpuStart();
         if ( timeSpan > 0 )
@@ -9259,12 +10455,14 @@ void Worker::CreateZonesFromGpuDataImpl( const V &vec, uint64_t gpuThreadId )
             ZoneThreadData ztd;
             ztd.SetZone( zone );
             ztd.SetThread( CompressThread( gpuThreadId ) );
+            ztd.SetParentSrcLoc( stack.empty() ? 0 : stack.back()->SrcLoc() );
             auto slz = GetSourceLocationZones( zone->SrcLoc() );
             slz->zones.push_back( ztd );
             if ( slz->min > timeSpan ) slz->min = timeSpan;
             if ( slz->max < timeSpan ) slz->max = timeSpan;
             slz->total += timeSpan;
             slz->sumSq += double( timeSpan ) * timeSpan;
+            slz->durations.Add( timeSpan );
             const auto selfSpan = timeSpan - m_threadCtxData->childTimeStack.back_and_pop();
             if ( slz->selfMin > selfSpan ) slz->selfMin = selfSpan;
             if ( slz->selfMax < selfSpan ) slz->selfMax = selfSpan;
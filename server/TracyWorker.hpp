@@ -4,6 +4,7 @@
 #include <atomic>
 #include <condition_variable>
 #include <limits>
+#include <memory>
 #include <mutex>
 #include <shared_mutex>
 #include <stdexcept>
@@ -32,6 +33,7 @@ namespace tracy
 
 class FileRead;
 class FileWrite;
+class TaskDispatch;
 
 namespace EventType
 {
@@ -123,15 +125,21 @@ public:
         std::vector<std::pair<int64_t, double>> data;
     };
 
+#pragma pack( push, 1 )
     struct ZoneThreadData
     {
         tracy_force_inline ZoneEvent* Zone() const { return (ZoneEvent*)( _zone_thread >> 16 ); }
         tracy_force_inline void SetZone( ZoneEvent* zone ) { assert( ( uint64_t( zone ) & 0xFFFF000000000000 ) == 0 ); memcpy( ((char*)&_zone_thread)+2, &zone, 4 ); memcpy( ((char*)&_zone_thread)+6, ((char*)&zone)+4, 2 ); }
         tracy_force_inline uint16_t Thread() const { return uint16_t( _zone_thread & 0xFFFF ); }
         tracy_force_inline void SetThread( uint16_t thread ) { memcpy( &_zone_thread, &thread, 2 ); }
+        // Source location of the enclosing zone, 0 for top level zones. Source location 0 is never used by zones.
+        tracy_force_inline int16_t ParentSrcLoc() const { return _parent_srcloc; }
+        tracy_force_inline void SetParentSrcLoc( int16_t srcloc ) { _parent_srcloc = srcloc; }
 
         uint64_t _zone_thread;
+        int16_t _parent_srcloc;
     };
+#pragma pack( pop )
     enum { ZoneThreadDataSize = sizeof( ZoneThreadData ) };
 
     struct GpuZoneThreadData
@@ -212,7 +220,12 @@ private:
         int64_t nonReentrantMin = std::numeric_limits<int64_t>::max();
         int64_t nonReentrantMax = std::numeric_limits<int64_t>::min();
         int64_t nonReentrantTotal = 0;
+        int64_t onCpuTotal = 0;
+        int64_t preemptedTotal = 0;
+        int64_t lockWaitTotal = 0;
+        int64_t otherWaitTotal = 0;
         unordered_flat_map<uint16_t, uint64_t> threadCnt;
+        DurationSketch durations;
     };
 
     struct GpuSourceLocationZones
@@ -283,6 +296,8 @@ private:
         Vector<GpuCtxData*> gpuData;
         Vector<short_ptr<MessageData>> messages;
         StringDiscovery<PlotData*> plots;
+        Vector<HistogramData*> histograms;
+        unordered_flat_map<uint64_t, HistogramData*> histogramMap;
         Vector<ThreadData*> threads;
         Vector<ZoneExtra> zoneExtra;
         MemData* memory;
@@ -327,6 +342,9 @@ private:
         unordered_flat_map<uint64_t, SymbolStats> symbolStats;
         Vector<SymbolLocation> symbolLoc;
         Vector<uint64_t> symbolLocInline;
+        EytzingerIndex symbolLocIndex;
+        EytzingerIndex symbolLocInlineIndex;
+        size_t symbolLocLastHit = 0;
         int64_t newSymbolsIndex = -1;
         int64_t newInlineSymbolsIndex = -1;
         unordered_flat_map<uint64_t, uint64_t> codeSymbolMap;
@@ -357,6 +375,8 @@ private:
         ThreadCompress externalThreadCompress;
 
         Vector<Vector<short_ptr<ZoneEvent>>> zoneChildren;
+        Vector<uint16_t> zoneChildrenDepth;     // nesting levels below, 0 if not known yet
+        unordered_flat_map<int32_t, ZoneLod> zoneChildrenLod;
         Vector<Vector<short_ptr<GpuEvent>>> gpuChildren;
 #ifndef TRACY_NO_STATISTICS
         Vector<Vector<GhostZone>> ghostChildren;
@@ -393,6 +413,7 @@ private:
 #ifndef TRACY_NO_STATISTICS
         Vector<ContextSwitchUsage> ctxUsage;
         bool ctxUsageReady = false;
+        bool zoneOffCpuReady = false;
 #endif
 
         unordered_flat_map<uint32_t, unordered_flat_map<uint32_t, std::vector<uint32_t>>> cpuTopology;
@@ -415,13 +436,40 @@ private:
 
     struct MbpsBlock
     {
-        MbpsBlock() : mbps( 64 ), compRatio( 1.0 ), queue( 0 ), transferred( 0 ) {}
+        MbpsBlock() : mbps( 64 ), compRatio( 1.0 ), queue( 0 ), transferred( 0 ), queryWindow( 0 ), queryRtt( 0 ) {}
 
         std::shared_mutex lock;
         std::vector<float> mbps;
         float compRatio;
         size_t queue;
         uint64_t transferred;
+        size_t queryWindow;
+        int64_t queryRtt;
+    };
+
+    struct QueryBatchTime
+    {
+        uint32_t seq;
+        int64_t time;
+    };
+
+    enum { SampleChunkSize = 256 * 1024 };
+
+    struct SampleChunk
+    {
+        ThreadData* thread;
+        uint16_t tid;
+        size_t begin, end;
+    };
+
+    // Ghost zone construction state. Live captures use the shared one, on load every thread
+    // builds into its own children and frame dictionary, which are merged afterwards.
+    struct GhostContext
+    {
+        Vector<InlineStackData>& inlineStack;
+        Vector<Vector<GhostZone>>& children;
+        Vector<GhostKey>& frames;
+        unordered_flat_map<GhostKey, uint32_t, GhostKeyHasher, GhostKeyComparator>& framesMap;
     };
 
     struct FailureData
@@ -455,6 +503,7 @@ public:
         FrameImageTwice,
         FiberLeave,
         SourceLocationOverflow,
+        TimeRange,
 
         NUM_FAILURES
     };
@@ -548,6 +597,7 @@ public:
     const Vector<short_ptr<MessageData>>& GetMessages() const { return m_data.messages; }
     const Vector<GpuCtxData*>& GetGpuData() const { return m_data.gpuData; }
     const Vector<PlotData*>& GetPlots() const { return m_data.plots.Data(); }
+    const Vector<HistogramData*>& GetHistograms() const { return m_data.histograms; }
     const Vector<ThreadData*>& GetThreadData() const { return m_data.threads; }
     const ThreadData* GetThreadData( uint64_t tid ) const;
     const MemData& GetMemoryNamed( uint64_t name ) const;
@@ -607,6 +657,8 @@ public:
     const char* GetZoneName( const GpuEvent& ev ) const;
 
     tracy_force_inline const Vector<short_ptr<ZoneEvent>>& GetZoneChildren( int32_t idx ) const { return m_data.zoneChildren[idx]; }
+    tracy_force_inline int GetZoneChildrenDepth( int32_t idx ) const { return m_data.zoneChildrenDepth[idx]; }
+    const ZoneLod* GetZoneChildrenLod( int32_t idx ) const;
     tracy_force_inline const Vector<short_ptr<GpuEvent>>& GetGpuChildren( int32_t idx ) const { return m_data.gpuChildren[idx]; }
 #ifndef TRACY_NO_STATISTICS
     tracy_force_inline const Vector<GhostZone>& GetGhostChildren( int32_t idx ) const { return m_data.ghostChildren[idx]; }
@@ -631,6 +683,7 @@ public:
     bool AreSourceLocationZonesReady() const { return m_data.sourceLocationZonesReady; }
     bool AreGpuSourceLocationZonesReady() const { return m_data.gpuSourceLocationZonesReady; }
     bool IsCpuUsageReady() const { return m_data.ctxUsageReady; }
+    bool AreZoneOffCpuTimesReady() const { return m_data.zoneOffCpuReady; }
     const Vector<ContextSwitchUsage>& GetCpuUsage() const { return m_data.ctxUsage; }
 
     const unordered_flat_map<uint64_t, SymbolStats>& GetSymbolStats() const { return m_data.symbolStats; }
@@ -652,6 +705,8 @@ public:
     float GetCompRatio() const { return m_mbpsData.compRatio; }
     size_t GetSendQueueSize() const { return m_mbpsData.queue; }
     size_t GetSendInFlight() const { return m_serverQuerySpaceBase - m_serverQuerySpaceLeft; }
+    size_t GetQueryWindow() const { return m_mbpsData.queryWindow; }
+    int64_t GetQueryRtt() const { return m_mbpsData.queryRtt; }
     uint64_t GetDataTransferred() const { return m_mbpsData.transferred; }
 
     bool HasData() const { return m_hasData.load( std::memory_order_acquire ); }
@@ -671,6 +726,7 @@ public:
     bool AreSamplesInconsistent() const { return m_inconsistentSamples; }
 
     static const LoadProgress& GetLoadProgress() { return s_loadProgress; }
+    const LoadProgress& GetSampleProgress() const { return m_sampleProgress; }
     int64_t GetLoadTime() const { return m_loadTime; }
 
     void ClearFailure() { m_failure = Failure::None; }
@@ -689,6 +745,7 @@ public:
     std::pair<uint64_t, uint64_t> GetTextureCompressionBytes() const { return std::make_pair( m_texcomp.GetInputBytesCount(), m_texcomp.GetOutputBytesCount() ); }
 
     void DoPostponedSymbols();
+    const SymbolLocation* FindSymbolLocation( uint64_t address );
     void DoPostponedInlineSymbols();
     void DoPostponedWork();
     void DoPostponedWorkAll();
@@ -708,6 +765,10 @@ private:
     void QueryTerminate();
     void QuerySourceFile( const char* fn, const char* image );
     void QueryDataTransfer( const void* ptr, size_t size );
+    void SendServerQueries();
+    void SendServerQueries( Vector<ServerQueryPacket>& queue, int64_t space );
+    void UpdateQueryWindow( int64_t td );
+    int64_t GetQuerySpace( ServerQuery type ) const;
 
     tracy_force_inline bool DispatchProcess( const QueueItem& ev, const char*& ptr );
     tracy_force_inline bool Process( const QueueItem& ev );
@@ -740,11 +801,16 @@ private:
     tracy_force_inline void ProcessLockSharedRelease( const QueueLockReleaseShared& ev );
     tracy_force_inline void ProcessLockMark( const QueueLockMark& ev );
     tracy_force_inline void ProcessLockMarkFileLine( const QueueLockMarkFileLine& ev );
+    tracy_force_inline void ProcessLockAggregateWait( const QueueLockAggregate& ev );
+    tracy_force_inline void ProcessLockAggregateHold( const QueueLockAggregate& ev );
+    tracy_force_inline void ProcessLockAggregateHistogram( const QueueLockAggregateHistogram& ev );
     tracy_force_inline void ProcessLockName( const QueueLockName& ev );
     tracy_force_inline void ProcessPlotDataInt( const QueuePlotDataInt& ev );
     tracy_force_inline void ProcessPlotDataFloat( const QueuePlotDataFloat& ev );
     tracy_force_inline void ProcessPlotDataDouble( const QueuePlotDataDouble& ev );
     tracy_force_inline void ProcessPlotConfig( const QueuePlotConfig& ev );
+    tracy_force_inline void ProcessCounterData( const QueueCounterData& ev );
+    tracy_force_inline void ProcessHistogramData( const QueueHistogramData& ev );
     tracy_force_inline void ProcessMessage( const QueueMessage& ev );
     tracy_force_inline void ProcessMessageLiteral( const QueueMessageLiteral& ev );
     tracy_force_inline void ProcessMessageColor( const QueueMessageColor& ev );
@@ -793,6 +859,7 @@ private:
     tracy_force_inline void ProcessHwSampleBranchMiss( const QueueHwSample& ev );
     tracy_force_inline void ProcessParamSetup( const QueueParamSetup& ev );
     tracy_force_inline void ProcessSourceCodeNotAvailable( const QueueSourceCodeNotAvailable& ev );
+    tracy_force_inline void ProcessServerQueryBatchAck( const QueueServerQueryBatchAck& ev );
     tracy_force_inline void ProcessCpuTopology( const QueueCpuTopology& ev );
     tracy_force_inline void ProcessMemNamePayload( const QueueMemNamePayload& ev );
     tracy_force_inline void ProcessThreadGroupHint( const QueueThreadGroupHint& ev );
@@ -827,6 +894,16 @@ private:
     void FrameImageTwiceFailure();
     void FiberLeaveFailure();
     void SourceLocationOverflowFailure();
+    void TimeRangeFailure();
+
+    // Packed events can't store times past MaxEventTime. The capture is stopped
+    // and the offending event is clamped, so that the data gathered so far stays valid.
+    tracy_force_inline int64_t CheckTimeRange( int64_t time )
+    {
+        if( time <= MaxEventTime ) return time;
+        TimeRangeFailure();
+        return MaxEventTime;
+    }
 
     tracy_force_inline void CheckSourceLocation( uint64_t ptr );
     void NewSourceLocation( uint64_t ptr );
@@ -915,10 +992,18 @@ private:
     void AddSourceCode( uint32_t id, const char* data, size_t sz );
 
     tracy_force_inline void AddCallstackPayload( const char* data, size_t sz );
+    void AddHistogramPayload( const char* data, size_t sz );
     tracy_force_inline void AddCallstackAllocPayload( const char* data );
     uint32_t MergeCallstacks( uint32_t first, uint32_t second );
 
     void InsertPlot( PlotData* plot, int64_t time, double val );
+    void UpdatePlot( PlotData* plot, size_t idx, double val );
+    HistogramData* CreateHistogram( uint64_t name );
+    void CloseHistogramWindow( HistogramData& hd );
+    void StoreHistogramSnapshot( HistogramData& hd, HistogramSnapshot snapshot, const HistogramBin* bins );
+    void MergeHistogramSnapshot( HistogramData& hd, HistogramSnapshot& dst, const HistogramSnapshot& src, const HistogramBin* bins );
+    static uint16_t CompactHistogramBins( const uint32_t* dense, HistogramBin* bins );
+    static void GetHistogramPlotValues( const HistogramSnapshot& snapshot, const HistogramBin* bins, double* vals );
     void HandlePlotName( uint64_t name, const char* str, size_t sz );
     void HandleFrameName( uint64_t name, const char* str, size_t sz );
 
@@ -947,11 +1032,13 @@ private:
 
 #ifndef TRACY_NO_STATISTICS
     void ReconstructContextSwitchUsage();
+    void ReconstructZoneOffCpuTime();
     bool UpdateSampleStatistics( uint32_t callstack, uint32_t count, bool canPostpone );
     void UpdateSampleStatisticsPostponed( decltype(Worker::DataBlock::postponedSamples.begin())& it );
     void UpdateSampleStatisticsImpl( const CallstackFrameData** frames, uint16_t framesCount, uint32_t count, const VarArray<CallstackFrameId>& cs );
     tracy_force_inline void GetStackWithInlines( Vector<InlineStackData>& ret, const VarArray<CallstackFrameId>& cs );
     tracy_force_inline int AddGhostZone( const VarArray<CallstackFrameId>& cs, Vector<GhostZone>* vec, uint64_t t );
+    int AddGhostZone( GhostContext& ctx, const VarArray<CallstackFrameId>& cs, Vector<GhostZone>* vec, uint64_t t );
 #endif
 
     tracy_force_inline int64_t ReadTimeline( FileRead& f, ZoneEvent* zone, int64_t refTime, int32_t& childIdx, int32_t& maxd, int32_t level );
@@ -960,8 +1047,9 @@ private:
     tracy_force_inline void ReadTimelineHaveSize( FileRead& f, GpuEvent* zone, int64_t& refTime, int64_t& refGpuTime, int32_t& childIdx, uint64_t sz, int32_t& maxd, int32_t level );
 
 #ifndef TRACY_NO_STATISTICS
-    tracy_force_inline void ReconstructZoneStatistics( uint8_t* countMap, ZoneEvent& zone, uint16_t thread );
+    tracy_force_inline void ReconstructZoneStatistics( uint8_t* countMap, ZoneEvent& zone, uint16_t thread, int16_t parentSrcLoc );
     tracy_force_inline void ReconstructZoneStatistics( GpuEvent& zone, uint16_t thread );
+    void FlushZoneStatistics();
 #else
     tracy_force_inline void CountZoneStatistics( ZoneEvent* zone );
     tracy_force_inline void CountZoneStatistics( GpuEvent* zone );
@@ -977,6 +1065,12 @@ private:
     void UpdateMbps( int64_t td );
 
     int64_t ReadTimeline( FileRead& f, Vector<short_ptr<ZoneEvent>>& vec, uint32_t size, int64_t refTime, int32_t& childIdx, int32_t& maxd, int32_t level = 1 );
+    uint16_t CalcZoneChildrenDepth( const Vector<short_ptr<ZoneEvent>>& vec ) const;
+    void UpdateZoneLod( ThreadData* td, const Vector<short_ptr<ZoneEvent>>& stack );
+    void ExtendZoneLod( ZoneLod& lod, const Vector<short_ptr<ZoneEvent>>& vec );
+#ifndef TRACY_NO_STATISTICS
+    void BuildZoneIndex( ZoneIndex& index, const Vector<short_ptr<ZoneEvent>>& vec, int depth );
+#endif
     void ReadTimeline( FileRead& f, Vector<short_ptr<GpuEvent>>& vec, uint64_t size, int64_t& refTime, int64_t& refGpuTime, int32_t& childIdx, int32_t& maxd, int32_t level = 1 );
 
     tracy_force_inline void WriteTimeline( FileWrite& f, const Vector<short_ptr<ZoneEvent>>& vec, int64_t& refTime );
@@ -986,8 +1080,8 @@ private:
     template<typename Adapter, typename V>
     void WriteTimelineImpl( FileWrite& f, const V& vec, int64_t& refTime, int64_t& refGpuTime );
 
-    int64_t TscTime( int64_t tsc ) { return int64_t( ( tsc - m_data.baseTime ) * m_timerMul ); }
-    int64_t TscTime( uint64_t tsc ) { return int64_t( ( tsc - m_data.baseTime ) * m_timerMul ); }
+    int64_t TscTime( int64_t tsc ) { return CheckTimeRange( int64_t( ( tsc - m_data.baseTime ) * m_timerMul ) ); }
+    int64_t TscTime( uint64_t tsc ) { return CheckTimeRange( int64_t( ( tsc - m_data.baseTime ) * m_timerMul ) ); }
     int64_t TscPeriod( uint64_t tsc ) { return int64_t( tsc * m_timerMul ); }
 
     template<typename Adapter, typename V>
@@ -1005,6 +1099,7 @@ private:
     std::atomic<bool> m_shutdown { false };
 
     std::atomic<bool> m_backgroundDone { true };
+    LoadProgress m_sampleProgress;
     std::thread m_threadBackground;
 
     int64_t m_delay;
@@ -1035,6 +1130,8 @@ private:
     short_ptr<GpuCtxData> m_gpuCtxMap[256];
     uint32_t m_pendingCallstackId = 0;
     int16_t m_pendingSourceLocationPayload = 0;
+    HistogramSnapshot m_pendingHistogram = {};
+    Vector<HistogramBin> m_pendingHistogramBins;
     Vector<uint64_t> m_sourceLocationQueue;
     unordered_flat_map<uint64_t, int16_t> m_sourceLocationShrink;
     unordered_flat_map<uint64_t, ThreadData*> m_threadMap;
@@ -1103,7 +1200,14 @@ private:
     PlotData* m_sysTimePlot = nullptr;
 
     Vector<ServerQueryPacket> m_serverQueryQueue, m_serverQueryQueuePrio;
-    size_t m_serverQuerySpaceLeft, m_serverQuerySpaceBase;
+    int64_t m_serverQuerySpaceLeft, m_serverQuerySpaceBase, m_serverQuerySpaceMax, m_serverQuerySymbolMax;
+    uint64_t m_serverQuerySent = 0;
+    uint64_t m_serverQueryDone = 0;
+    uint32_t m_serverQueryBatchSeq = 0;
+    int64_t m_serverQueryRtt = 0;
+    int64_t m_serverQueryRttMin = 0;
+    QueryBatchTime m_serverQueryBatchTime[64] = {};
+    std::vector<char> m_serverQueryBuffer;
 
     unordered_flat_map<uint64_t, int32_t> m_frameImageStaging;
     char* m_frameImageBuffer = nullptr;
@@ -1126,6 +1230,12 @@ private:
         int size;
     };
 
+    // Number of frames the network thread may decompress ahead of Exec. The
+    // decode ring is not synchronized with the client's three frame LZ4 ring,
+    // so it has to be larger than it by at least one frame.
+    static constexpr int NetBufferDepth = 8;
+    static_assert( NetBufferDepth >= 3, "Decode ring buffer too small for LZ4 stream" );
+
     std::vector<NetBuffer> m_netRead;
     std::mutex m_netReadLock;
     std::condition_variable m_netReadCv;
@@ -1138,6 +1248,24 @@ private:
     Vector<ZoneEvent*> m_zoneEventPool;
 #endif
 
+#ifndef TRACY_NO_STATISTICS
+    // Source location statistics of ended zones. Exec only queues them while it parses a batch of
+    // events. Each shard owns a disjoint set of source locations, so the shards are applied in
+    // parallel by FlushZoneStatistics(), before the data lock is released.
+    struct ZoneStatsItem
+    {
+        ZoneThreadData ztd;
+        int16_t srcloc;
+        bool isReentry;
+        int64_t timeSpan;
+        int64_t selfSpan;
+    };
+
+    enum { ZoneStatsShards = 8 };
+    Vector<ZoneStatsItem> m_zoneStats[ZoneStatsShards];
+    std::unique_ptr<TaskDispatch> m_zoneStatsDispatch;
+#endif
+
     Vector<Parameter> m_params;
 
     char* m_tmpBuf = nullptr;
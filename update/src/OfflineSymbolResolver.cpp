@@ -1,11 +1,14 @@
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unordered_map>
 
+#include "../../public/common/TracySymbolCache.hpp"
 #include "../../server/TracyWorker.hpp"
 #include "../../zstd/zstd.h"
 
@@ -24,6 +27,52 @@ bool ApplyPathSubstitutions( std::string& path, const PathSubstitutionList& path
     return false;
 }
 
+// Splits the entries into the ones already present in the symbol cache, which are returned
+// in resolvedEntries, and the ones that still need to be resolved.
+void GetCachedSymbols( const tracy::SymbolCache& cache, FrameEntryList& entries, SymbolEntryList& resolvedEntries,
+                       FrameEntryList& cachedEntries )
+{
+    FrameEntryList missing;
+    tracy::SymbolCacheFrame frame;
+    uint8_t flags;
+    for( const FrameEntry& entry : entries )
+    {
+        if( cache.Find( entry.symbolOffset, &frame, 1, flags ) )
+        {
+            SymbolEntry symbol;
+            symbol.name.assign( frame.name, frame.nameLen );
+            symbol.file.assign( frame.file, frame.fileLen );
+            symbol.line = frame.line;
+            resolvedEntries.push_back( std::move( symbol ) );
+            cachedEntries.push_back( entry );
+        }
+        else
+        {
+            missing.push_back( entry );
+        }
+    }
+    entries = std::move( missing );
+}
+
+// Only the reported frame is known here, inline frames of the client are not recreated.
+void StoreCachedSymbols( tracy::SymbolCache& cache, const FrameEntryList& entries, const SymbolEntryList& resolvedEntries )
+{
+    for( size_t i = 0; i < entries.size(); ++i )
+    {
+        const SymbolEntry& symbol = resolvedEntries[i];
+        if( !symbol.name.length() || symbol.name.compare( 0, 10, "[unknown] " ) == 0 ) continue;
+        tracy::SymbolCacheFrame frame;
+        frame.name = symbol.name.c_str();
+        frame.file = symbol.file.c_str();
+        frame.nameLen = uint16_t( std::min<size_t>( symbol.name.length(), std::numeric_limits<uint16_t>::max() ) );
+        frame.fileLen = uint16_t( std::min<size_t>( symbol.file.length(), std::numeric_limits<uint16_t>::max() ) );
+        frame.line = symbol.line;
+        frame.symLen = 0;
+        frame.symOffset = tracy::SymbolCacheNoOffset;
+        cache.Add( entries[i].symbolOffset, &frame, 1, tracy::SymbolCache::Offline );
+    }
+}
+
 tracy::StringIdx AddSymbolString( tracy::Worker& worker, const std::string& str )
 {
     // TODO: use string hash map to reduce potential string duplication?
@@ -74,6 +123,9 @@ bool PatchSymbolsWithRegex( tracy::Worker& worker, const PathSubstitutionList& p
 
     std::cout << "Batched into " << entriesPerImageIdx.size() << " unique image groups" << std::endl;
 
+    // use TRACY_SYMBOL_CACHE_DIR to share resolved symbols with previous runs and with the client
+    const char* symbolCacheDir = getenv( "TRACY_SYMBOL_CACHE_DIR" );
+
     // FIXME: the resolving of symbols here can be slow and could be done in parallel per "image"
     // - be careful with string allocation though as that would be not safe to do in parallel
     for( FrameEntriesPerImageIdx::iterator imageIt = entriesPerImageIdx.begin(),
@@ -94,8 +146,37 @@ bool PatchSymbolsWithRegex( tracy::Worker& worker, const PathSubstitutionList& p
             std::cout << "\tPath substituted to: '" << imagePath << "'" << std::endl;
         }
 
+        tracy::SymbolCache* symbolCache = nullptr;
+        uint8_t buildId[tracy::SymbolCacheMaxBuildId];
+        size_t buildIdSize;
+        if( symbolCacheDir && tracy::GetElfBuildId( imagePath.c_str(), buildId, buildIdSize ) )
+        {
+            symbolCache = tracy::SymbolCache::Open( symbolCacheDir, buildId, buildIdSize );
+        }
+
         SymbolEntryList resolvedEntries;
-        ResolveSymbols( imagePath, entries, resolvedEntries );
+        if( symbolCache )
+        {
+            FrameEntryList cachedEntries;
+            GetCachedSymbols( *symbolCache, entries, resolvedEntries, cachedEntries );
+            std::cout << "\tFound " << cachedEntries.size() << " symbols in cache" << std::endl;
+
+            // cached symbols are still patched if resolving the remaining ones fails
+            SymbolEntryList newEntries;
+            if( !entries.empty() && ResolveSymbols( imagePath, entries, newEntries ) && newEntries.size() == entries.size() )
+            {
+                StoreCachedSymbols( *symbolCache, entries, newEntries );
+                cachedEntries.insert( cachedEntries.end(), entries.begin(), entries.end() );
+                resolvedEntries.insert( resolvedEntries.end(), std::make_move_iterator( newEntries.begin() ),
+                                        std::make_move_iterator( newEntries.end() ) );
+            }
+            tracy::SymbolCache::Close( symbolCache );
+            entries = std::move( cachedEntries );
+        }
+        else
+        {
+            ResolveSymbols( imagePath, entries, resolvedEntries );
+        }
 
         if( resolvedEntries.size() != entries.size() )
         {
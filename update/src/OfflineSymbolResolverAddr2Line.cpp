@@ -1,4 +1,4 @@
-#ifndef _WIN32
+#if !defined _WIN32 && !defined TRACY_SYMBOL_RESOLVER_LIBBACKTRACE
 
 #include "OfflineSymbolResolver.h"
 
@@ -111,4 +111,4 @@ bool ResolveSymbols( const std::string& imagePath, const FrameEntryList& inputEn
     return symbolResolver.ResolveSymbols( imagePath, inputEntryList, resolvedEntries );
 }
 
-#endif // #ifndef _WIN32
+#endif // #if !defined _WIN32 && !defined TRACY_SYMBOL_RESOLVER_LIBBACKTRACE
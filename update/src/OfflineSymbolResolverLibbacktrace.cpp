@@ -0,0 +1,154 @@
+#ifdef TRACY_SYMBOL_RESOLVER_LIBBACKTRACE
+
+#include "OfflineSymbolResolver.h"
+
+#include <algorithm>
+#include <cxxabi.h>
+#include <iostream>
+#include <memory>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "../../public/libbacktrace/backtrace.hpp"
+#include "../../server/TracyTaskDispatch.hpp"
+
+namespace
+{
+
+struct ResolveData
+{
+    SymbolEntry* entry;
+    bool done;
+};
+
+void ErrorCallback( void*, const char*, int )
+{
+}
+
+void AssignName( std::string& dst, const char* name )
+{
+    int status;
+    char* demangled = abi::__cxa_demangle( name, nullptr, nullptr, &status );
+    if( demangled )
+    {
+        dst = demangled;
+        free( demangled );
+    }
+    else
+    {
+        dst = name;
+    }
+}
+
+// Called for the innermost inlined frame first, which is what addr2line reports without -i.
+int PcInfoCallback( void* data, uintptr_t, uintptr_t, const char* filename, int lineno, const char* function )
+{
+    auto rd = (ResolveData*)data;
+    if( !function ) return 0;
+    AssignName( rd->entry->name, function );
+    if( filename )
+    {
+        rd->entry->file = filename;
+        rd->entry->line = lineno;
+    }
+    rd->done = true;
+    return 1;
+}
+
+void SymInfoCallback( void* data, uintptr_t, const char* symname, uintptr_t, uintptr_t )
+{
+    auto rd = (ResolveData*)data;
+    if( !symname ) return;
+    AssignName( rd->entry->name, symname );
+    rd->done = true;
+}
+
+}
+
+class SymbolResolver
+{
+public:
+    SymbolResolver()
+        : m_workers( std::max<size_t>( std::thread::hardware_concurrency(), 1 ) )
+        , m_td( m_workers, "Symbols" )
+    {
+    }
+
+    bool ResolveSymbols( const std::string& imagePath, const FrameEntryList& inputEntryList,
+                         SymbolEntryList& resolvedEntries )
+    {
+        // Frames of inlined calls share the same offset, so only unique offsets are resolved.
+        std::vector<uint64_t> offsets;
+        offsets.reserve( inputEntryList.size() );
+        for( auto& entry : inputEntryList ) offsets.push_back( entry.symbolOffset );
+        std::sort( offsets.begin(), offsets.end() );
+        offsets.erase( std::unique( offsets.begin(), offsets.end() ), offsets.end() );
+
+        auto state = GetState( imagePath );
+        if( !state ) return false;
+
+        std::vector<SymbolEntry> symbols( offsets.size() );
+        if( !offsets.empty() )
+        {
+            // The first lookup reads the debug info of the image. Do it here, so that the
+            // workers do not race to initialize the state and each parse it on their own.
+            Resolve( state, offsets[0], symbols[0] );
+
+            const size_t minShard = 256;
+            const auto shards = std::clamp<size_t>( ( offsets.size() - 1 ) / minShard, 1, m_workers );
+            const auto shardSize = ( offsets.size() - 1 + shards - 1 ) / shards;
+            for( size_t i=1; i<offsets.size(); i+=shardSize )
+            {
+                const auto end = std::min( i + shardSize, offsets.size() );
+                m_td.Queue( [i, end, state, &offsets, &symbols] {
+                    for( size_t j=i; j<end; j++ ) Resolve( state, offsets[j], symbols[j] );
+                } );
+            }
+            m_td.Sync();
+        }
+
+        resolvedEntries.reserve( resolvedEntries.size() + inputEntryList.size() );
+        for( auto& entry : inputEntryList )
+        {
+            const auto it = std::lower_bound( offsets.begin(), offsets.end(), entry.symbolOffset );
+            resolvedEntries.push_back( symbols[it - offsets.begin()] );
+        }
+
+        return true;
+    }
+
+private:
+    // One threaded state per image is shared by all workers. States cannot be freed, so they
+    // are kept for the lifetime of the resolver.
+    tracy::backtrace_state* GetState( const std::string& imagePath )
+    {
+        auto it = m_states.find( imagePath );
+        if( it != m_states.end() ) return it->second;
+        auto state = tracy::backtrace_create_state_offline( imagePath.c_str(), 1, ErrorCallback, nullptr );
+        if( state ) m_states.emplace( imagePath, state );
+        return state;
+    }
+
+    static void Resolve( tracy::backtrace_state* state, uint64_t offset, SymbolEntry& entry )
+    {
+        ResolveData data = { &entry, false };
+        tracy::backtrace_pcinfo( state, offset, PcInfoCallback, ErrorCallback, &data );
+        if( !data.done ) tracy::backtrace_syminfo( state, offset, SymInfoCallback, ErrorCallback, &data );
+        if( !data.done ) entry.name = "[unknown] + " + std::to_string( offset );
+    }
+
+    size_t m_workers;
+    tracy::TaskDispatch m_td;
+    std::unordered_map<std::string, tracy::backtrace_state*> m_states;
+};
+
+bool ResolveSymbols( const std::string& imagePath, const FrameEntryList& inputEntryList,
+                     SymbolEntryList& resolvedEntries )
+{
+    static SymbolResolver symbolResolver;
+    return symbolResolver.ResolveSymbols( imagePath, inputEntryList, resolvedEntries );
+}
+
+#endif // #ifdef TRACY_SYMBOL_RESOLVER_LIBBACKTRACE